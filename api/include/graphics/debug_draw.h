@@ -0,0 +1,34 @@
+#ifndef OUT_GRAPHICS_DEBUG_DRAW_H
+#define OUT_GRAPHICS_DEBUG_DRAW_H
+
+#include <glm/glm.hpp>
+
+/// Immediate mode lines for debug views, get it with Render::debug().
+/// Lines are collected over the frame and drawn on top of everything
+/// in one draw per space at the end of the frame, then cleared.
+/// 2D lines use the 2D view projection, 3D lines use the 3D one.
+class DebugDraw {
+ public:
+    virtual ~DebugDraw() {}
+
+    virtual void line2D(glm::vec2 a, glm::vec2 b, glm::vec4 colour) = 0;
+    virtual void line3D(glm::vec3 a, glm::vec3 b, glm::vec4 colour) = 0;
+
+    /// --- shapes made from lines ---
+
+    /// rect is x, y, width, height
+    void rect2D(glm::vec4 rect, glm::vec4 colour);
+    void circle2D(glm::vec2 centre, float radius, glm::vec4 colour, int segments = 32);
+    void arrow2D(glm::vec2 from, glm::vec2 to, glm::vec4 colour, float headSize = 10.0f);
+
+    void box3D(glm::vec3 min, glm::vec3 max, glm::vec4 colour);
+    /// the unit cube from 0 to 1 transformed by model
+    void box3D(glm::mat4 model, glm::vec4 colour);
+    void circle3D(glm::vec3 centre, glm::vec3 normal, float radius, glm::vec4 colour,
+		  int segments = 32);
+    /// a circle around each axis
+    void sphere3D(glm::vec3 centre, float radius, glm::vec4 colour, int segments = 32);
+    void arrow3D(glm::vec3 from, glm::vec3 to, glm::vec4 colour, float headSize = 0.2f);
+};
+
+#endif
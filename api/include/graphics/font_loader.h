@@ -2,11 +2,17 @@
 #define OUTFACING_FONT_LOADER_H
 
 #include "texture_loader.h"
+#include <string_view>
 
 class FontLoader {
  public:
-    virtual Resource::Font load(std::string file) = 0;
-    virtual float length(Resource::Font font, std::string text, float size) = 0;
+    /// if sdf is true, the font is stored as a signed distance field,
+    /// which stays sharp at any draw size.
+    virtual Resource::Font load(std::string file, bool sdf) = 0;
+    Resource::Font load(std::string file) {
+	return load(file, false);
+    }
+    virtual float length(Resource::Font font, std::string_view text, float size) = 0;
 };
 
 #endif
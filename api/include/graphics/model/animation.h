@@ -17,6 +17,10 @@ namespace Resource {
       /// get list of transforms for the all of the bones at the current point of the animation.
       std::vector<glm::mat4>* getCurrentBones() { return &bones; }
       std::string getName() { return animation.name; }
+      /// in the same units as Update takes
+      double getLength() {
+	  return animation.ticks == 0.0 ? 0.0 : animation.duration / animation.ticks;
+      }
   private:
       void processNode(const ModelInfo::AnimNodes &animNode, glm::mat4 parentMat, bool animated);
       glm::mat4 boneTransform (const ModelInfo::AnimNodes &animNode);
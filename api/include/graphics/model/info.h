@@ -103,6 +103,15 @@ namespace ModelInfo {
       std::vector<glm::mat4> bones;
       std::map<std::string, unsigned int> boneMap;
       std::vector<Animation> animations;
+      /// Simplified levels of detail to generate for each mesh when loaded, up to 4.
+      /// Each level aims for half the triangles of the one before it.
+      unsigned int lodCount = 0;
+      /// Reorder each mesh's triangles and vertices when loaded, so more transformed
+      /// vertices are reused, less hidden pixels are shaded and vertex reads are closer together.
+      bool optimise = false;
+      /// Set by the loader once the meshes are reordered, so loading this data again,
+      /// or loading a copy saved after the first load, skips the work.
+      bool optimised = false;
   };
 }
 
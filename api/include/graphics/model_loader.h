@@ -58,6 +58,13 @@ class ModelLoader {
 
 
     virtual Resource::ModelAnimation getAnimation(Resource::Model model, int index) = 0;
+
+    /// model space bounds of the whole model, animated models
+    /// are bounded over the poses of all of their animations.
+    /// Only valid once the model's pool has been loaded to the gpu.
+    virtual Resource::Bounds getBounds(Resource::Model model) = 0;
+
+    virtual Resource::Bounds getMeshBounds(Resource::Model model, uint32_t meshIndex) = 0;
 };
 
 #endif /* OUTFACING_MODEL_LOADER */
@@ -0,0 +1,38 @@
+#ifndef OUT_GRAPHICS_PARTICLES_H
+#define OUT_GRAPHICS_PARTICLES_H
+
+#include "resources.h"
+#include <glm/glm.hpp>
+
+/// Settings for a particle emitter.
+/// Particles are simulated, spawned and killed on the gpu,
+/// and are drawn as 2D quads.
+struct ParticleEmitterConfig {
+    Resource::Texture texture;
+    // can't be changed after the emitter is created
+    uint32_t maxParticles = 10000;
+    // particles spawned per second
+    float emitRate = 1000.0f;
+
+    glm::vec2 position = glm::vec2(0.0f);
+    // particles spawn in a rect of +/- spawnArea around the position
+    glm::vec2 spawnArea = glm::vec2(0.0f);
+    glm::vec2 velocity = glm::vec2(0.0f, -100.0f);
+    // velocity is randomly offset by +/- this amount
+    glm::vec2 velocityVariance = glm::vec2(20.0f);
+    glm::vec2 acceleration = glm::vec2(0.0f, 100.0f);
+
+    // in seconds
+    float lifetime = 1.0f;
+    float lifetimeVariance = 0.2f;
+
+    // size and colour are interpolated over a particle's life
+    float startSize = 8.0f;
+    float endSize = 0.0f;
+    glm::vec4 startColour = glm::vec4(1.0f);
+    glm::vec4 endColour = glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+
+    float depth = 0.0f;
+};
+
+#endif
@@ -4,10 +4,22 @@
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 #include <atomic>
+#include <string_view>
+#include <vector>
 #include "render_config.h"
 #include "shader_structs.h"
+#include "particles.h"
+#include "debug_draw.h"
 #include "resource_pool.h"
 
+/// gpu time of the offscreen passes, in milliseconds
+struct GPUTimings {
+    // 0 unless RenderConfig::depth_prepass_3D is set
+    float depthPrepass3D = 0.0f;
+    // every draw of the frame, before it is scaled to the window
+    float colourPass = 0.0f;
+};
+
 class Render {
  public:
     /// sets up graphics api, makes a default resource pool
@@ -50,28 +62,97 @@ class Render {
 
 
     /// --- Resource Drawing ---
-    
-    virtual void DrawModel(Resource::Model model, glm::mat4 modelMatrix, glm::mat4 normalMatrix) {}
-    void DrawModel(Resource::Model model, glm::mat4 modelMatrix, glm::mat4 normalMatrix,
+
+    /// Models loaded as ModelType::m2D are drawn with the 2D quads,
+    /// repeated draws of the same model are instanced, even with different
+    /// colours or override textures.
+    /// Normals are transformed by the cofactor of the model matrix in the
+    /// vertex shader, so model matrices must be affine.
+    virtual void DrawModel(Resource::Model model, glm::mat4 modelMatrix) = 0;
+    void DrawModel(Resource::Model model, glm::mat4 modelMatrix,
 		   glm::vec4 overrideColour, Resource::Texture overrideTex) {
 	model.colour = overrideColour;
 	model.overrideTexture = overrideTex;
-	DrawModel(model, modelMatrix, normalMatrix);
+	DrawModel(model, modelMatrix);
+    }
+    void DrawModel(Resource::Model model, glm::mat4 modelMatrix, Resource::Texture overrideTex) {
+	DrawModel(model, modelMatrix, glm::vec4(0), overrideTex);
+    }
+    void DrawModel(Resource::Model model, glm::mat4 modelMatrix, glm::vec4 overrideColour) {
+	DrawModel(model, modelMatrix, overrideColour, Resource::Texture(Resource::NULL_ID));
+    }
+    /// If RenderConfig::interpolate_transforms is set, the model matrix used is
+    /// interpolated in the vertex shader between the previous and current matrix,
+    /// so a fixed timestep simulation only needs to give its last two states.
+    /// The translation, scale and rotation are interpolated separately,
+    /// so the matrices should not have shear.
+    /// The normal matrix is unused.
+    virtual void DrawModel(Resource::Model model, glm::mat4 previousModelMatrix,
+			   glm::mat4 modelMatrix, glm::mat4 normalMatrix) = 0;
+    virtual void DrawAnimModel(Resource::Model model, glm::mat4 modelMatrix,
+			       Resource::ModelAnimation *animation) = 0;
+    /// Draw count instances of a model, with one validation and batch check
+    /// for all of them. They are culled and given a level of detail together,
+    /// by a sphere around all of them, and RenderConfig::gpu_cull_3D culls them one by one.
+    /// Animated models can't be drawn instanced.
+    virtual void DrawModelInstanced(Resource::Model model,
+				    const Resource::InstanceTransform* instances,
+				    size_t count) = 0;
+    void DrawModelInstanced(Resource::Model model,
+			    const std::vector<Resource::InstanceTransform> &instances) {
+	DrawModelInstanced(model, instances.data(), instances.size());
+    }
+    /// Keep the transforms of 3D instances that don't move on the gpu.
+    /// Drawing them copies the transforms on the gpu, so the cpu doesn't write them,
+    /// but they still take slots of RenderConfig::max_3D_instances each frame.
+    /// Returns a buffer with NULL_INSTANCE_BUFFER_ID on failure.
+    virtual Resource::InstanceBuffer CreateInstanceBuffer(
+	    const Resource::InstanceTransform* instances, size_t count) = 0;
+    Resource::InstanceBuffer CreateInstanceBuffer(
+	    const std::vector<Resource::InstanceTransform> &instances) {
+	return CreateInstanceBuffer(instances.data(), instances.size());
+    }
+    /// waits for the device to be idle, so the buffer isn't in use
+    virtual void DestroyInstanceBuffer(Resource::InstanceBuffer buffer) = 0;
+    /// Instances from a buffer use the model's own colours and textures.
+    /// Only RenderConfig::gpu_cull_3D culls them one by one, otherwise they are culled
+    /// and given a level of detail together, by a sphere around all of them.
+    virtual void DrawModelInstanced(Resource::Model model,
+				    Resource::InstanceBuffer instances) = 0;
+
+    /// Older overloads, the normal matrix is unused.
+    void DrawModel(Resource::Model model, glm::mat4 modelMatrix, glm::mat4 normalMatrix) {
+	DrawModel(model, modelMatrix);
+    }
+    void DrawModel(Resource::Model model, glm::mat4 modelMatrix, glm::mat4 normalMatrix,
+		   glm::vec4 overrideColour, Resource::Texture overrideTex) {
+	DrawModel(model, modelMatrix, overrideColour, overrideTex);
     }
     void DrawModel(Resource::Model model, glm::mat4 modelMatrix, glm::mat4 normalMatrix,
 		   Resource::Texture overrideTex) {
-	DrawModel(model, modelMatrix, normalMatrix, glm::vec4(0), overrideTex);
+	DrawModel(model, modelMatrix, overrideTex);
     }
     void DrawModel(Resource::Model model, glm::mat4 modelMatrix, glm::mat4 normalMatrix,
 		   glm::vec4 overrideColour) {
-	DrawModel(model, modelMatrix, normalMatrix, overrideColour,
-		  Resource::Texture(Resource::NULL_ID));
+	DrawModel(model, modelMatrix, overrideColour);
+    }
+    void DrawAnimModel(Resource::Model model, glm::mat4 modelMatrix, glm::mat4 normalMatrix,
+		       Resource::ModelAnimation *animation) {
+	DrawAnimModel(model, modelMatrix, animation);
     }
-    virtual void DrawAnimModel(Resource::Model model, glm::mat4 modelMatrix,
-			       glm::mat4 normalMatrix,
-			       Resource::ModelAnimation *animation) = 0;
     virtual void DrawQuad(Resource::Texture texture, glm::mat4 modelMatrix,
 			  glm::vec4 colour, glm::vec4 texOffset) = 0;
+    /// the animation runs on the gpu, so it can be drawn with the same arguments each frame
+    virtual void DrawQuad(Resource::Texture texture, glm::mat4 modelMatrix,
+			  glm::vec4 colour, glm::vec4 texOffset,
+			  Resource::SpriteAnimation animation) = 0;
+    /// interpolated like DrawModel with a previous model matrix
+    virtual void DrawQuad(Resource::Texture texture, glm::mat4 previousModelMatrix,
+			  glm::mat4 modelMatrix, glm::vec4 colour, glm::vec4 texOffset) = 0;
+    void DrawQuad(Resource::Texture texture, glm::mat4 previousModelMatrix,
+		  glm::mat4 modelMatrix) {
+	DrawQuad(texture, previousModelMatrix, modelMatrix, glm::vec4(1), glm::vec4(0, 0, 1, 1));
+    }
     void DrawQuad(Resource::Texture texture, glm::mat4 modelMatrix, glm::vec4 colour) {
 	DrawQuad(texture, modelMatrix, colour, glm::vec4(0, 0, 1, 1));
     }
@@ -79,13 +160,49 @@ class Render {
 	DrawQuad(texture, modelMatrix, glm::vec4(1));
     }
 
-    virtual void DrawString(Resource::Font font, std::string text, glm::vec2 position,
+    virtual void DrawString(Resource::Font font, std::string_view text, glm::vec2 position,
 			    float size, float depth, glm::vec4 colour, float rotate) = 0;
-    void DrawString(Resource::Font font, std::string text, glm::vec2 position,
+    void DrawString(Resource::Font font, std::string_view text, glm::vec2 position,
 		    float size, float depth, glm::vec4 colour) {
 	DrawString(font, text, position, size, depth, colour, 0.0f);
     }
 
+    /// --- Particles ---
+
+    /// Emitters keep their particles on the gpu until they are destroyed.
+    /// Returns an emitter with NULL_PARTICLE_EMITTER_ID on failure.
+    virtual Resource::ParticleEmitter CreateParticleEmitter(ParticleEmitterConfig config) = 0;
+    /// change the emitter's settings, except for maxParticles
+    virtual void setParticleEmitter(Resource::ParticleEmitter emitter,
+				    ParticleEmitterConfig config) = 0;
+    virtual void DestroyParticleEmitter(Resource::ParticleEmitter emitter) = 0;
+    /// Advance the emitter's simulation by deltaTime seconds.
+    /// The simulation runs on the gpu at the start of the next frame that is drawn.
+    virtual void UpdateParticles(Resource::ParticleEmitter emitter, float deltaTime) = 0;
+    /// draw the emitter's live particles with the 2D projection
+    virtual void DrawParticles(Resource::ParticleEmitter emitter) = 0;
+
+    /// lines drawn on top of the frame, cleared after each EndDraw
+    virtual DebugDraw* debug() = 0;
+
+    /// Sort key for the following 2D draws, until changed or the frame ends.
+    /// Only used when RenderConfig::sort_2D_by_key is set, lower keys are drawn first,
+    /// draws with the same key keep their call order.
+    /// Quads and glyphs are sorted per run, a run ends at any 3D draw,
+    /// DrawParticles or 2D model draw, and draws after it are drawn on top.
+    virtual void set2DSortKey(uint32_t key) = 0;
+    /// make a key that sorts by layer, then by y position
+    static uint32_t sortKey2D(uint16_t layer, float y) {
+	float clamped = y < 0.0f ? 0.0f : (y > 65535.0f ? 65535.0f : y);
+	return ((uint32_t)layer << 16) | (uint32_t)clamped;
+    }
+
+    /// Clip the following 2D draws to rect (x, y, width, height), until cleared
+    /// or the frame ends. The rect is in the same space as the quad model matrices.
+    /// Clipped draws stay in the same batch, quads fully outside the rect are skipped.
+    virtual void set2DClipRect(glm::vec4 rect) = 0;
+    virtual void clear2DClipRect() = 0;
+
     /// atomic bool is set to true when draw commands finish being sent
     /// to the gpu
     virtual void EndDraw(std::atomic<bool> &submit) = 0;
@@ -107,10 +224,18 @@ class Render {
     virtual void set3DProjMat(glm::mat4 proj) = 0;
     virtual void set2DProjMat(glm::mat4 proj) = 0;
     virtual void setLightingProps(BPLighting lighting) = 0;
+    /// Fraction of the way from the previous to the current transforms, in [0, 1].
+    /// Only used if RenderConfig::interpolate_transforms is set.
+    virtual void setInterpolation(float alpha) = 0;
+    /// time in seconds, used by shaders for animation
+    virtual void setTime(float time) = 0;
 
     virtual void setRenderConf(RenderConfig renderConf) = 0;
     virtual RenderConfig getRenderConf() = 0;
     virtual glm::vec2 offscreenSize() = 0;
+    /// From the last frame the gpu finished, a few frames behind the one being drawn.
+    /// All zero if the device can't write timestamps in its graphics queue.
+    virtual GPUTimings getGPUTimings() = 0;
 };
 
 #endif
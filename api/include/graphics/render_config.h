@@ -8,6 +8,44 @@ struct RenderConfig {
     float target_resolution[2] = { 0.0f, 0.0f };// if [0] or [1] are zero, use resolution of window
     float depth_range_2D[2] = { 0.0f, -10.0f };
     float depth_range_3D[2] = { 0.1f, 1000.0f };
+    // 2D quads, glyphs and 2D model meshes that can be drawn each frame.
+    // Each one takes a slot of per frame instance memory.
+    unsigned int max_2D_instances = 10000;
+    // skip 2D draws that are fully off screen on the CPU
+    bool cull_2D = false;
+    // skip 3D models whose bounding sphere is outside the view frustum on the CPU
+    bool cull_3D = false;
+    // draw opaque 2D quads front-to-back without blending before the
+    // transparent ones, so hidden pixels are rejected by the depth test
+    bool sort_2D_by_opacity = false;
+    // draw transparent 2D quads in order of the key given with Render::set2DSortKey,
+    // instead of call order. Sorting is within each run of consecutive 2D draws.
+    bool sort_2D_by_key = false;
+    // interpolate between the previous and current transforms given to draws,
+    // by the alpha set with Render::setInterpolation. Their translation, scale
+    // and rotation are interpolated separately, shear isn't kept.
+    bool interpolate_transforms = false;
+    // 3D instances that can be drawn each frame, including those drawn from
+    // instance buffers. Each one takes a slot of per frame instance memory.
+    unsigned int max_3D_instances = 10000;
+    // test 3D instances against the view frustum in a compute pass,
+    // and draw the visible ones with indirect draws.
+    // At most max_3D_instances instances reach the culling each frame, in up to 512
+    // mesh draws, batches past that are drawn directly without being culled.
+    // Disabled on devices without the drawIndirectFirstInstance feature.
+    bool gpu_cull_3D = false;
+    // also skip 3D instances hidden behind the previous frame's 3D depth.
+    // Needs gpu_cull_3D, and is disabled with multisampling.
+    // The depth is taken from the depth pre-pass, which this turns on.
+    bool occlusion_cull_3D = false;
+    // write the depth of 3D models in a position only pass before the colour pass,
+    // which then only shades the nearest surface of each pixel. Animated models aren't
+    // in the pre-pass, and models with transparent texels are alpha tested in it.
+    bool depth_prepass_3D = false;
+    // draw the next simplified level of detail of a 3D model each time the height of
+    // its bounding sphere on screen halves below this fraction of the screen,
+    // models only have levels of detail if ModelInfo::Model::lodCount was set. 0 disables.
+    float lod_screen_size = 0.25f;
     float clear_colour[3] = { 0.39f, 0.58f, 0.93f };
     float scaled_border_colour[3] = { 0.0f, 0.0f, 0.0f };
 
@@ -16,6 +54,8 @@ struct RenderConfig {
     bool mip_mapping = false;
     // for a pixelated look (ie no smoothing of pixels)
     bool texture_filter_nearest = false;
+    // pack all fonts of a resource pool into one texture
+    bool shared_font_atlas = false;
 };
 
 #endif
@@ -11,9 +11,11 @@
 namespace Resource {
 
   const uint32_t MAX_TEXTURES_SUPPORTED = 20;//match in shader
-  const uint32_t MAX_2D_BATCH = 10000;
-  const uint32_t MAX_3D_BATCH = 1000;
+  // per frame, set with Render::set2DClipRect
+  const uint32_t MAX_2D_CLIP_RECTS = 256;
   const uint32_t MAX_BONES = 80;
+  // simplified levels of detail a mesh can have, as well as its full detail
+  const uint32_t MAX_MODEL_LODS = 4;
 
   static size_t NULL_POOL_ID = SIZE_MAX;
 
@@ -33,6 +35,14 @@ namespace Resource {
   };
 
   static size_t NULL_ID = SIZE_MAX;
+
+  /// model space bounding volumes of a model or mesh
+  struct Bounds {
+      glm::vec3 min = glm::vec3(0.0f);
+      glm::vec3 max = glm::vec3(0.0f);
+      // xyz centre, w radius
+      glm::vec4 sphere = glm::vec4(0.0f);
+  };
   
   struct Texture {
       Texture() {
@@ -131,6 +141,68 @@ namespace Resource {
       size_t ID = NULL_FONT_ID;
   };
 
+  /// Texture animation evaluated on the gpu using the time given to the renderer,
+  /// so animated quads don't need their texOffset changed each frame.
+  struct SpriteAnimation {
+      // offset added to the quad's uvs per second, wraps around the texture
+      glm::vec2 uvScroll = glm::vec2(0.0f);
+      // split the quad's texOffset rect into columns x rows of frames,
+      // read left to right, top to bottom
+      glm::uvec2 grid = glm::uvec2(1, 1);
+      // no flipbook if less than 2
+      uint32_t frameCount = 0;
+      float fps = 0.0f;
+      // the time the animation is on its first frame
+      float startTime = 0.0f;
+      // stop on the last frame if false
+      bool loop = true;
+  };
+
+  static size_t NULL_PARTICLE_EMITTER_ID = SIZE_MAX;
+
+  struct ParticleEmitter {
+      ParticleEmitter() {}
+      ParticleEmitter(size_t ID) {
+	  this->ID = ID;
+      }
+      bool operator==(ParticleEmitter other) {
+	  return ID == other.ID;
+      }
+
+      size_t ID = NULL_PARTICLE_EMITTER_ID;
+  };
+
+  /// transform of one instance of a model, for drawing many at once
+  struct InstanceTransform {
+      InstanceTransform() {}
+      InstanceTransform(glm::mat4 model) {
+	  this->previous = model;
+	  this->model = model;
+      }
+      InstanceTransform(glm::mat4 previous, glm::mat4 model) {
+	  this->previous = previous;
+	  this->model = model;
+      }
+      // only used if RenderConfig::interpolate_transforms is set
+      glm::mat4 previous = glm::mat4(1.0f);
+      glm::mat4 model = glm::mat4(1.0f);
+  };
+
+  static size_t NULL_INSTANCE_BUFFER_ID = SIZE_MAX;
+
+  /// 3D instance transforms kept on the gpu
+  struct InstanceBuffer {
+      InstanceBuffer() {}
+      InstanceBuffer(size_t ID) {
+	  this->ID = ID;
+      }
+      bool operator==(InstanceBuffer other) {
+	  return ID == other.ID;
+      }
+
+      size_t ID = NULL_INSTANCE_BUFFER_ID;
+  };
+
   struct QuadDraw {
       QuadDraw(Texture tex, glm::mat4 model, glm::vec4 colour, glm::vec4 texOffset) {
 	  this->tex = tex;
@@ -0,0 +1,100 @@
+#include <graphics/debug_draw.h>
+
+#include <cmath>
+
+const float PI = 3.14159265358979f;
+
+void DebugDraw::rect2D(glm::vec4 rect, glm::vec4 colour) {
+    glm::vec2 a(rect.x, rect.y);
+    glm::vec2 b(rect.x + rect.z, rect.y);
+    glm::vec2 c(rect.x + rect.z, rect.y + rect.w);
+    glm::vec2 d(rect.x, rect.y + rect.w);
+    line2D(a, b, colour);
+    line2D(b, c, colour);
+    line2D(c, d, colour);
+    line2D(d, a, colour);
+}
+
+void DebugDraw::circle2D(glm::vec2 centre, float radius, glm::vec4 colour, int segments) {
+    if(segments < 3)
+	segments = 3;
+    glm::vec2 prev = centre + glm::vec2(radius, 0.0f);
+    for(int i = 1; i <= segments; i++) {
+	float angle = 2.0f * PI * (float)i / (float)segments;
+	glm::vec2 next = centre + radius * glm::vec2(std::cos(angle), std::sin(angle));
+	line2D(prev, next, colour);
+	prev = next;
+    }
+}
+
+void DebugDraw::arrow2D(glm::vec2 from, glm::vec2 to, glm::vec4 colour, float headSize) {
+    line2D(from, to, colour);
+    glm::vec2 dir = to - from;
+    float len = glm::length(dir);
+    if(len == 0.0f)
+	return;
+    dir /= len;
+    glm::vec2 side(-dir.y, dir.x);
+    glm::vec2 base = to - dir * headSize;
+    line2D(to, base + side * headSize * 0.5f, colour);
+    line2D(to, base - side * headSize * 0.5f, colour);
+}
+
+void DebugDraw::box3D(glm::vec3 min, glm::vec3 max, glm::vec4 colour) {
+    glm::mat4 model(1.0f);
+    model[0].x = max.x - min.x;
+    model[1].y = max.y - min.y;
+    model[2].z = max.z - min.z;
+    model[3] = glm::vec4(min, 1.0f);
+    box3D(model, colour);
+}
+
+void DebugDraw::box3D(glm::mat4 model, glm::vec4 colour) {
+    glm::vec3 corners[8];
+    for(int i = 0; i < 8; i++)
+	corners[i] = glm::vec3(model * glm::vec4(i & 1, (i >> 1) & 1, (i >> 2) & 1, 1));
+    for(int i = 0; i < 8; i++)
+	for(int axis = 1; axis < 8; axis <<= 1)
+	    if((i & axis) == 0)
+		line3D(corners[i], corners[i | axis], colour);
+}
+
+void DebugDraw::circle3D(glm::vec3 centre, glm::vec3 normal, float radius,
+			 glm::vec4 colour, int segments) {
+    if(segments < 3)
+	segments = 3;
+    normal = glm::normalize(normal);
+    glm::vec3 helper = std::abs(normal.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+    glm::vec3 u = glm::normalize(glm::cross(normal, helper)) * radius;
+    glm::vec3 v = glm::cross(normal, u);
+    glm::vec3 prev = centre + u;
+    for(int i = 1; i <= segments; i++) {
+	float angle = 2.0f * PI * (float)i / (float)segments;
+	glm::vec3 next = centre + u * std::cos(angle) + v * std::sin(angle);
+	line3D(prev, next, colour);
+	prev = next;
+    }
+}
+
+void DebugDraw::sphere3D(glm::vec3 centre, float radius, glm::vec4 colour, int segments) {
+    circle3D(centre, glm::vec3(1, 0, 0), radius, colour, segments);
+    circle3D(centre, glm::vec3(0, 1, 0), radius, colour, segments);
+    circle3D(centre, glm::vec3(0, 0, 1), radius, colour, segments);
+}
+
+void DebugDraw::arrow3D(glm::vec3 from, glm::vec3 to, glm::vec4 colour, float headSize) {
+    line3D(from, to, colour);
+    glm::vec3 dir = to - from;
+    float len = glm::length(dir);
+    if(len == 0.0f)
+	return;
+    dir /= len;
+    glm::vec3 helper = std::abs(dir.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+    glm::vec3 u = glm::normalize(glm::cross(dir, helper)) * headSize * 0.5f;
+    glm::vec3 v = glm::cross(dir, u);
+    glm::vec3 base = to - dir * headSize;
+    line3D(to, base + u, colour);
+    line3D(to, base - u, colour);
+    line3D(to, base + v, colour);
+    line3D(to, base - v, colour);
+}
@@ -147,17 +147,11 @@ int main() {
 				glm::vec3(1.0f, 0.0f, 0.0f)),
 			glm::radians(rot), glm::vec3(0.0f, 1.0f, 0.0f));
 	    
-	    auto monkeyNormalMat = glm::inverse(glm::transpose(monkeyMat));
-	    render->DrawModel(suzanneModel, monkeyMat, monkeyNormalMat,
-			      glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+	    render->DrawModel(suzanneModel, monkeyMat, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
 	    monkeyMat = glm::translate(monkeyMat, glm::vec3(100.0f, 0.0f, 0.0f));
-	    monkeyNormalMat = glm::inverse(glm::transpose(monkeyMat));
-	    render->DrawModel(suzanneModel, monkeyMat, monkeyNormalMat,
-			      glm::vec4(1.0f, 0.0f, 0.0f, 1.0f));
+	    render->DrawModel(suzanneModel, monkeyMat, glm::vec4(1.0f, 0.0f, 0.0f, 1.0f));
 	    monkeyMat = glm::translate(monkeyMat, glm::vec3(100.0f, 0.0f, 0.0f));
-	    monkeyNormalMat = glm::inverse(glm::transpose(monkeyMat));
-	    render->DrawModel(suzanneModel, monkeyMat, monkeyNormalMat,
-			      glm::vec4(0.0f, 1.0f, 0.0f, 1.0f));
+	    render->DrawModel(suzanneModel, monkeyMat, glm::vec4(0.0f, 1.0f, 0.0f, 1.0f));
 
 	    auto wolfMat = glm::translate(
 		    glm::scale(
@@ -168,8 +162,7 @@ int main() {
 			    glm::vec3(2.0f, 2.0f, 2.0f)),
 		    glm::vec3(100.0f, -50.0f, 100.0f));
 	    
-	    auto wolfNormalMat = glm::inverse(glm::transpose(wolfMat));
-	    render->DrawAnimModel(animatedWolf, wolfMat, wolfNormalMat, &currentWolfAnimation);
+	    render->DrawAnimModel(animatedWolf, wolfMat, &currentWolfAnimation);
 	    
 	    wolfMat =
 		glm::scale(
@@ -179,8 +172,7 @@ int main() {
 				glm::vec3(1.0f, -0.8f, 0.5f)),
 			glm::vec3(2.0f, 2.0f, 2.0f)
 			   );
-	    wolfNormalMat = glm::inverse(glm::transpose(wolfMat));
-	    render->DrawAnimModel(animatedWolf, wolfMat, wolfNormalMat, &otherWolfAnimation);
+	    render->DrawAnimModel(animatedWolf, wolfMat, &otherWolfAnimation);
 	    
 	    render->EndDraw();
 
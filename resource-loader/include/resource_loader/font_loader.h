@@ -2,34 +2,250 @@
 #define RESOURCE_FONT_LOADER
 
 #include <graphics/font_loader.h>
-#include <graphics/texture_loader.h>
+#include <graphics/render_config.h>
+#include <graphics/glm_helper.h>
+#include <resource_loader/texture_loader.h>
 #include <glm/glm.hpp>
-#include <map>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
-struct FontData;
+// glyphs in this range are rasterised when the font is loaded,
+// any others are rasterised on demand into the font's dynamic glyph slots.
+const char FONT_FIRST_CHAR = ' ';
+const char FONT_LAST_CHAR = '~';
+const size_t FONT_CHAR_COUNT = FONT_LAST_CHAR - FONT_FIRST_CHAR + 1;
+
+struct Character {
+    bool blank = true;
+    glm::vec4 texOffset = glm::vec4(0, 0, 1, 1);
+    glm::vec2 size = glm::vec2(0);
+    glm::vec2 bearing = glm::vec2(0);
+    float advance = 0.0f;
+};
+
+/// single channel glyph image, kept until it is packed into an atlas
+struct GlyphBitmap {
+    std::vector<unsigned char> data;
+    unsigned int width = 0;
+    unsigned int height = 0;
+};
+
+struct DynamicGlyph {
+    enum class State {
+	Pending, // waiting on the worker thread
+	Ready,
+	Missing, // the font has no glyph for this codepoint
+    };
+    State state = State::Pending;
+    Character chr;
+    size_t slot = 0;
+};
+
+struct GlyphSlot {
+    bool used = false;
+    uint32_t codepoint = 0;
+    uint64_t lastUsed = 0;
+};
+
+// the font file kept open for rasterising glyphs on demand
+struct FontFace;
+
+struct FontData {
+    ~FontData();
+
+    Resource::Texture tex;
+    // the alpha channel holds a signed distance field instead of coverage
+    bool sdf = false;
+    // indexed by (c - FONT_FIRST_CHAR)
+    Character chars[FONT_CHAR_COUNT];
+    GlyphBitmap bitmaps[FONT_CHAR_COUNT];
+
+    FontFace* face = nullptr;
+    // area of the atlas reserved for dynamic glyphs, split into square cells
+    glm::vec2 atlasSize = glm::vec2(1);
+    glm::uvec2 dynamicOrigin = glm::uvec2(0);
+    unsigned int cellSize = 0;
+    std::vector<GlyphSlot> slots;
+    std::unordered_map<uint32_t, DynamicGlyph> dynamicGlyphs;
+};
+
+/// Decode the utf8 codepoint starting at text[*i], moving i past it.
+/// Invalid sequences return U+FFFD.
+inline uint32_t nextCodepoint(std::string_view text, size_t *i) {
+    unsigned char c = text[*i];
+    uint32_t codepoint;
+    size_t length;
+    if(c < 0x80) {
+	(*i)++;
+	return c;
+    } else if((c & 0xE0) == 0xC0) {
+	codepoint = c & 0x1F;
+	length = 2;
+    } else if((c & 0xF0) == 0xE0) {
+	codepoint = c & 0x0F;
+	length = 3;
+    } else if((c & 0xF8) == 0xF0) {
+	codepoint = c & 0x07;
+	length = 4;
+    } else {
+	(*i)++;
+	return 0xFFFD;
+    }
+    if(*i + length > text.size()) {
+	*i = text.size();
+	return 0xFFFD;
+    }
+    for(size_t b = 1; b < length; b++) {
+	unsigned char cont = text[*i + b];
+	if((cont & 0xC0) != 0x80) {
+	    *i += b;
+	    return 0xFFFD;
+	}
+	codepoint = (codepoint << 6) | (cont & 0x3F);
+    }
+    *i += length;
+    return codepoint;
+}
+
+struct GlyphInstance {
+    glm::mat4 model;
+    glm::vec4 texOffset;
+};
 
 class InternalFontLoader : public FontLoader {
 public:
-    InternalFontLoader(Resource::Pool pool, TextureLoader *texLoader);
+    InternalFontLoader(Resource::Pool pool, InternalTexLoader *texLoader, RenderConfig conf);
     ~InternalFontLoader();
-    Resource::Font load(std::string file) override;
-    float length(Resource::Font font, std::string text, float size) override;
+    using FontLoader::load;
+    Resource::Font load(std::string file, bool sdf) override;
+    float length(Resource::Font font, std::string_view text, float size) override;
+
+    /// returns nullptr if the font is not loaded
+    FontData* get(Resource::Font font);
+
+    /// Returns the glyph for a codepoint, or nullptr if the font has none.
+    /// Glyphs outside the preloaded range are requested from the worker thread
+    /// the first time they are used, until they are ready complete is set to false.
+    const Character* glyph(FontData* font, uint32_t codepoint, bool *complete);
+
+    /// calls draw(modelMatrix, texOffset) for each visible glyph in the utf8 text.
+    /// Does no allocation, so the renderer can write the glyphs straight into
+    /// its instance data.
+    /// Returns false if some glyphs were skipped as they are still being rasterised.
+    template <typename DrawFn>
+    bool DrawString(FontData* font, std::string_view text,
+		    glm::vec2 pos, float size, float depth,
+		    float rotate, DrawFn draw) {
+	bool complete = true;
+	size_t i = 0;
+	while(i < text.size()) {
+	    const Character* chr = glyph(font, nextCodepoint(text, &i), &complete);
+	    if(chr == nullptr)
+		continue;
+	    if(!chr->blank) {
+		glm::vec4 p = glm::vec4(pos.x, pos.y, 0, 0);
+		p.x += chr->bearing.x * size;
+		p.y -= chr->bearing.y * size;
+		p.z = chr->size.x * size;
+		p.w = chr->size.y * size;
+		draw(glmhelper::calcMatFromRect(p, rotate, depth), chr->texOffset);
+	    }
+	    pos.x += chr->advance * size;
+	}
+	return complete;
+    }
+
+    /// Returns the glyphs of the text laid out at the origin with zero depth.
+    /// Add the draw position and depth to model[3] to place them.
+    /// Layouts are kept in an LRU cache, so repeated strings aren't recomputed.
+    /// The returned glyphs are valid until the next call.
+    const std::vector<GlyphInstance>& layout(Resource::Font font, std::string_view text,
+					     float size, float rotate);
+
+    /// Call once per frame before drawing. Places glyphs finished by the
+    /// worker thread into the atlas, evicting the least recently used.
+    void newFrame();
 
-    std::vector<Resource::QuadDraw> DrawString(Resource::Font font,
-					       std::string text, glm::vec2 pos,
-					       float size, float depth,
-					       glm::vec4 colour, float rotate);
     void clearStaged();
     void loadGPU();
     void clearGPU();
-    
+
 private:
+    struct LayoutKey {
+	size_t font;
+	size_t textHash;
+	float size;
+	float rotate;
+	bool operator==(const LayoutKey &other) const {
+	    return font == other.font && textHash == other.textHash &&
+		size == other.size && rotate == other.rotate;
+	}
+    };
+    struct LayoutKeyHash {
+	size_t operator()(const LayoutKey &k) const;
+    };
+    struct CachedLayout {
+	LayoutKey key;
+	std::string text;
+	std::vector<GlyphInstance> glyphs;
+	// dynamic glyphs to mark as used on a cache hit
+	std::vector<uint32_t> dynamicCodepoints;
+    };
+
+    struct GlyphRequest {
+	FontData* font;
+	uint32_t codepoint;
+    };
+    struct RasterisedGlyph {
+	FontData* font;
+	uint32_t codepoint;
+	bool found;
+	Character chr;
+	GlyphBitmap bitmap;
+	// had no free slot on a previous frame
+	bool deferred = false;
+    };
+
     void clearFonts(std::vector<FontData*> &fonts);
-    
+    Resource::Texture loadAtlas(std::vector<FontData*> &fonts);
+    void clearLayoutCache();
+    void invalidateLayouts(FontData* font, uint32_t codepoint);
+    bool placeGlyph(RasterisedGlyph &glyph);
+    void requestGlyph(FontData* font, uint32_t codepoint);
+    void workerLoop();
+    void stopWorker();
+
     Resource::Pool pool;
-    TextureLoader *texLoader;
+    InternalTexLoader *texLoader;
+    // all fonts staged in the pool are packed into one texture on loadGPU
+    bool sharedAtlas;
     std::vector<FontData*> staged;
     std::vector<FontData*> fonts;
+
+    // most recently used layout at the front
+    std::list<CachedLayout> layoutCache;
+    std::unordered_map<LayoutKey, std::list<CachedLayout>::iterator, LayoutKeyHash> layoutLookup;
+    // layouts with pending glyphs aren't cached
+    std::vector<GlyphInstance> uncachedLayout;
+    // glyphs waiting for a slot that isn't used in the current frame
+    std::vector<RasterisedGlyph> unplacedGlyphs;
+
+    uint64_t currentFrame = 1;
+
+    std::thread worker;
+    bool workerRunning = false;
+    bool workerStop = false;
+    std::mutex workerMutex;
+    std::condition_variable workerCond;
+    std::deque<GlyphRequest> glyphRequests;
+    std::vector<RasterisedGlyph> rasterisedGlyphs;
 };
 
 #endif
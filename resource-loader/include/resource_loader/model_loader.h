@@ -13,6 +13,7 @@ class AssimpLoader;
 struct GPUMesh {
     Resource::Texture texture;
     glm::vec4 diffuseColour;
+    Resource::Bounds bounds;
 
     template <typename T_Vert>
     void load(Mesh<T_Vert>* data) {
@@ -25,6 +26,7 @@ struct GPUModel {
     std::vector<Resource::ModelAnimation> animations;
     std::map<std::string, int> animationMap;
     Resource::ModelType type;
+    Resource::Bounds bounds;
 
     template <typename T_Vert>
     GPUModel(LoadedModel<T_Vert> &model) {
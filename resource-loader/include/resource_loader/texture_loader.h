@@ -10,6 +10,10 @@ struct StagedTex {
     int width, height, nrChannels, filesize;
     std::string path;
     bool pathedTex;
+    // regions of updatable textures can be changed after loading
+    bool updatable = false;
+    // every pixel has full alpha
+    bool opaque = false;
     void deleteData();
 };
 
@@ -23,11 +27,27 @@ public:
 				  int height,
 				  int nrChannels) override;
 
+    /// Like load, but regions of the texture can be changed with updateRegion
+    /// after it is on the GPU.
+    Resource::Texture loadUpdatable(unsigned char* data,
+				    int width,
+				    int height,
+				    int nrChannels);
+    /// Copy data into a region of an updatable texture that is loaded on the GPU.
+    /// The data is copied, and must have the same channels as the texture.
+    virtual void updateRegion(Resource::Texture tex, uint32_t x, uint32_t y,
+			      uint32_t width, uint32_t height,
+			      const unsigned char* data) = 0;
+
     virtual void loadGPU() = 0;
     void clearStaged();
     virtual void clearGPU() = 0;
 
     virtual unsigned int getViewIndex(Resource::Texture tex) { return tex.ID; }
+    /// true if every pixel of the texture has full alpha
+    virtual bool isOpaque(Resource::Texture tex) { return false; }
+    /// the largest width or height of a texture, defaults to the least vulkan allows
+    virtual unsigned int getMaxSize() { return 4096; }
 
  protected:
     bool srgb, mipmapping, filterNearest;
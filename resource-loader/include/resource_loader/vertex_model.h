@@ -20,8 +20,12 @@ struct Mesh {
     Resource::Texture texture;
     glm::vec4 diffuseColour;
 
+    // indices of each simplified level of detail, using the same vertices
+    std::vector<std::vector<unsigned int>> lods;
+
     std::string texToLoad = "";
     void processMeshInfo(ModelInfo::Mesh &dataMesh);
+    void generateLODs(unsigned int count);
 };
 
 template <class T_Vert>
@@ -57,6 +61,45 @@ void loadVertices(Mesh<VertexAnim3D> *mesh, ModelInfo::Mesh &dataMesh);
 void loadVertices(Mesh<Vertex3D> *mesh, ModelInfo::Mesh &dataMesh);
 void loadVertices(Mesh<Vertex2D> *mesh, ModelInfo::Mesh &dataMesh);
 
+/// Model space bounds of a mesh. For animated meshes they are conservative,
+/// covering poses sampled over each of the animations.
+Resource::Bounds calcMeshBounds(Mesh<VertexAnim3D> *mesh,
+				std::vector<Resource::ModelAnimation> &animations);
+Resource::Bounds calcMeshBounds(Mesh<Vertex3D> *mesh,
+				std::vector<Resource::ModelAnimation> &animations);
+Resource::Bounds calcMeshBounds(Mesh<Vertex2D> *mesh,
+				std::vector<Resource::ModelAnimation> &animations);
+/// bounds containing all of the given bounds
+Resource::Bounds combineBounds(const std::vector<Resource::Bounds> &bounds);
+
+/// The box packed positions are stored within, position = offset + unorm * scale.
+/// scale has no zero components.
+template <class T_Vert>
+void packedPositionRange(Mesh<T_Vert> *mesh, glm::vec3 *offset, glm::vec3 *scale);
+/// Bytes per vertex in the layout the vertex type is stored in on the gpu.
+size_t packedVertexSize(Vertex2D vert);
+size_t packedVertexSize(Vertex3D vert);
+size_t packedVertexSize(VertexAnim3D vert);
+/// Write the mesh's vertices to dst in the layout they are stored in on the gpu,
+/// positions are packed within the range given by packedPositionRange.
+/// 2D vertices are copied as they are.
+void packVertices(Mesh<Vertex2D> *mesh, glm::vec3 offset, glm::vec3 scale, void *dst);
+void packVertices(Mesh<Vertex3D> *mesh, glm::vec3 offset, glm::vec3 scale, void *dst);
+void packVertices(Mesh<VertexAnim3D> *mesh, glm::vec3 offset, glm::vec3 scale, void *dst);
+
+/// Up to count simplified index lists, each with about half the triangles of the last.
+/// Stops early once simplifying stops making much difference.
+std::vector<std::vector<unsigned int>> simplifyLODs(const std::vector<glm::vec3> &positions,
+						    const std::vector<unsigned int> &indices,
+						    unsigned int count);
+
+/// Reorders the mesh's triangles for the post transform vertex cache, then groups of them
+/// so those likely to hide the rest are drawn first. Vertices are then stored in the order
+/// they are first used, and unused vertices are removed.
+void optimiseMesh(ModelInfo::Mesh &mesh);
+/// Reorders the triangles for the post transform vertex cache, leaving the vertices alone.
+void optimiseVertexCache(std::vector<unsigned int> &indices, size_t vertexCount);
+
 
 template <class T_Vert>
 void ModelGroup<T_Vert>::loadModel(ModelInfo::Model &modelData,
@@ -64,11 +107,21 @@ void ModelGroup<T_Vert>::loadModel(ModelInfo::Model &modelData,
     this->models.push_back(LoadedModel<T_Vert>());
     auto model = &this->models[this->models.size() - 1];
     model->ID = currentID;
+    bool optimise = modelData.optimise && !modelData.optimised;
     for(auto& meshData: modelData.meshes) {
+	if(optimise)
+	    optimiseMesh(meshData);
 	model->meshes.push_back(new Mesh<T_Vert>());
 	Mesh<T_Vert>* mesh = model->meshes.back();
 	mesh->processMeshInfo(meshData);
+	if(modelData.lodCount > 0)
+	    mesh->generateLODs(modelData.lodCount);
+	if(modelData.optimise)
+	    for(auto &lod: mesh->lods)
+		optimiseVertexCache(lod, mesh->verticies.size());
     }
+    if(optimise)
+	modelData.optimised = true;
 }
 
 template <class T_Vert>
@@ -80,6 +133,30 @@ void Mesh<T_Vert>::processMeshInfo(ModelInfo::Mesh &dataMesh) {
     this->indices = dataMesh.indices;
 }
 
+template <class T_Vert>
+void Mesh<T_Vert>::generateLODs(unsigned int count) {
+    std::vector<glm::vec3> positions(verticies.size());
+    for(size_t i = 0; i < verticies.size(); i++)
+	positions[i] = verticies[i].Position;
+    lods = simplifyLODs(positions, indices, count);
+}
+
+template <class T_Vert>
+void packedPositionRange(Mesh<T_Vert> *mesh, glm::vec3 *offset, glm::vec3 *scale) {
+    glm::vec3 minPos(0.0f), maxPos(0.0f);
+    if(!mesh->verticies.empty())
+	minPos = maxPos = mesh->verticies[0].Position;
+    for(const T_Vert &v: mesh->verticies) {
+	minPos = glm::min(minPos, glm::vec3(v.Position));
+	maxPos = glm::max(maxPos, glm::vec3(v.Position));
+    }
+    *offset = minPos;
+    *scale = maxPos - minPos;
+    for(int i = 0; i < 3; i++)
+	if((*scale)[i] == 0.0f)
+	    (*scale)[i] = 1.0f;
+}
+
 ModelInfo::Model makeQuadModel();
 
 #endif
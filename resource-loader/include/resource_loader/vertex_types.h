@@ -2,6 +2,7 @@
 #define RESOURCE_LOADER_VERTEX_TYPES_H
 
 #include <glm/glm.hpp>
+#include <stdint.h>
 
 struct Vertex2D {
     glm::vec3 Position;
@@ -22,4 +23,23 @@ struct VertexAnim3D {
     glm::vec4  Weights;
 };
 
+// The layouts 3D vertices are stored in on the gpu.
+// Positions are unorm16 within the mesh's position range, normals are
+// octahedral encoded snorm16, and texture coords are half floats.
+
+struct PackedVertex3D {
+    uint64_t Position;
+    uint32_t Normal;
+    uint32_t TexCoord;
+};
+
+struct PackedVertexAnim3D {
+    uint64_t Position;
+    uint32_t Normal;
+    uint32_t TexCoord;
+    // uint8 bone ids, unorm8 weights that sum to one
+    uint32_t BoneIDs;
+    uint32_t Weights;
+};
+
 #endif
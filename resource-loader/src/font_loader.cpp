@@ -1,31 +1,29 @@
 #include <resource_loader/font_loader.h>
+#include "rect_packer.h"
 
 #include <graphics/glm_helper.h>
 #include <graphics/logger.h>
+#include <algorithm>
 #include <stdexcept>
+#include <string>
 
 const int FONT_LOAD_SIZE = 100;
-
-struct Character {
-    Resource::Texture tex;
-    bool blank = false;
-    glm::vec4 texOffset;
-    glm::vec2 size;
-    glm::vec2 bearing;
-    float advance;
-};
-
-struct FontData {
-    unsigned char* textureData;
-    unsigned int width;
-    unsigned int height;
-    unsigned int nrChannels;
-    std::map<char, Character> chars;
-};
-
-InternalFontLoader::InternalFontLoader(Resource::Pool pool, TextureLoader * texLoader) {
+// distance fields stay sharp when scaled, so a smaller atlas is used
+const int SDF_FONT_LOAD_SIZE = 48;
+// size that glyphs outside of the preloaded range are rasterised at
+const int DYNAMIC_GLYPH_SIZE = 48;
+const unsigned int DYNAMIC_GLYPH_COLUMNS = 16;
+const unsigned int DYNAMIC_GLYPH_ROWS = 8;
+
+const unsigned int ATLAS_PADDING = 2;
+const unsigned int ATLAS_CHANNELS = 4;
+const size_t MAX_CACHED_LAYOUTS = 256;
+
+InternalFontLoader::InternalFontLoader(Resource::Pool pool, InternalTexLoader * texLoader,
+				       RenderConfig conf) {
     this->pool = pool;
     this->texLoader = texLoader;
+    this->sharedAtlas = conf.shared_font_atlas;
 }
 
 InternalFontLoader::~InternalFontLoader() {
@@ -33,86 +31,361 @@ InternalFontLoader::~InternalFontLoader() {
     clearGPU();
 }
 
-FontData* loadFont(std::string path, int fontSize);
+FontData* loadFont(std::string path, int fontSize, bool sdf);
+bool rasteriseGlyph(FontData* font, uint32_t codepoint, Character* chr, GlyphBitmap* bitmap);
 
-Resource::Font InternalFontLoader::load(std::string file) {
-    FontData* d = loadFont(file, FONT_LOAD_SIZE);
-    Resource::Texture t = texLoader->load(d->textureData,
-					  d->width,
-					  d->height,
-					  d->nrChannels);
-    d->textureData = nullptr; // ownership taken by texloader
-    for(auto& c: d->chars)
-	c.second.tex = t;
+Resource::Font InternalFontLoader::load(std::string file, bool sdf) {
+    FontData* d = loadFont(file, sdf ? SDF_FONT_LOAD_SIZE : FONT_LOAD_SIZE, sdf);
+    if(!sharedAtlas) {
+	std::vector<FontData*> font = { d };
+	d->tex = loadAtlas(font);
+    }
     staged.push_back(d);
     Resource::Font f(staged.size() - 1, pool);
     LOG("Font Loaded - pool: " << pool.ID <<
 	" - id: " << f.ID <<
+	" - sdf: " << sdf <<
 	" - path: " << file);
     return f;
 }
 
+/// Pack the glyphs of the fonts into one texture, setting their texOffsets.
+/// Each font also gets an empty area for its dynamic glyph slots.
+/// The glyph bitmaps are freed once copied into the atlas.
+Resource::Texture InternalFontLoader::loadAtlas(std::vector<FontData*> &fonts) {
+    std::vector<PackedRect> rects;
+    for(FontData* f: fonts) {
+	for(size_t c = 0; c < FONT_CHAR_COUNT; c++)
+	    if(!f->chars[c].blank)
+		rects.push_back({f->bitmaps[c].width, f->bitmaps[c].height});
+	if(f->slots.size() > 0)
+	    rects.push_back({f->cellSize * DYNAMIC_GLYPH_COLUMNS,
+			     f->cellSize * DYNAMIC_GLYPH_ROWS});
+    }
+    unsigned int width, height;
+    if(!packRects(rects, ATLAS_PADDING, texLoader->getMaxSize(), &width, &height))
+	throw std::runtime_error(
+		"Font atlas of " + std::to_string(fonts.size()) + " fonts doesn't fit in "
+		"the device's max texture size of " + std::to_string(texLoader->getMaxSize()) +
+		". Load fewer fonts into the pool, or turn off shared_font_atlas.");
+
+    // colour is white, glyphs are in the alpha channel
+    unsigned char* data = new unsigned char[width * height * ATLAS_CHANNELS];
+    for(size_t i = 0; i < width * height * ATLAS_CHANNELS; i++)
+	data[i] = (i + 1) % ATLAS_CHANNELS == 0 ? 0x00 : 0xFF;
+    size_t rectIndex = 0;
+    for(FontData* f: fonts) {
+	f->atlasSize = glm::vec2(width, height);
+	for(size_t c = 0; c < FONT_CHAR_COUNT; c++) {
+	    if(f->chars[c].blank)
+		continue;
+	    PackedRect r = rects[rectIndex++];
+	    GlyphBitmap &b = f->bitmaps[c];
+	    for(size_t y = 0; y < b.height; y++)
+		for(size_t x = 0; x < b.width; x++)
+		    data[((r.y + y) * width + r.x + x) * ATLAS_CHANNELS
+			 + ATLAS_CHANNELS - 1] = b.data[b.width * y + x];
+	    f->chars[c].texOffset = glmhelper::getTextureOffset(
+		    f->atlasSize, glm::vec4(r.x, r.y, r.width, r.height));
+	    b = GlyphBitmap();
+	}
+	if(f->slots.size() > 0) {
+	    PackedRect r = rects[rectIndex++];
+	    f->dynamicOrigin = glm::uvec2(r.x, r.y);
+	}
+    }
+    LOG("Font atlas packed - pool: " << pool.ID <<
+	" - fonts: " << fonts.size() <<
+	" - size: " << width << "x" << height);
+    // ownership of data is taken by the texture loader
+    Resource::Texture tex = texLoader->loadUpdatable(data, width, height, ATLAS_CHANNELS);
+    for(FontData* f: fonts)
+	f->tex = tex;
+    return tex;
+}
+
 void InternalFontLoader::loadGPU() {
     clearGPU();
+    if(sharedAtlas && staged.size() > 0)
+	loadAtlas(staged);
     fonts = staged;
     staged.clear();
 }
 
 void InternalFontLoader::clearFonts(std::vector<FontData *> &fonts) {
+    // the worker may be using the fonts
+    stopWorker();
     for(int i = 0; i < fonts.size(); i++)
 	delete fonts[i];
     fonts.clear();
 }
 
-void InternalFontLoader::clearGPU() { clearFonts(fonts); }
+void InternalFontLoader::clearGPU() {
+    clearFonts(fonts);
+    clearLayoutCache();
+}
 
 void InternalFontLoader::clearStaged() { clearFonts(staged); }
 
-float InternalFontLoader::length(Resource::Font font, std::string text, float size) {
+void InternalFontLoader::clearLayoutCache() {
+    layoutCache.clear();
+    layoutLookup.clear();
+}
+
+/// remove the cached layouts of this font that use the given dynamic glyph
+void InternalFontLoader::invalidateLayouts(FontData* font, uint32_t codepoint) {
+    size_t fontID = 0;
+    while(fontID < fonts.size() && fonts[fontID] != font)
+	fontID++;
+    for(auto it = layoutCache.begin(); it != layoutCache.end();) {
+	if(it->key.font == fontID &&
+	   std::find(it->dynamicCodepoints.begin(), it->dynamicCodepoints.end(),
+		     codepoint) != it->dynamicCodepoints.end()) {
+	    layoutLookup.erase(it->key);
+	    it = layoutCache.erase(it);
+	} else
+	    it++;
+    }
+}
+
+FontData* InternalFontLoader::get(Resource::Font font) {
     if(font.ID >= fonts.size()) {
 	LOG_ERROR("font ID: " << font.ID << " was out of range: " << fonts.size());
-	return 0.0f;
+	return nullptr;
     }
+    return fonts[font.ID];
+}
+
+const Character* InternalFontLoader::glyph(FontData* font, uint32_t codepoint,
+					   bool *complete) {
+    if(codepoint < (uint32_t)FONT_FIRST_CHAR)
+	return nullptr;
+    if(codepoint <= (uint32_t)FONT_LAST_CHAR)
+	return &font->chars[codepoint - FONT_FIRST_CHAR];
+    if(font->slots.size() == 0)
+	return nullptr;
+    auto g = font->dynamicGlyphs.find(codepoint);
+    if(g == font->dynamicGlyphs.end()) {
+	font->dynamicGlyphs[codepoint] = DynamicGlyph();
+	requestGlyph(font, codepoint);
+	*complete = false;
+	return nullptr;
+    }
+    switch(g->second.state) {
+    case DynamicGlyph::State::Pending:
+	*complete = false;
+	return nullptr;
+    case DynamicGlyph::State::Missing:
+	return nullptr;
+    case DynamicGlyph::State::Ready:
+	font->slots[g->second.slot].lastUsed = currentFrame;
+	return &g->second.chr;
+    }
+    return nullptr;
+}
+
+size_t InternalFontLoader::LayoutKeyHash::operator()(const LayoutKey &k) const {
+    size_t h = std::hash<size_t>()(k.font);
+    h ^= k.textHash + 0x9e3779b9 + (h << 6) + (h >> 2);
+    h ^= std::hash<float>()(k.size) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    h ^= std::hash<float>()(k.rotate) + 0x9e3779b9 + (h << 6) + (h >> 2);
+    return h;
+}
+
+const std::vector<GlyphInstance>& InternalFontLoader::layout(
+	Resource::Font font, std::string_view text, float size, float rotate) {
+    uncachedLayout.clear();
+    FontData* f = get(font);
+    if(f == nullptr)
+	return uncachedLayout;
+    LayoutKey key { font.ID, std::hash<std::string_view>()(text), size, rotate };
+    auto entry = layoutLookup.find(key);
+    if(entry != layoutLookup.end()) {
+	if(entry->second->text == text) {
+	    layoutCache.splice(layoutCache.begin(), layoutCache, entry->second);
+	    // keep the dynamic glyphs from being evicted
+	    bool complete = true;
+	    for(uint32_t codepoint: entry->second->dynamicCodepoints)
+		glyph(f, codepoint, &complete);
+	    return entry->second->glyphs;
+	}
+	// hash collision, replace the old layout
+	layoutCache.erase(entry->second);
+	layoutLookup.erase(entry);
+    }
+    bool complete = DrawString(f, text, glm::vec2(0), size, 0.0f, rotate,
+			       [this](const glm::mat4 &model, glm::vec4 texOffset) {
+				   uncachedLayout.push_back({model, texOffset});
+			       });
+    if(!complete)
+	return uncachedLayout;
+    if(layoutCache.size() >= MAX_CACHED_LAYOUTS) {
+	layoutLookup.erase(layoutCache.back().key);
+	layoutCache.pop_back();
+    }
+    layoutCache.push_front(CachedLayout());
+    CachedLayout &cached = layoutCache.front();
+    cached.key = key;
+    cached.text = text;
+    cached.glyphs.swap(uncachedLayout);
+    for(size_t i = 0; i < text.size();) {
+	uint32_t codepoint = nextCodepoint(text, &i);
+	if(codepoint > (uint32_t)FONT_LAST_CHAR)
+	    cached.dynamicCodepoints.push_back(codepoint);
+    }
+    layoutLookup[key] = layoutCache.begin();
+    return cached.glyphs;
+}
+
+float InternalFontLoader::length(Resource::Font font, std::string_view text, float size) {
+    FontData* f = get(font);
+    if(f == nullptr)
+	return 0.0f;
     float sz = 0;
-    for(std::string::const_iterator c = text.begin(); c != text.end(); c++) {
-	if(fonts[font.ID]->chars.count(*c) == 0)
-	    continue;
-	sz += fonts[font.ID]->chars.at(*c).advance * size;
+    bool complete = true;
+    for(size_t i = 0; i < text.size();) {
+	const Character* chr = glyph(f, nextCodepoint(text, &i), &complete);
+	if(chr != nullptr)
+	    sz += chr->advance * size;
     }
     return sz;
 }
 
-std::vector<Resource::QuadDraw> InternalFontLoader::DrawString(Resource::Font font,
-							       std::string text,
-							       glm::vec2 pos,
-							       float size,
-							       float depth,
-							       glm::vec4 colour,
-							       float rotate) {
-    if(font.ID >= fonts.size()) {
-	LOG_ERROR("font ID: " << font.ID << " was out of range: " << fonts.size());
-	return {};
+
+/// ---- Dynamic Glyphs ----
+
+void InternalFontLoader::requestGlyph(FontData* font, uint32_t codepoint) {
+    std::lock_guard<std::mutex> lock(workerMutex);
+    if(!workerRunning) {
+	workerStop = false;
+	workerRunning = true;
+	worker = std::thread(&InternalFontLoader::workerLoop, this);
     }
-    std::vector<Resource::QuadDraw> draws;
-    for(std::string::const_iterator c = text.begin(); c != text.end(); c++) {
-	if(fonts[font.ID]->chars.count(*c) == 0)
-	    continue;
-	Character chr = fonts[font.ID]->chars.at(*c);
-	if(!chr.blank) {
-	    glm::vec4 p = glm::vec4(pos.x, pos.y, 0, 0);
-	    p.x += chr.bearing.x * size;
-	    p.y += (chr.size.y - chr.bearing.y) * size;
-	    p.y -= chr.size.y * size;
-	    p.z = chr.size.x  * size;
-	    p.w = chr.size.y * size;
-	    glm::mat4 model = glmhelper::calcMatFromRect(p, rotate, depth);
-	    draws.push_back(
-		    Resource::QuadDraw(
-			    chr.tex, model, colour, chr.texOffset));
+    glyphRequests.push_back({font, codepoint});
+    workerCond.notify_one();
+}
+
+void InternalFontLoader::workerLoop() {
+    std::unique_lock<std::mutex> lock(workerMutex);
+    while(true) {
+	workerCond.wait(lock, [this] { return workerStop || !glyphRequests.empty(); });
+	if(workerStop)
+	    return;
+	GlyphRequest request = glyphRequests.front();
+	glyphRequests.pop_front();
+	lock.unlock();
+
+	RasterisedGlyph g;
+	g.font = request.font;
+	g.codepoint = request.codepoint;
+	g.found = rasteriseGlyph(request.font, request.codepoint, &g.chr, &g.bitmap);
+
+	lock.lock();
+	rasterisedGlyphs.push_back(std::move(g));
+    }
+}
+
+void InternalFontLoader::stopWorker() {
+    {
+	std::lock_guard<std::mutex> lock(workerMutex);
+	if(!workerRunning)
+	    return;
+	workerStop = true;
+	workerCond.notify_one();
+    }
+    worker.join();
+    workerRunning = false;
+    glyphRequests.clear();
+    rasterisedGlyphs.clear();
+    unplacedGlyphs.clear();
+    // glyphs that were waiting on the worker can be requested again
+    for(FontData* f: fonts)
+	for(auto it = f->dynamicGlyphs.begin(); it != f->dynamicGlyphs.end();)
+	    if(it->second.state == DynamicGlyph::State::Pending)
+		it = f->dynamicGlyphs.erase(it);
+	    else
+		it++;
+}
+
+void InternalFontLoader::newFrame() {
+    currentFrame++;
+    std::vector<RasterisedGlyph> finished;
+    {
+	std::lock_guard<std::mutex> lock(workerMutex);
+	finished.swap(rasterisedGlyphs);
+    }
+    // glyphs that had no free slot last frame go first
+    if(!unplacedGlyphs.empty()) {
+	finished.insert(finished.begin(),
+			std::make_move_iterator(unplacedGlyphs.begin()),
+			std::make_move_iterator(unplacedGlyphs.end()));
+	unplacedGlyphs.clear();
+    }
+    for(RasterisedGlyph &g: finished)
+	if(!placeGlyph(g))
+	    unplacedGlyphs.push_back(std::move(g));
+}
+
+/// copy the glyph into the least recently used slot of its font's atlas area,
+/// and upload that cell to the texture.
+/// Returns false if every slot was used this frame, the glyph stays pending.
+bool InternalFontLoader::placeGlyph(RasterisedGlyph &g) {
+    FontData* f = g.font;
+    if(!g.found) {
+	f->dynamicGlyphs[g.codepoint].state = DynamicGlyph::State::Missing;
+	return true;
+    }
+    size_t slot = f->slots.size();
+    for(size_t i = 0; i < f->slots.size(); i++) {
+	if(!f->slots[i].used) {
+	    slot = i;
+	    break;
 	}
-	pos.x += chr.advance * size;
+	// glyphs drawn this frame are still referenced by this frame's draws
+	if(f->slots[i].lastUsed == currentFrame)
+	    continue;
+	if(slot == f->slots.size() || f->slots[i].lastUsed < f->slots[slot].lastUsed)
+	    slot = i;
     }
-    return draws;
+    if(slot == f->slots.size()) {
+	if(!g.deferred)
+	    LOG_ERROR("no free dynamic glyph slots for glyph " << g.codepoint
+		      << ", more dynamic glyphs were drawn this frame than the atlas holds. "
+		      "It will be placed once a slot is free");
+	g.deferred = true;
+	return false;
+    }
+    if(f->slots[slot].used) {
+	f->dynamicGlyphs.erase(f->slots[slot].codepoint);
+	invalidateLayouts(f, f->slots[slot].codepoint);
+    }
+    f->slots[slot].used = true;
+    f->slots[slot].codepoint = g.codepoint;
+    f->slots[slot].lastUsed = currentFrame;
+
+    unsigned int cellX = f->dynamicOrigin.x + (slot % DYNAMIC_GLYPH_COLUMNS) * f->cellSize;
+    unsigned int cellY = f->dynamicOrigin.y + (slot / DYNAMIC_GLYPH_COLUMNS) * f->cellSize;
+    unsigned int usable = f->cellSize - ATLAS_PADDING;
+    unsigned int w = g.bitmap.width < usable ? g.bitmap.width : usable;
+    unsigned int h = g.bitmap.height < usable ? g.bitmap.height : usable;
+    if(w != g.bitmap.width || h != g.bitmap.height)
+	LOG_ERROR("glyph " << g.codepoint << " was larger than its atlas cell, "
+		  "it will be cropped");
+    // upload the whole cell, so the previous glyph is cleared
+    std::vector<unsigned char> cell(f->cellSize * f->cellSize * ATLAS_CHANNELS, 0xFF);
+    for(size_t y = 0; y < f->cellSize; y++)
+	for(size_t x = 0; x < f->cellSize; x++)
+	    cell[(y * f->cellSize + x) * ATLAS_CHANNELS + ATLAS_CHANNELS - 1] =
+		x < w && y < h ? g.bitmap.data[g.bitmap.width * y + x] : 0x00;
+    texLoader->updateRegion(f->tex, cellX, cellY, f->cellSize, f->cellSize, cell.data());
+
+    DynamicGlyph &dynamic = f->dynamicGlyphs[g.codepoint];
+    dynamic.state = DynamicGlyph::State::Ready;
+    dynamic.slot = slot;
+    dynamic.chr = g.chr;
+    dynamic.chr.texOffset = glmhelper::getTextureOffset(
+	    f->atlasSize, glm::vec4(cellX, cellY, w, h));
+    return true;
 }
 
 
@@ -122,23 +395,34 @@ std::vector<Resource::QuadDraw> InternalFontLoader::DrawString(Resource::Font fo
 #ifdef NO_FREETYPE
 
 #include <stdexcept>
-FontData* loadFont(std::string path, int fontSize) {
+FontData* loadFont(std::string path, int fontSize, bool sdf) {
     throw std::runtime_error("Tried to load font, but application "
 			     "was build without the freetype library");
 }
 
+bool rasteriseGlyph(FontData* font, uint32_t codepoint, Character* chr, GlyphBitmap* bitmap) {
+    return false;
+}
+
+FontData::~FontData() {}
+
 #else
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
-const char FIRST_CHAR = ' ';
-const char LAST_CHAR = '~';
-const size_t CHANNELS = 4;
+#include <cstring>
+
+// sdf rendering was added to freetype in 2.11
+#if FREETYPE_MAJOR == 2 && FREETYPE_MINOR < 11
+#define FT_NO_SDF_RENDERER
+#endif
 
 struct FtLib {
     FT_Library lib;
-    
+    // the library and faces are used by the glyph worker threads
+    std::mutex mutex;
+
     FtLib() {
 	if(FT_Init_FreeType(&lib))
 	    throw std::runtime_error("failed to load freetype library");
@@ -148,103 +432,99 @@ struct FtLib {
     }
 } ftlib;
 
-struct CharData {
-    unsigned char* data;
-    int width;
-    int height;
-    Character c;
+struct FontFace {
+    FT_Face face;
 };
 
-CharData makeChar(unsigned char* buffer, const FT_Face &face, int size);
-
-CharData blankChar(const FT_Face &face, int size) {
-    return makeChar(nullptr, face, size);
+FontData::~FontData() {
+    if(face == nullptr)
+	return;
+    std::lock_guard<std::mutex> lock(ftlib.mutex);
+    FT_Done_Face(face->face);
+    delete face;
 }
 
-CharData loadChar(FT_Face face, char c, int size);
+void loadChar(FT_Face face, uint32_t codepoint, int size, bool sdf,
+	      Character *chr, GlyphBitmap *bitmap);
 
-FontData* loadFont(std::string path, int fontSize) {
-    FontData* fontD = new FontData();
+FontData* loadFont(std::string path, int fontSize, bool sdf) {
+#ifdef FT_NO_SDF_RENDERER
+    if(sdf)
+	throw std::runtime_error("Tried to load an sdf font, but the freetype "
+				 "library is older than 2.11");
+#endif
+    std::lock_guard<std::mutex> lock(ftlib.mutex);
     FT_Face face;
     if (FT_New_Face(ftlib.lib, path.c_str(), 0, &face))
 	throw std::runtime_error("failed to load font at " + path);
-    
-    FT_Set_Pixel_Sizes(face, 0, fontSize);
-    
-    size_t largestHeight = 0;
-    size_t totalWidth = 0;
-    size_t spacing = 2;
-    std::map<char, CharData> charMap;
-    for (unsigned char c = FIRST_CHAR; c < LAST_CHAR; c++) {
-	charMap[c] = loadChar(face, c, fontSize);
-	
-	totalWidth += charMap[c].width + spacing;
-	largestHeight = charMap[c].height > largestHeight ?
-	    charMap[c].height : largestHeight;
-    }
-    fontD->width = totalWidth;
-    fontD->height = largestHeight;
-    fontD->nrChannels = CHANNELS;
-    fontD->textureData = new unsigned char[totalWidth * largestHeight * fontD->nrChannels];
-    size_t widthOffset = 0;
-    for (unsigned char c = FIRST_CHAR; c < LAST_CHAR; c++) {
-	for(size_t x = 0; x < charMap[c].width + spacing; x++) {
-	    for(size_t y = 0; y < largestHeight; y++) {
-		for (size_t byte = 0; byte < fontD->nrChannels; byte++) {
-		    fontD->textureData[(totalWidth*fontD->nrChannels*y)
-				       + (widthOffset*fontD->nrChannels)
-				       + (x * fontD->nrChannels) + byte]
-			= y < charMap[c].height && x < charMap[c].width
-			?
-			(byte == fontD->nrChannels - 1 ? //last channel has the rendered colour
-			 charMap[c].data[charMap[c].width * y + x]
-			 : 0xFF)
-			: 0x00;
-		}
-	    }
-	}
-	delete[] charMap[c].data;
-	charMap[c].c.texOffset = glmhelper::getTextureOffset(
-		glm::vec2(totalWidth, largestHeight),
-		glm::vec4(widthOffset, 0, charMap[c].width, charMap[c].height));
 
-	fontD->chars[c] = charMap[c].c;							     
-	widthOffset += charMap[c].width + spacing;
-    }
+    FT_Set_Pixel_Sizes(face, 0, fontSize);
 
-    FT_Done_Face(face);
+    FontData* fontD = new FontData();
+    fontD->sdf = sdf;
+    for (unsigned char c = FONT_FIRST_CHAR; c <= FONT_LAST_CHAR; c++)
+	loadChar(face, c, fontSize, sdf,
+		 &fontD->chars[c - FONT_FIRST_CHAR],
+		 &fontD->bitmaps[c - FONT_FIRST_CHAR]);
+
+    // keep the face open for rasterising other glyphs on demand
+    fontD->face = new FontFace { face };
+    fontD->cellSize = DYNAMIC_GLYPH_SIZE + DYNAMIC_GLYPH_SIZE / 4 + ATLAS_PADDING;
+    if(sdf) // room for the distance field spread on each side
+	fontD->cellSize += 16;
+    fontD->slots.resize(DYNAMIC_GLYPH_COLUMNS * DYNAMIC_GLYPH_ROWS);
     return fontD;
 }
 
+bool rasteriseGlyph(FontData* font, uint32_t codepoint, Character* chr, GlyphBitmap* bitmap) {
+    std::lock_guard<std::mutex> lock(ftlib.mutex);
+    FT_Face face = font->face->face;
+    if(FT_Get_Char_Index(face, codepoint) == 0)
+	return false;
+    FT_Set_Pixel_Sizes(face, 0, DYNAMIC_GLYPH_SIZE);
+    loadChar(face, codepoint, DYNAMIC_GLYPH_SIZE, font->sdf, chr, bitmap);
+    return true;
+}
 
-CharData makeChar(unsigned char* buffer, const FT_Face &face, int size) {
-    CharData c;
-    c.data = buffer;
-    c.width = face->glyph->bitmap.width;
-    c.height = face->glyph->bitmap.rows;
-    if(buffer == nullptr)
-	c.c.blank = true;
-    c.c.size = glm::vec2(
-	    c.width / (float)size,
-	    c.height / (float)size);
-    c.c.bearing = glm::vec2(
-	    face->glyph->bitmap_left / (float)size,
-	    face->glyph->bitmap_top / (float)size);
-    c.c.advance = (float)(face->glyph->advance.x >> 6) / (float)size;
-    return c;
-}
-
-CharData loadChar(FT_Face face, char c, int size) {
-    CharData cd;
-    if(FT_Load_Char(face, c, FT_LOAD_RENDER)) {
-	std::cerr << "Error loading character: " << c << " from font"
+bool renderSDF(FT_Face face) {
+#ifdef FT_NO_SDF_RENDERER
+    return false;
+#else
+    // glyphs with no outline (ie space) have nothing to render
+    if(face->glyph->outline.n_points == 0)
+	return true;
+    // the distance is stored in the bitmap, 128 being the glyph's edge
+    return FT_Render_Glyph(face->glyph, FT_RENDER_MODE_SDF) == 0;
+#endif
+}
+
+void loadChar(FT_Face face, uint32_t codepoint, int size, bool sdf,
+	      Character *chr, GlyphBitmap *bitmap) {
+    *chr = Character();
+    *bitmap = GlyphBitmap();
+    if(FT_Load_Char(face, codepoint, sdf ? FT_LOAD_DEFAULT : FT_LOAD_RENDER) ||
+       (sdf && !renderSDF(face))) {
+	std::cerr << "Error loading character: " << codepoint << " from font"
 	    ". Inserting a blank\n";
-	return blankChar(face, size);
-    } else if(face->glyph->bitmap.width == 0 || face->glyph->bitmap.width == 0)
-	return blankChar(face, size);
-    int charSize = face->glyph->bitmap.width * face->glyph->bitmap.rows;
-    unsigned char* data = new unsigned char[charSize];
-    memcpy(data, face->glyph->bitmap.buffer, charSize);
-    return makeChar(data, face, size);
+	return;
+    }
+    FT_GlyphSlot glyph = face->glyph;
+    chr->advance = (float)(glyph->advance.x >> 6) / (float)size;
+    if(glyph->bitmap.width == 0 || glyph->bitmap.rows == 0)
+	return;
+    chr->blank = false;
+    chr->size = glm::vec2(
+	    glyph->bitmap.width / (float)size,
+	    glyph->bitmap.rows / (float)size);
+    chr->bearing = glm::vec2(
+	    glyph->bitmap_left / (float)size,
+	    glyph->bitmap_top / (float)size);
+    bitmap->width = glyph->bitmap.width;
+    bitmap->height = glyph->bitmap.rows;
+    bitmap->data.resize(bitmap->width * bitmap->height);
+    for(size_t y = 0; y < bitmap->height; y++)
+	memcpy(bitmap->data.data() + y * bitmap->width,
+	       glyph->bitmap.buffer + y * glyph->bitmap.pitch,
+	       bitmap->width);
 }
 #endif
@@ -0,0 +1,221 @@
+#include <resource_loader/vertex_model.h>
+
+#include <algorithm>
+#include <cmath>
+#include <climits>
+
+// size of the simulated post transform cache when ordering triangles
+const int VERTEX_CACHE_SIZE = 32;
+// size of the fifo cache used to find where clusters of triangles start
+const int CLUSTER_CACHE_SIZE = 16;
+
+/// Forsyth's score, recently used vertices and vertices with few
+/// triangles left are preferred, so none are left stranded.
+float vertexCacheScore(int cachePos, unsigned int remaining) {
+    if(remaining == 0)
+	return -1.0f;
+    float score = 0.0f;
+    if(cachePos >= 0) {
+	// the last triangle's vertices get a fixed score,
+	// so its neighbours aren't favoured over each other
+	if(cachePos < 3)
+	    score = 0.75f;
+	else
+	    score = std::pow(1.0f - (cachePos - 3) / (float)(VERTEX_CACHE_SIZE - 3), 1.5f);
+    }
+    return score + 2.0f / std::sqrt((float)remaining);
+}
+
+void optimiseVertexCache(std::vector<unsigned int> &indices, size_t vertexCount) {
+    size_t triCount = indices.size() / 3;
+    if(triCount == 0)
+	return;
+
+    // the triangles that haven't been emitted around vertex v are
+    // triList[triStart[v]] to triList[triStart[v] + remaining[v]]
+    std::vector<unsigned int> triStart(vertexCount + 1, 0);
+    for(size_t i = 0; i < triCount * 3; i++)
+	triStart[indices[i] + 1]++;
+    for(size_t v = 0; v < vertexCount; v++)
+	triStart[v + 1] += triStart[v];
+    std::vector<unsigned int> remaining(vertexCount);
+    for(size_t v = 0; v < vertexCount; v++)
+	remaining[v] = triStart[v + 1] - triStart[v];
+    std::vector<unsigned int> triList(triCount * 3);
+    std::vector<unsigned int> cursor(triStart.begin(), triStart.end() - 1);
+    for(size_t i = 0; i < triCount * 3; i++)
+	triList[cursor[indices[i]]++] = (unsigned int)(i / 3);
+
+    std::vector<int> cachePos(vertexCount, -1);
+    std::vector<float> vertScore(vertexCount);
+    for(size_t v = 0; v < vertexCount; v++)
+	vertScore[v] = vertexCacheScore(-1, remaining[v]);
+    std::vector<float> triScore(triCount, 0.0f);
+    for(size_t i = 0; i < triCount * 3; i++)
+	triScore[i / 3] += vertScore[indices[i]];
+    std::vector<bool> emitted(triCount, false);
+
+    std::vector<unsigned int> result;
+    result.reserve(triCount * 3);
+    std::vector<unsigned int> cache, nextCache;
+    size_t scan = 0;
+    size_t best = 0;
+    bool haveBest = false;
+    while(result.size() < triCount * 3) {
+	// nothing in the cache has triangles left, start somewhere new
+	if(!haveBest) {
+	    while(emitted[scan])
+		scan++;
+	    best = scan;
+	}
+	emitted[best] = true;
+	const unsigned int *tri = &indices[best * 3];
+	result.insert(result.end(), tri, tri + 3);
+
+	for(int k = 0; k < 3; k++) {
+	    unsigned int v = tri[k];
+	    unsigned int *list = &triList[triStart[v]];
+	    for(unsigned int i = 0; i < remaining[v]; i++)
+		if(list[i] == best) {
+		    list[i] = list[remaining[v] - 1];
+		    remaining[v]--;
+		    break;
+		}
+	}
+
+	nextCache.clear();
+	for(int k = 0; k < 3; k++)
+	    if(std::find(nextCache.begin(), nextCache.end(), tri[k]) == nextCache.end())
+		nextCache.push_back(tri[k]);
+	for(unsigned int v: cache)
+	    if(std::find(nextCache.begin(), nextCache.end(), v) == nextCache.end())
+		nextCache.push_back(v);
+
+	// evicted vertices are rescored too, their cache bonus is gone
+	for(size_t i = 0; i < nextCache.size(); i++) {
+	    unsigned int v = nextCache[i];
+	    cachePos[v] = i < VERTEX_CACHE_SIZE ? (int)i : -1;
+	    float score = vertexCacheScore(cachePos[v], remaining[v]);
+	    float delta = score - vertScore[v];
+	    vertScore[v] = score;
+	    for(unsigned int t = 0; t < remaining[v]; t++)
+		triScore[triList[triStart[v] + t]] += delta;
+	}
+	if(nextCache.size() > VERTEX_CACHE_SIZE)
+	    nextCache.resize(VERTEX_CACHE_SIZE);
+	cache.swap(nextCache);
+
+	haveBest = false;
+	float bestScore = -1.0f;
+	for(unsigned int v: cache)
+	    for(unsigned int i = 0; i < remaining[v]; i++) {
+		unsigned int t = triList[triStart[v] + i];
+		if(triScore[t] > bestScore) {
+		    bestScore = triScore[t];
+		    best = t;
+		    haveBest = true;
+		}
+	    }
+    }
+    indices.swap(result);
+}
+
+/// Splits the triangles into clusters where the cache would be cold anyway,
+/// then draws clusters that face away from the middle of the mesh first,
+/// as they are the most likely to hide the rest of it.
+void optimiseOverdraw(std::vector<unsigned int> &indices,
+		      const std::vector<glm::vec3> &positions) {
+    size_t triCount = indices.size() / 3;
+    std::vector<size_t> clusterStart;
+    std::vector<unsigned int> fifo(CLUSTER_CACHE_SIZE, UINT_MAX);
+    size_t fifoNext = 0;
+    for(size_t t = 0; t < triCount; t++) {
+	int misses = 0;
+	for(int k = 0; k < 3; k++) {
+	    unsigned int v = indices[t * 3 + k];
+	    if(std::find(fifo.begin(), fifo.end(), v) != fifo.end())
+		continue;
+	    misses++;
+	    fifo[fifoNext] = v;
+	    fifoNext = (fifoNext + 1) % CLUSTER_CACHE_SIZE;
+	}
+	if(t == 0 || misses == 3)
+	    clusterStart.push_back(t);
+    }
+    if(clusterStart.size() < 2)
+	return;
+    clusterStart.push_back(triCount);
+
+    size_t clusterCount = clusterStart.size() - 1;
+    std::vector<glm::vec3> centroid(clusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> normal(clusterCount, glm::vec3(0.0f));
+    std::vector<float> area(clusterCount, 0.0f);
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for(size_t c = 0; c < clusterCount; c++) {
+	for(size_t t = clusterStart[c]; t < clusterStart[c + 1]; t++) {
+	    glm::vec3 p0 = positions[indices[t * 3]];
+	    glm::vec3 p1 = positions[indices[t * 3 + 1]];
+	    glm::vec3 p2 = positions[indices[t * 3 + 2]];
+	    // the cross product's length is twice the area, so weights by area
+	    glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+	    float a = glm::length(n);
+	    centroid[c] += (p0 + p1 + p2) * (a / 3.0f);
+	    normal[c] += n;
+	    area[c] += a;
+	}
+	meshCentroid += centroid[c];
+	meshArea += area[c];
+	if(area[c] > 0.0f)
+	    centroid[c] /= area[c];
+    }
+    if(meshArea > 0.0f)
+	meshCentroid /= meshArea;
+
+    std::vector<float> occlusion(clusterCount, 0.0f);
+    for(size_t c = 0; c < clusterCount; c++) {
+	float len = glm::length(normal[c]);
+	if(len > 0.0f)
+	    occlusion[c] = glm::dot(centroid[c] - meshCentroid, normal[c] / len);
+    }
+    std::vector<size_t> order(clusterCount);
+    for(size_t c = 0; c < clusterCount; c++)
+	order[c] = c;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+	return occlusion[a] > occlusion[b];
+    });
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for(size_t c: order)
+	result.insert(result.end(), indices.begin() + clusterStart[c] * 3,
+		      indices.begin() + clusterStart[c + 1] * 3);
+    indices.swap(result);
+}
+
+/// vertices are stored in the order they are first used, unused vertices are removed
+void optimiseVertexFetch(ModelInfo::Mesh &mesh) {
+    std::vector<unsigned int> remap(mesh.verticies.size(), UINT_MAX);
+    std::vector<ModelInfo::Vertex> verticies;
+    verticies.reserve(mesh.verticies.size());
+    for(unsigned int &index: mesh.indices) {
+	if(remap[index] == UINT_MAX) {
+	    remap[index] = (unsigned int)verticies.size();
+	    verticies.push_back(std::move(mesh.verticies[index]));
+	}
+	index = remap[index];
+    }
+    mesh.verticies.swap(verticies);
+}
+
+void optimiseMesh(ModelInfo::Mesh &mesh) {
+    if(mesh.indices.size() < 3)
+	return;
+    mesh.indices.resize(mesh.indices.size() / 3 * 3);
+    optimiseVertexCache(mesh.indices, mesh.verticies.size());
+    std::vector<glm::vec3> positions(mesh.verticies.size());
+    for(size_t i = 0; i < mesh.verticies.size(); i++)
+	positions[i] = mesh.verticies[i].Position;
+    optimiseOverdraw(mesh.indices, positions);
+    optimiseVertexFetch(mesh);
+}
@@ -0,0 +1,268 @@
+#include "mesh_simplify.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdint.h>
+
+/// sum of squared distances to a set of planes
+struct Quadric {
+    double a2 = 0, ab = 0, ac = 0, ad = 0;
+    double b2 = 0, bc = 0, bd = 0;
+    double c2 = 0, cd = 0;
+    double d2 = 0;
+
+    void addPlane(glm::dvec3 n, double d) {
+	a2 += n.x * n.x; ab += n.x * n.y; ac += n.x * n.z; ad += n.x * d;
+	b2 += n.y * n.y; bc += n.y * n.z; bd += n.y * d;
+	c2 += n.z * n.z; cd += n.z * d;
+	d2 += d * d;
+    }
+
+    void add(const Quadric &q) {
+	a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+	b2 += q.b2; bc += q.bc; bd += q.bd;
+	c2 += q.c2; cd += q.cd;
+	d2 += q.d2;
+    }
+
+    double error(glm::dvec3 p) const {
+	return a2 * p.x * p.x + 2 * ab * p.x * p.y + 2 * ac * p.x * p.z + 2 * ad * p.x
+	    + b2 * p.y * p.y + 2 * bc * p.y * p.z + 2 * bd * p.y
+	    + c2 * p.z * p.z + 2 * cd * p.z
+	    + d2;
+    }
+};
+
+/// move the vertices of group from onto vertices of group to
+struct Collapse {
+    unsigned int from;
+    unsigned int to;
+    double cost;
+};
+
+/// vertices with the same position share a group, returns the group count
+unsigned int weldPositions(const std::vector<glm::vec3> &positions,
+			   std::vector<unsigned int> &group) {
+    std::vector<unsigned int> order(positions.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+	const glm::vec3 &p = positions[a];
+	const glm::vec3 &q = positions[b];
+	if(p.x != q.x)
+	    return p.x < q.x;
+	if(p.y != q.y)
+	    return p.y < q.y;
+	return p.z < q.z;
+    });
+    group.resize(positions.size());
+    unsigned int count = 0;
+    for(size_t i = 0; i < order.size(); i++) {
+	if(i > 0 && positions[order[i]] != positions[order[i - 1]])
+	    count++;
+	group[order[i]] = count;
+    }
+    return positions.empty() ? 0 : count + 1;
+}
+
+bool degenerate(const unsigned int *tri, const std::vector<unsigned int> &group) {
+    return group[tri[0]] == group[tri[1]] ||
+	group[tri[1]] == group[tri[2]] ||
+	group[tri[2]] == group[tri[0]];
+}
+
+glm::dvec3 triNormal(glm::dvec3 p0, glm::dvec3 p1, glm::dvec3 p2) {
+    return glm::cross(p1 - p0, p2 - p0);
+}
+
+/// lists the triangles around each group, triangles of group g are
+/// triList[triStart[g]] to triList[triStart[g + 1]]
+void buildAdjacency(const std::vector<unsigned int> &indices,
+		    const std::vector<unsigned int> &group, unsigned int groupCount,
+		    std::vector<unsigned int> &triStart, std::vector<unsigned int> &triList) {
+    triStart.assign(groupCount + 1, 0);
+    for(unsigned int i: indices)
+	triStart[group[i] + 1]++;
+    for(unsigned int g = 0; g < groupCount; g++)
+	triStart[g + 1] += triStart[g];
+    std::vector<unsigned int> cursor(triStart.begin(), triStart.end() - 1);
+    triList.resize(indices.size());
+    for(size_t i = 0; i < indices.size(); i++)
+	triList[cursor[group[indices[i]]]++] = (unsigned int)(i / 3);
+}
+
+/// groups on a border or non-manifold edge
+std::vector<bool> findLockedGroups(const std::vector<unsigned int> &indices,
+				   const std::vector<unsigned int> &group,
+				   unsigned int groupCount) {
+    std::vector<uint64_t> edges;
+    edges.reserve(indices.size());
+    for(size_t t = 0; t < indices.size(); t += 3)
+	for(int e = 0; e < 3; e++) {
+	    uint64_t a = group[indices[t + e]];
+	    uint64_t b = group[indices[t + (e + 1) % 3]];
+	    edges.push_back(a < b ? (a << 32) | b : (b << 32) | a);
+	}
+    std::sort(edges.begin(), edges.end());
+    std::vector<bool> locked(groupCount, false);
+    for(size_t i = 0; i < edges.size();) {
+	size_t run = i;
+	while(run < edges.size() && edges[run] == edges[i])
+	    run++;
+	if(run - i != 2) {
+	    locked[edges[i] >> 32] = true;
+	    locked[edges[i] & 0xFFFFFFFF] = true;
+	}
+	i = run;
+    }
+    return locked;
+}
+
+std::vector<unsigned int> simplifyMesh(const std::vector<glm::vec3> &positions,
+				       const std::vector<unsigned int> &indices,
+				       size_t targetIndexCount, float maxError) {
+    if(indices.size() <= targetIndexCount || positions.empty())
+	return indices;
+
+    std::vector<unsigned int> group;
+    unsigned int groupCount = weldPositions(positions, group);
+    std::vector<glm::dvec3> groupPos(groupCount);
+    for(size_t v = 0; v < positions.size(); v++)
+	groupPos[group[v]] = positions[v];
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for(size_t t = 0; t + 2 < indices.size(); t += 3)
+	if(!degenerate(&indices[t], group))
+	    result.insert(result.end(), indices.begin() + t, indices.begin() + t + 3);
+
+    glm::vec3 minPos = positions[0];
+    glm::vec3 maxPos = minPos;
+    for(const glm::vec3 &p: positions) {
+	minPos = glm::min(minPos, p);
+	maxPos = glm::max(maxPos, p);
+    }
+    double maxCost = maxError * glm::length(maxPos - minPos);
+    maxCost *= maxCost;
+
+    std::vector<Quadric> quadrics(groupCount);
+    for(size_t t = 0; t < result.size(); t += 3) {
+	glm::dvec3 p0 = groupPos[group[result[t]]];
+	glm::dvec3 n = triNormal(p0, groupPos[group[result[t + 1]]],
+				 groupPos[group[result[t + 2]]]);
+	double len = glm::length(n);
+	if(len == 0.0)
+	    continue;
+	n /= len;
+	for(int c = 0; c < 3; c++)
+	    quadrics[group[result[t + c]]].addPlane(n, -glm::dot(n, p0));
+    }
+    std::vector<bool> locked = findLockedGroups(result, group, groupCount);
+
+    std::vector<unsigned int> remap(positions.size());
+    std::iota(remap.begin(), remap.end(), 0);
+    std::vector<unsigned int> triStart, triList;
+    std::vector<Collapse> collapses;
+    std::vector<bool> touched;
+    std::vector<std::pair<unsigned int, unsigned int>> partners;
+    std::vector<unsigned int> unpaired;
+
+    while(result.size() > targetIndexCount) {
+	buildAdjacency(result, group, groupCount, triStart, triList);
+
+	// one candidate per edge, in its cheaper direction
+	collapses.clear();
+	for(size_t t = 0; t < result.size(); t += 3)
+	    for(int e = 0; e < 3; e++) {
+		unsigned int a = group[result[t + e]];
+		unsigned int b = group[result[t + (e + 1) % 3]];
+		if(a > b || (locked[a] && locked[b]))
+		    continue;
+		Quadric q = quadrics[a];
+		q.add(quadrics[b]);
+		double toB = q.error(groupPos[b]);
+		double toA = q.error(groupPos[a]);
+		if(!locked[a] && (locked[b] || toB <= toA))
+		    collapses.push_back({a, b, toB});
+		else
+		    collapses.push_back({b, a, toA});
+	    }
+	std::sort(collapses.begin(), collapses.end(),
+		  [](const Collapse &x, const Collapse &y) { return x.cost < y.cost; });
+
+	// groups around a collapse are left until the next pass,
+	// so each collapse is tested against the current triangles
+	touched.assign(groupCount, false);
+	size_t removed = 0;
+	for(const Collapse &c: collapses) {
+	    if(c.cost > maxCost || result.size() - removed * 3 <= targetIndexCount)
+		break;
+	    if(touched[c.from] || touched[c.to])
+		continue;
+
+	    partners.clear();
+	    unpaired.clear();
+	    size_t collapsedTris = 0;
+	    bool valid = true;
+	    for(unsigned int i = triStart[c.from]; valid && i < triStart[c.from + 1]; i++) {
+		const unsigned int *tri = &result[triList[i] * 3];
+		int fromCorner = 0, toCorner = -1;
+		for(int k = 0; k < 3; k++) {
+		    if(group[tri[k]] == c.from)
+			fromCorner = k;
+		    else if(group[tri[k]] == c.to)
+			toCorner = k;
+		}
+		unsigned int v = tri[fromCorner];
+		if(toCorner >= 0) {
+		    collapsedTris++;
+		    partners.push_back({v, tri[toCorner]});
+		    continue;
+		}
+		unpaired.push_back(v);
+		glm::dvec3 p[3];
+		for(int k = 0; k < 3; k++)
+		    p[k] = groupPos[group[tri[k]]];
+		glm::dvec3 before = triNormal(p[0], p[1], p[2]);
+		p[fromCorner] = groupPos[c.to];
+		glm::dvec3 after = triNormal(p[0], p[1], p[2]);
+		// reject flipped or heavily rotated triangles
+		if(glm::dot(before, after) <= 0.25 * glm::length(before) * glm::length(after))
+		    valid = false;
+	    }
+	    // vertices split by a seam must each have an edge to the target,
+	    // so they collapse onto a vertex with matching attributes
+	    for(size_t i = 0; valid && i < unpaired.size(); i++)
+		valid = std::find_if(partners.begin(), partners.end(),
+				     [&](const std::pair<unsigned int, unsigned int> &p) {
+					 return p.first == unpaired[i];
+				     }) != partners.end();
+	    if(!valid || collapsedTris == 0)
+		continue;
+
+	    for(const auto &p: partners)
+		remap[p.first] = p.second;
+	    quadrics[c.to].add(quadrics[c.from]);
+	    for(unsigned int i = triStart[c.from]; i < triStart[c.from + 1]; i++)
+		for(int k = 0; k < 3; k++)
+		    touched[group[result[triList[i] * 3 + k]]] = true;
+	    removed += collapsedTris;
+	}
+	if(removed == 0)
+	    break;
+
+	std::vector<unsigned int> next;
+	next.reserve(result.size() - removed * 3);
+	for(size_t t = 0; t < result.size(); t += 3) {
+	    unsigned int tri[3];
+	    for(int k = 0; k < 3; k++) {
+		tri[k] = result[t + k];
+		while(remap[tri[k]] != tri[k])
+		    tri[k] = remap[tri[k]];
+	    }
+	    if(!degenerate(tri, group))
+		next.insert(next.end(), tri, tri + 3);
+	}
+	result.swap(next);
+    }
+    return result;
+}
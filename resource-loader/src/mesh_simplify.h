@@ -0,0 +1,16 @@
+#ifndef RESOURCE_LOADER_MESH_SIMPLIFY_H
+#define RESOURCE_LOADER_MESH_SIMPLIFY_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+/// Simplify a triangle list towards targetIndexCount by collapsing edges in order
+/// of quadric error. Vertices are never moved or added, so the result indexes the
+/// same vertex data. Vertices on borders are kept, and vertices split by attribute
+/// seams only collapse along the seam. Collapses that would move a point further than
+/// maxError times the size of the mesh are skipped, so the target may not be reached.
+std::vector<unsigned int> simplifyMesh(const std::vector<glm::vec3> &positions,
+				       const std::vector<unsigned int> &indices,
+				       size_t targetIndexCount, float maxError);
+
+#endif
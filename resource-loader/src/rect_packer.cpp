@@ -0,0 +1,69 @@
+#include "rect_packer.h"
+
+#include <algorithm>
+#include <cmath>
+
+unsigned int nextPowerOfTwo(unsigned int n) {
+    unsigned int p = 1;
+    while(p < n)
+	p <<= 1;
+    return p;
+}
+
+bool shelfPack(std::vector<PackedRect> &rects, const std::vector<size_t> &order,
+	       unsigned int padding, unsigned int width, unsigned int height) {
+    unsigned int x = padding;
+    unsigned int y = padding;
+    unsigned int shelfHeight = 0;
+    for(size_t i: order) {
+	PackedRect &r = rects[i];
+	if(x + r.width + padding > width) {
+	    x = padding;
+	    y += shelfHeight;
+	    shelfHeight = 0;
+	}
+	if(x + r.width + padding > width || y + r.height + padding > height)
+	    return false;
+	r.x = x;
+	r.y = y;
+	x += r.width + padding;
+	shelfHeight = std::max(shelfHeight, r.height + padding);
+    }
+    return true;
+}
+
+bool packRects(std::vector<PackedRect> &rects, unsigned int padding, unsigned int maxSize,
+	       unsigned int *width, unsigned int *height) {
+    std::vector<size_t> order(rects.size());
+    size_t area = 0;
+    unsigned int widest = 1;
+    for(size_t i = 0; i < rects.size(); i++) {
+	order[i] = i;
+	area += (size_t)(rects[i].width + padding) * (rects[i].height + padding);
+	widest = std::max(widest, rects[i].width + padding * 2);
+    }
+    // tallest first, so each shelf wastes little space above shorter rects
+    std::sort(order.begin(), order.end(), [&rects](size_t a, size_t b) {
+	if(rects[a].height != rects[b].height)
+	    return rects[a].height > rects[b].height;
+	return rects[a].width > rects[b].width;
+    });
+
+    unsigned int w = nextPowerOfTwo(
+	    std::max(widest, (unsigned int)std::ceil(std::sqrt((double)area))));
+    unsigned int h = w > 1 ? w / 2 : 1;
+    if((size_t)w * h < area)
+	h = w;
+    // grow alternating dimensions, so the area stays near square
+    while(!shelfPack(rects, order, padding, w, h)) {
+	if(w > maxSize || h > maxSize)
+	    break;
+	if(h < w)
+	    h *= 2;
+	else
+	    w *= 2;
+    }
+    *width = w;
+    *height = h;
+    return w <= maxSize && h <= maxSize;
+}
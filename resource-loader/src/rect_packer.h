@@ -0,0 +1,21 @@
+#ifndef RESOURCE_LOADER_RECT_PACKER_H
+#define RESOURCE_LOADER_RECT_PACKER_H
+
+#include <vector>
+
+struct PackedRect {
+    unsigned int width;
+    unsigned int height;
+    // position in the packed area, set by packRects
+    unsigned int x = 0;
+    unsigned int y = 0;
+};
+
+/// Place the rects into a near square power of two area using a shelf packer,
+/// with padding between each rect and the edges of the area.
+/// The dimensions of the area are returned in width and height.
+/// Returns false if the rects don't fit in an area of maxSize by maxSize.
+bool packRects(std::vector<PackedRect> &rects, unsigned int padding, unsigned int maxSize,
+	       unsigned int *width, unsigned int *height);
+
+#endif
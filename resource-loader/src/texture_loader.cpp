@@ -4,6 +4,13 @@
 
 #include <stdexcept>
 
+bool allPixelsOpaque(unsigned char* data, int filesize, int nrChannels) {
+    for(int i = nrChannels - 1; i < filesize; i += nrChannels)
+	if(data[i] != 255)
+	    return false;
+    return true;
+}
+
 InternalTexLoader::InternalTexLoader(Resource::Pool pool, RenderConfig conf) {
     this->pool = pool;
     this->srgb = conf.srgb;
@@ -32,6 +39,7 @@ Resource::Texture InternalTexLoader::load(std::string path) {
     }
     tex.nrChannels = desiredChannels;
     tex.filesize = tex.width * tex.height * tex.nrChannels;
+    tex.opaque = allPixelsOpaque(tex.data, tex.filesize, tex.nrChannels);
     staged.push_back(tex);
     LOG("Texture Load"
 	" - pool: " << pool.ID <<
@@ -53,6 +61,7 @@ Resource::Texture InternalTexLoader::load(unsigned char* data, int width, int he
     }
     tex.nrChannels = desiredChannels;
     tex.filesize = tex.width * tex.height * tex.nrChannels;
+    tex.opaque = allPixelsOpaque(tex.data, tex.filesize, tex.nrChannels);
     staged.push_back(tex);
     LOG("Texture Load"
 	" - pool: " << pool.ID <<
@@ -61,6 +70,15 @@ Resource::Texture InternalTexLoader::load(unsigned char* data, int width, int he
     return Resource::Texture(staged.size() - 1, glm::vec2(tex.width, tex.height), pool);
 }
 
+Resource::Texture InternalTexLoader::loadUpdatable(unsigned char* data, int width,
+						   int height, int nrChannels) {
+    Resource::Texture tex = load(data, width, height, nrChannels);
+    staged[tex.ID].updatable = true;
+    // the contents can change, so it can't be assumed opaque
+    staged[tex.ID].opaque = false;
+    return tex;
+}
+
 void StagedTex::deleteData() {
     if(pathedTex)
 	stbi_image_free(data);
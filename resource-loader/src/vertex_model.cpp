@@ -1,6 +1,9 @@
 #include <resource_loader/vertex_model.h>
 
+#include "mesh_simplify.h"
+
 #include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/packing.hpp>
 #include <iostream>
 #include <cstring>
 
@@ -55,6 +58,181 @@ void loadVertices(Mesh<Vertex2D> *mesh, ModelInfo::Mesh &dataMesh) {
     }
 }
 
+// poses sampled over the length of each animation for animated mesh bounds
+const int ANIM_BOUNDS_SAMPLES = 32;
+
+template <class T_Vert>
+Resource::Bounds staticMeshBounds(Mesh<T_Vert> *mesh) {
+    Resource::Bounds bounds;
+    if(mesh->verticies.empty())
+	return bounds;
+    bounds.min = mesh->verticies[0].Position;
+    bounds.max = bounds.min;
+    for(const T_Vert &v: mesh->verticies) {
+	bounds.min = glm::min(bounds.min, v.Position);
+	bounds.max = glm::max(bounds.max, v.Position);
+    }
+    glm::vec3 centre = (bounds.min + bounds.max) * 0.5f;
+    float radius = 0.0f;
+    for(const T_Vert &v: mesh->verticies)
+	radius = glm::max(radius, glm::length(v.Position - centre));
+    bounds.sphere = glm::vec4(centre, radius);
+    return bounds;
+}
+
+void growBounds(Mesh<VertexAnim3D> *mesh, std::vector<glm::mat4> &bones,
+		Resource::Bounds *bounds, bool *first) {
+    for(const VertexAnim3D &v: mesh->verticies) {
+	glm::mat4 skin = glm::mat4(0.0f);
+	for(int i = 0; i < 4; i++)
+	    if(v.BoneIDs[i] >= 0 && v.BoneIDs[i] < bones.size())
+		skin += v.Weights[i] * bones[v.BoneIDs[i]];
+	glm::vec4 p = skin * glm::vec4(v.Position, 1.0f);
+	glm::vec3 pos = p.w == 0.0f ? v.Position : glm::vec3(p) / p.w;
+	if(*first) {
+	    bounds->min = pos;
+	    bounds->max = pos;
+	    *first = false;
+	}
+	bounds->min = glm::min(bounds->min, pos);
+	bounds->max = glm::max(bounds->max, pos);
+    }
+}
+
+Resource::Bounds calcMeshBounds(Mesh<VertexAnim3D> *mesh,
+				std::vector<Resource::ModelAnimation> &animations) {
+    if(animations.empty() || mesh->verticies.empty())
+	return staticMeshBounds(mesh);
+    Resource::Bounds bounds;
+    bool first = true;
+    for(Resource::ModelAnimation anim: animations) {
+	anim.returnToBindPose();
+	growBounds(mesh, *anim.getCurrentBones(), &bounds, &first);
+	float step = (float)(anim.getLength() / ANIM_BOUNDS_SAMPLES);
+	if(step <= 0.0f)
+	    continue;
+	for(int s = 0; s < ANIM_BOUNDS_SAMPLES; s++) {
+	    anim.Update(step);
+	    growBounds(mesh, *anim.getCurrentBones(), &bounds, &first);
+	}
+    }
+    // poses between samples are covered by the sphere around the box
+    glm::vec3 centre = (bounds.min + bounds.max) * 0.5f;
+    bounds.sphere = glm::vec4(centre, glm::length(bounds.max - centre));
+    return bounds;
+}
+
+Resource::Bounds calcMeshBounds(Mesh<Vertex3D> *mesh,
+				std::vector<Resource::ModelAnimation> &animations) {
+    return staticMeshBounds(mesh);
+}
+
+Resource::Bounds calcMeshBounds(Mesh<Vertex2D> *mesh,
+				std::vector<Resource::ModelAnimation> &animations) {
+    return staticMeshBounds(mesh);
+}
+
+Resource::Bounds combineBounds(const std::vector<Resource::Bounds> &bounds) {
+    Resource::Bounds combined;
+    if(bounds.empty())
+	return combined;
+    combined.min = bounds[0].min;
+    combined.max = bounds[0].max;
+    for(const Resource::Bounds &b: bounds) {
+	combined.min = glm::min(combined.min, b.min);
+	combined.max = glm::max(combined.max, b.max);
+    }
+    glm::vec3 centre = (combined.min + combined.max) * 0.5f;
+    float radius = 0.0f;
+    for(const Resource::Bounds &b: bounds)
+	radius = glm::max(radius, glm::length(glm::vec3(b.sphere) - centre) + b.sphere.w);
+    combined.sphere = glm::vec4(centre, radius);
+    return combined;
+}
+
+size_t packedVertexSize(Vertex2D vert) { return sizeof(Vertex2D); }
+size_t packedVertexSize(Vertex3D vert) { return sizeof(PackedVertex3D); }
+size_t packedVertexSize(VertexAnim3D vert) { return sizeof(PackedVertexAnim3D); }
+
+uint64_t packPosition(glm::vec3 pos, glm::vec3 offset, glm::vec3 scale) {
+    return glm::packUnorm4x16(glm::vec4((pos - offset) / scale, 0.0f));
+}
+
+/// folds the lower half of the octahedron over the upper half, so
+/// directions map to the unit square with even precision
+uint32_t packNormal(glm::vec3 n) {
+    float sum = glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z);
+    if(sum == 0.0f)
+	return glm::packSnorm2x16(glm::vec2(0.0f));
+    n /= sum;
+    glm::vec2 e(n.x, n.y);
+    if(n.z < 0.0f)
+	e = (1.0f - glm::abs(glm::vec2(n.y, n.x))) *
+	    glm::vec2(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+    return glm::packSnorm2x16(e);
+}
+
+void packVertices(Mesh<Vertex2D> *mesh, glm::vec3 offset, glm::vec3 scale, void *dst) {
+    std::memcpy(dst, mesh->verticies.data(), sizeof(Vertex2D) * mesh->verticies.size());
+}
+
+void packVertices(Mesh<Vertex3D> *mesh, glm::vec3 offset, glm::vec3 scale, void *dst) {
+    PackedVertex3D *packed = static_cast<PackedVertex3D*>(dst);
+    for(size_t i = 0; i < mesh->verticies.size(); i++) {
+	const Vertex3D &v = mesh->verticies[i];
+	packed[i].Position = packPosition(v.Position, offset, scale);
+	packed[i].Normal = packNormal(v.Normal);
+	packed[i].TexCoord = glm::packHalf2x16(v.TexCoord);
+    }
+}
+
+void packVertices(Mesh<VertexAnim3D> *mesh, glm::vec3 offset, glm::vec3 scale, void *dst) {
+    PackedVertexAnim3D *packed = static_cast<PackedVertexAnim3D*>(dst);
+    for(size_t i = 0; i < mesh->verticies.size(); i++) {
+	const VertexAnim3D &v = mesh->verticies[i];
+	packed[i].Position = packPosition(v.Position, offset, scale);
+	packed[i].Normal = packNormal(v.Normal);
+	packed[i].TexCoord = glm::packHalf2x16(v.TexCoord);
+	// unused bones have no weight, so any id will do
+	glm::uvec4 ids = glm::uvec4(glm::clamp(v.BoneIDs, glm::ivec4(0), glm::ivec4(255)));
+	packed[i].BoneIDs = ids.x | ids.y << 8 | ids.z << 16 | ids.w << 24;
+	// rounding error goes to the largest weight, so they still sum to one
+	float sum = v.Weights.x + v.Weights.y + v.Weights.z + v.Weights.w;
+	glm::vec4 weights = sum > 0.0f ? v.Weights / sum : glm::vec4(1, 0, 0, 0);
+	uint32_t q[4];
+	int largest = 0, total = 0;
+	for(int w = 0; w < 4; w++) {
+	    q[w] = (uint32_t)glm::round(weights[w] * 255.0f);
+	    total += (int)q[w];
+	    if(weights[w] > weights[largest])
+		largest = w;
+	}
+	q[largest] = (uint32_t)((int)q[largest] + 255 - total);
+	packed[i].Weights = q[0] | q[1] << 8 | q[2] << 16 | q[3] << 24;
+    }
+}
+
+// how far a simplified level may move the surface, relative to the mesh size
+const float LOD_MAX_ERROR = 0.05f;
+
+std::vector<std::vector<unsigned int>> simplifyLODs(const std::vector<glm::vec3> &positions,
+						    const std::vector<unsigned int> &indices,
+						    unsigned int count) {
+    std::vector<std::vector<unsigned int>> lods;
+    if(count > Resource::MAX_MODEL_LODS)
+	count = Resource::MAX_MODEL_LODS;
+    const std::vector<unsigned int> *prev = &indices;
+    for(unsigned int i = 0; i < count; i++) {
+	size_t target = prev->size() / 6 * 3;
+	std::vector<unsigned int> lod = simplifyMesh(positions, *prev, target, LOD_MAX_ERROR);
+	if(lod.empty() || lod.size() > prev->size() * 9 / 10)
+	    break;
+	lods.push_back(lod);
+	prev = &lods.back();
+    }
+    return lods;
+}
+
 ModelInfo::Model makeQuadModel() {
     ModelInfo::Mesh mesh;
     mesh.verticies.resize(4);
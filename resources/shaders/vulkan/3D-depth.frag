@@ -0,0 +1,23 @@
+#version 450
+
+// the depth pre-pass for models that aren't opaque,
+// discards the same fragments as blinnphong.frag
+
+layout(set = 3, binding = 0) uniform sampler texSamp;
+layout(set = 3, binding = 1) uniform texture2D textures[20];
+
+layout(location = 0) in vec2 inTexCoord;
+layout(location = 4) flat in vec4 inColour;
+layout(location = 5) flat in int inTexID;
+
+void main()
+{
+    uint texID = uint(inTexID);
+
+    vec4 objectColour = inColour;
+    if(texID != 0)
+        objectColour = texture(sampler2D(textures[texID], texSamp), inTexCoord) * inColour;
+
+    if(objectColour.w == 0.0)
+        discard;
+}
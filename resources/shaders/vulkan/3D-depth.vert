@@ -0,0 +1,104 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+#ifdef NO_DRAW_PARAMETERS
+// meshes are drawn one at a time, with their own material index pushed
+#define DRAW_ID 0
+#else
+#extension GL_ARB_shader_draw_parameters : require
+#define DRAW_ID gl_DrawIDARB
+#endif
+
+// the depth pre-pass for 3D-lighting.vert, with the same layout so
+// its draws can reuse the frame's instances and indirect commands
+
+layout(set = 0, binding = 0) uniform UniformBufferObject
+{
+    mat4 view;
+    mat4 proj;
+    float interpolation;
+} ubo;
+
+// model is the first three rows of an affine transform
+struct Obj3DPerFrame
+{
+    mat3x4 model;
+    vec4 colour;
+    int texID;
+};
+
+layout(std140, set = 1, binding = 0) readonly buffer PerInstanceData
+{
+    Obj3DPerFrame data[];
+} pid;
+
+// only written when interpolating
+layout(std140, set = 1, binding = 1) readonly buffer PrevInstanceData
+{
+    mat3x4 model[];
+} prev;
+
+// maps draw instances to instance data, the identity unless the draw was gpu culled
+layout(std430, set = 1, binding = 2) readonly buffer VisibleInstances
+{
+    uvec4 index[];
+} visible;
+
+#include "interpolate.glsl"
+
+mat4 affine(mat3x4 rows)
+{
+    // the missing column is filled from the identity
+    return transpose(mat4(rows));
+}
+
+mat4 instanceModel(uint instance)
+{
+    mat4 model = affine(pid.data[instance].model);
+    if(ubo.interpolation < 1.0)
+        model = interpolateAffine(affine(prev.model[instance]), model, ubo.interpolation);
+    return model;
+}
+
+struct Material
+{
+    vec4 colour;
+    // the mesh's positions are posOffset + unorm * posScale
+    vec4 posOffset;
+    vec4 posScale;
+    int texID;
+};
+
+layout(std430, set = 5, binding = 0) readonly buffer MaterialTable
+{
+    Material data[];
+} materials;
+
+layout(push_constant) uniform DrawParams
+{
+    uint materialIndex;
+} pc;
+
+// packed within the mesh's position range
+layout(location = 0) in vec4 inPos;
+layout(location = 2) in vec2 inTexCoord;
+
+// only read by 3D-depth.frag, which discards transparent texels
+layout(location = 0) out vec2 outTexCoord;
+layout(location = 4) flat out vec4 outColour;
+layout(location = 5) flat out int outTexID;
+
+// must match 3D-lighting.vert exactly, the colour pass tests for equal depth
+invariant gl_Position;
+
+void main()
+{
+    uint instance = visible.index[gl_InstanceIndex].x;
+    Material material = materials.data[pc.materialIndex + DRAW_ID];
+    outTexCoord = inTexCoord;
+    vec4 colour = pid.data[instance].colour;
+    outColour = colour.w == 0.0 ? material.colour : colour;
+    outTexID = pid.data[instance].texID < 0 ? material.texID : pid.data[instance].texID;
+    vec3 pos = material.posOffset.xyz + inPos.xyz * material.posScale.xyz;
+    vec4 fragPos = instanceModel(instance) * vec4(pos, 1.0);
+    gl_Position = ubo.proj * ubo.view * fragPos;
+}
@@ -1,15 +1,26 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
+#ifdef NO_DRAW_PARAMETERS
+// meshes are drawn one at a time, with their own material index pushed
+#define DRAW_ID 0
+#else
+#extension GL_ARB_shader_draw_parameters : require
+#define DRAW_ID gl_DrawIDARB
+#endif
 
 layout(set = 0, binding = 0) uniform UniformBufferObject
 {
     mat4 view;
     mat4 proj;
+    float interpolation;
 } ubo;
 
+// model is the first three rows of an affine transform
 struct Obj3DPerFrame
 {
-    mat4 model;
-    mat4 normalMat;
+    mat3x4 model;
+    vec4 colour;
+    int texID;
 };
 
 layout(std140, set = 1, binding = 0) readonly buffer PerInstanceData
@@ -17,6 +28,73 @@ layout(std140, set = 1, binding = 0) readonly buffer PerInstanceData
     Obj3DPerFrame data[];
 } pid;
 
+// only written when interpolating
+layout(std140, set = 1, binding = 1) readonly buffer PrevInstanceData
+{
+    mat3x4 model[];
+} prev;
+
+// maps draw instances to instance data, the identity unless the draw was gpu culled
+layout(std430, set = 1, binding = 2) readonly buffer VisibleInstances
+{
+    uvec4 index[];
+} visible;
+
+#include "interpolate.glsl"
+
+mat4 affine(mat3x4 rows)
+{
+    // the missing column is filled from the identity
+    return transpose(mat4(rows));
+}
+
+mat4 instanceModel(uint instance)
+{
+    mat4 model = affine(pid.data[instance].model);
+    if(ubo.interpolation < 1.0)
+        model = interpolateAffine(affine(prev.model[instance]), model, ubo.interpolation);
+    return model;
+}
+
+// the normal matrix up to scale, the cofactor matrix avoids an inverse
+mat3 normalMatrix(mat4 model)
+{
+    vec3 x = model[0].xyz;
+    vec3 y = model[1].xyz;
+    vec3 z = model[2].xyz;
+    return mat3(cross(y, z), cross(z, x), cross(x, y)) * sign(dot(x, cross(y, z)));
+}
+
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    // unfold the lower half of the octahedron
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+// the pool's material table, indexed by the draw's first material plus gl_DrawID
+struct Material
+{
+    vec4 colour;
+    // the mesh's positions are posOffset + unorm * posScale
+    vec4 posOffset;
+    vec4 posScale;
+    int texID;
+};
+
+layout(std430, set = 5, binding = 0) readonly buffer MaterialTable
+{
+    Material data[];
+} materials;
+
+layout(push_constant) uniform DrawParams
+{
+    uint materialIndex;
+} pc;
+
 const int MAX_BONES = 80;
 layout(set = 2, binding = 0) uniform boneView
 {
@@ -24,28 +102,40 @@ layout(set = 2, binding = 0) uniform boneView
 } bones;
 
 
-layout(location = 0) in vec3 inPos;
-layout(location = 1) in vec3 inNormal;
+// packed within the mesh's position range
+layout(location = 0) in vec4 inPos;
+// octahedral encoded
+layout(location = 1) in vec2 inNormal;
 layout(location = 2) in vec2 inTexCoord;
-layout(location = 3) in ivec4 inBoneIDs;
+layout(location = 3) in uvec4 inBoneIDs;
 layout(location = 4) in vec4 inWeights;
 
 layout(location = 0) out vec2 outTexCoord;
 layout(location = 1) out vec3 outFragPos;
 layout(location = 2) out vec3 outNormal;
 layout(location = 3) out vec3 outBoneColour;
+// the mesh's material, or the instance's overrides
+layout(location = 4) flat out vec4 outColour;
+layout(location = 5) flat out int outTexID;
 
 void main()
 {
+    uint instance = visible.index[gl_InstanceIndex].x;
     outTexCoord = inTexCoord;
+    Material material = materials.data[pc.materialIndex + DRAW_ID];
+    vec4 colour = pid.data[instance].colour;
+    outColour = colour.w == 0.0 ? material.colour : colour;
+    outTexID = pid.data[instance].texID < 0 ? material.texID : pid.data[instance].texID;
 
     mat4 skin = mat4(0.0f);
     for(int i = 0; i < 4; i++) {
       skin += inWeights[i] * bones.mat[inBoneIDs[i]];
     }
 
-    vec4 fragPos = pid.data[gl_InstanceIndex].model * skin * vec4(inPos, 1.0f);
-    outNormal = mat3(pid.data[gl_InstanceIndex].normalMat) * mat3(skin) * inNormal;
+    vec3 pos = material.posOffset.xyz + inPos.xyz * material.posScale.xyz;
+    mat4 model = instanceModel(instance);
+    vec4 fragPos = model * skin * vec4(pos, 1.0f);
+    outNormal = normalMatrix(model) * mat3(skin) * octahedralDecode(inNormal);
 
     gl_Position = ubo.proj * ubo.view * fragPos;
     outFragPos = vec3(fragPos) / fragPos.w;
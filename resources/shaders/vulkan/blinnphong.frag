@@ -1,12 +1,5 @@
 #version 450
 
-layout(push_constant) uniform fragconstants
-{
-    vec4 colour;
-    vec4 texOffset;
-    uint texID;
-} pc;
-
 layout(set = 3, binding = 0) uniform sampler texSamp;
 layout(set = 3, binding = 1) uniform texture2D textures[20];
 layout(set = 4, binding = 0) uniform LightingUBO
@@ -21,6 +14,8 @@ layout(set = 4, binding = 0) uniform LightingUBO
 layout(location = 0) in vec2 inTexCoord;
 layout(location = 1) in vec3 inFragPos;
 layout(location = 2) in vec3 inNormal;
+layout(location = 4) flat in vec4 inColour;
+layout(location = 5) flat in int inTexID;
 
 layout(location = 0) out vec4 outColour;
 
@@ -28,16 +23,14 @@ layout(location = 0) out vec4 outColour;
 void main()
 {
     vec2 coord = inTexCoord.xy;
-    coord.x *= pc.texOffset.z;
-    coord.y *= pc.texOffset.w;
-    coord.x += pc.texOffset.x;
-    coord.y += pc.texOffset.y;
+    vec4 colour = inColour;
+    uint texID = uint(inTexID);
 
     vec4 objectColour = vec4(1);
-    if(pc.texID == 0)
-        objectColour = pc.colour;
+    if(texID == 0)
+        objectColour = colour;
     else
-        objectColour = texture(sampler2D(textures[pc.texID], texSamp), coord) * pc.colour;
+        objectColour = texture(sampler2D(textures[texID], texSamp), coord) * colour;
 
 
     if(objectColour.w == 0.0)
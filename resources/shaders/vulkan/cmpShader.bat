@@ -4,3 +4,9 @@ for %%f in (*.vert) do (
 for %%f in (*.frag) do (
 	glslc %%f -o %%f.spv
 )
+for %%f in (*.comp) do (
+	glslc %%f -o %%f.spv
+)
+for /f %%f in ('findstr /m NO_DRAW_PARAMETERS *.vert') do (
+	glslc -DNO_DRAW_PARAMETERS %%f -o %%f.nodrawid.spv
+)
@@ -1,2 +1,4 @@
 find . -name '*.vert' -exec glslc {} -o {}.spv \;
 find . -name '*.frag' -exec glslc {} -o {}.spv \;
+find . -name '*.comp' -exec glslc {} -o {}.spv \;
+for f in $(grep -l NO_DRAW_PARAMETERS *.vert); do glslc -DNO_DRAW_PARAMETERS $f -o $f.nodrawid.spv; done
@@ -0,0 +1,16 @@
+#version 450
+
+layout(push_constant) uniform DebugParams {
+    mat4 viewProj;
+} params;
+
+layout(location = 0) in vec3 inPos;
+layout(location = 1) in vec4 inColour;
+
+layout(location = 0) out vec4 outColour;
+
+void main()
+{
+    outColour = inColour;
+    gl_Position = params.viewProj * vec4(inPos, 1.0);
+}
@@ -0,0 +1,33 @@
+#version 450
+
+// for 2D draws known to be fully opaque,
+// no discard so early depth testing isn't disabled.
+
+layout(set = 2, binding = 0) uniform sampler texSamp;
+layout(set = 2, binding = 1) uniform texture2D textures[20];
+
+struct per2DFragData
+{
+    vec4 colour;
+    vec4 texOffset;
+    uint texID;
+    uint flags;
+    uint clipIndex;
+};
+
+layout(std140, set = 3, binding = 0) readonly buffer PerInstanceBuffer {
+    per2DFragData data[];
+} pib;
+
+layout(location = 0) in vec3 inTexCoord;
+
+layout(location = 0) out vec4 outColour;
+
+void main()
+{
+    uint index = uint(inTexCoord.z);
+    vec4 texOffset = pib.data[index].texOffset;
+    vec2 coord = inTexCoord.xy * texOffset.zw + texOffset.xy;
+    vec4 col = texture(sampler2D(textures[pib.data[index].texID], texSamp), coord);
+    outColour = vec4(col.xyz * pib.data[index].colour.xyz, 1.0);
+}
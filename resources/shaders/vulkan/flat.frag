@@ -8,17 +8,28 @@ struct per2DFragData
     vec4 colour;
     vec4 texOffset;
     uint texID;
+    uint flags;
+    uint clipIndex;
 };
 
+const uint SDF_BIT = 1;
+const uint UNTEXTURED_BIT = 4;
+
 layout(std140, set = 3, binding = 0) readonly buffer PerInstanceBuffer {
     per2DFragData data[];
 } pib;
 
+// x, y, width, height. index 0 is unused, it means no clipping
+layout(std140, set = 3, binding = 1) readonly buffer ClipRectBuffer {
+    vec4 rects[];
+} clip;
+
 layout(location = 0) in vec3 inTexCoord;
+layout(location = 1) in vec2 inClipPos;
 
 layout(location = 0) out vec4 outColour;
 
-vec4 calcColour(vec4 texOffset, vec4 colour, uint texID)
+vec4 calcColour(vec4 texOffset, vec4 colour, uint texID, uint flags)
 {
     vec2 coord = inTexCoord.xy;
     coord.x *= texOffset.z;
@@ -26,7 +37,16 @@ vec4 calcColour(vec4 texOffset, vec4 colour, uint texID)
     coord.x += texOffset.x;
     coord.y += texOffset.y;
 
-    vec4 col = texture(sampler2D(textures[texID], texSamp), coord) * colour;
+    vec4 col = vec4(1.0);
+    if((flags & UNTEXTURED_BIT) == 0)
+        col = texture(sampler2D(textures[texID], texSamp), coord);
+    if((flags & SDF_BIT) != 0) {
+        // alpha holds the distance to the glyph edge, with the edge at 0.5
+        float dist = col.w;
+        float edge = fwidth(dist) * 0.5;
+        col.w = smoothstep(0.5 - edge, 0.5 + edge, dist);
+    }
+    col *= colour;
 
     if(col.w == 0)
         discard;
@@ -36,6 +56,14 @@ vec4 calcColour(vec4 texOffset, vec4 colour, uint texID)
 void main()
 {
     uint index = uint(inTexCoord.z);
-    outColour = calcColour(pib.data[index].texOffset, pib.data[index].colour, pib.data[index].texID);
+    uint clipIndex = pib.data[index].clipIndex;
+    if(clipIndex != 0) {
+        vec4 rect = clip.rects[clipIndex];
+        if(any(lessThan(inClipPos, rect.xy)) ||
+           any(greaterThan(inClipPos, rect.xy + rect.zw)))
+            discard;
+    }
+    outColour = calcColour(pib.data[index].texOffset, pib.data[index].colour,
+                           pib.data[index].texID, pib.data[index].flags);
 
 }
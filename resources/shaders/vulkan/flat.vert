@@ -1,26 +1,76 @@
 #version 450
+#extension GL_GOOGLE_include_directive : require
 
 layout(set = 0, binding = 0) uniform UniformBufferObject
 {
     mat4 view;
     mat4 proj;
+    float interpolation;
 } ubo;
 
+layout(set = 0, binding = 1) uniform TimeUbo
+{
+    float time;
+} timeUbo;
+
+struct Anim2D
+{
+    vec2 uvScroll;
+    uvec2 grid;
+    uint frameCount;
+    float fps;
+    float startTime;
+    uint loop;
+};
 
 layout(set = 1, binding = 0) readonly buffer PerFrameBuffer {
     mat4 model[];
 } pid;
 
+layout(set = 1, binding = 1) readonly buffer PerFrameAnimBuffer {
+    Anim2D anim[];
+} pia;
+
+// only written when interpolating
+layout(set = 1, binding = 2) readonly buffer PrevFrameBuffer {
+    mat4 model[];
+} prev;
+
 
 layout(location = 0) in vec3 inPos;
 layout(location = 1) in vec2 inTexCoord;
 
 layout(location = 0) out vec3 outTexCoord;
+// position before the view, the space clip rects are in
+layout(location = 1) out vec2 outClipPos;
+
+#include "interpolate.glsl"
+
+// uvs are still in the quad's texOffset space, that is applied in the fragment shader
+vec2 animateUV(vec2 uv, Anim2D anim)
+{
+    float t = timeUbo.time - anim.startTime;
+    if(anim.frameCount > 1) {
+        uint frame = uint(max(t, 0.0) * anim.fps);
+        if(anim.loop != 0)
+            frame = frame % anim.frameCount;
+        else
+            frame = min(frame, anim.frameCount - 1);
+        vec2 cell = vec2(frame % anim.grid.x, frame / anim.grid.x);
+        uv = (uv + cell) / vec2(anim.grid);
+    }
+    return uv + anim.uvScroll * t;
+}
 
 void main()
 {
-    outTexCoord = vec3(inTexCoord.xy, gl_InstanceIndex);
-    vec4 fragPos = ubo.view * pid.model[gl_InstanceIndex] * vec4(inPos, 1.0);
+    outTexCoord = vec3(animateUV(inTexCoord.xy, pia.anim[gl_InstanceIndex]), gl_InstanceIndex);
+    mat4 model = pid.model[gl_InstanceIndex];
+    if(ubo.interpolation < 1.0)
+        model = interpolateAffine(prev.model[gl_InstanceIndex], model, ubo.interpolation);
+    vec4 worldPos = model * vec4(inPos, 1.0);
+    outClipPos = worldPos.xy;
+    vec4 fragPos = ubo.view * worldPos;
 
     gl_Position = ubo.proj * fragPos;
 }
@@ -0,0 +1,67 @@
+// Interpolation of model matrices between simulation ticks, included by the vertex shaders.
+// The translation, scale and rotation are interpolated separately, mixing the
+// matrices themselves would shrink transforms that rotate between ticks.
+// Shear isn't kept while interpolating.
+
+// xyz imaginary, w real
+vec4 rotationQuat(mat3 r)
+{
+    float trace = r[0][0] + r[1][1] + r[2][2];
+    if(trace > 0.0) {
+        float s = 2.0 * sqrt(trace + 1.0);
+        return vec4(r[1][2] - r[2][1], r[2][0] - r[0][2], r[0][1] - r[1][0], 0.25 * s * s) / s;
+    }
+    if(r[0][0] > r[1][1] && r[0][0] > r[2][2]) {
+        float s = 2.0 * sqrt(1.0 + r[0][0] - r[1][1] - r[2][2]);
+        return vec4(0.25 * s * s, r[1][0] + r[0][1], r[2][0] + r[0][2], r[1][2] - r[2][1]) / s;
+    }
+    if(r[1][1] > r[2][2]) {
+        float s = 2.0 * sqrt(1.0 + r[1][1] - r[0][0] - r[2][2]);
+        return vec4(r[1][0] + r[0][1], 0.25 * s * s, r[2][1] + r[1][2], r[2][0] - r[0][2]) / s;
+    }
+    float s = 2.0 * sqrt(1.0 + r[2][2] - r[0][0] - r[1][1]);
+    return vec4(r[2][0] + r[0][2], r[2][1] + r[1][2], 0.25 * s * s, r[0][1] - r[1][0]) / s;
+}
+
+mat3 quatRotation(vec4 q)
+{
+    return mat3(
+            1.0 - 2.0 * (q.y * q.y + q.z * q.z),
+            2.0 * (q.x * q.y + q.w * q.z),
+            2.0 * (q.x * q.z - q.w * q.y),
+            2.0 * (q.x * q.y - q.w * q.z),
+            1.0 - 2.0 * (q.x * q.x + q.z * q.z),
+            2.0 * (q.y * q.z + q.w * q.x),
+            2.0 * (q.x * q.z + q.w * q.y),
+            2.0 * (q.y * q.z - q.w * q.x),
+            1.0 - 2.0 * (q.x * q.x + q.y * q.y));
+}
+
+void decomposeAffine(mat4 m, out vec3 scale, out vec4 rotation)
+{
+    scale = vec3(length(m[0].xyz), length(m[1].xyz), length(m[2].xyz));
+    // a mirrored transform keeps the reflection in its scale
+    if(dot(m[0].xyz, cross(m[1].xyz, m[2].xyz)) < 0.0)
+        scale.x = -scale.x;
+    vec3 divisor = mix(scale, vec3(1.0), equal(scale, vec3(0.0)));
+    rotation = rotationQuat(mat3(m[0].xyz / divisor.x,
+                                 m[1].xyz / divisor.y,
+                                 m[2].xyz / divisor.z));
+}
+
+mat4 interpolateAffine(mat4 previous, mat4 current, float t)
+{
+    vec3 prevScale, scale;
+    vec4 prevRotation, rotation;
+    decomposeAffine(previous, prevScale, prevRotation);
+    decomposeAffine(current, scale, rotation);
+    // turn the shorter way
+    if(dot(prevRotation, rotation) < 0.0)
+        prevRotation = -prevRotation;
+    mat3 r = quatRotation(normalize(mix(prevRotation, rotation, t)));
+    scale = mix(prevScale, scale, t);
+    return mat4(vec4(r[0] * scale.x, 0.0),
+                vec4(r[1] * scale.y, 0.0),
+                vec4(r[2] * scale.z, 0.0),
+                vec4(mix(previous[3].xyz, current[3].xyz, t), 1.0));
+}
@@ -0,0 +1,22 @@
+#version 450
+
+layout(set = 1, binding = 0) uniform sampler texSamp;
+layout(set = 1, binding = 1) uniform texture2D textures[20];
+
+layout(push_constant) uniform DrawParams {
+    float depth;
+    uint texID;
+} draw;
+
+layout(location = 0) in vec2 inTexCoord;
+layout(location = 1) in vec4 inColour;
+
+layout(location = 0) out vec4 outColour;
+
+void main()
+{
+    vec4 col = texture(sampler2D(textures[draw.texID], texSamp), inTexCoord) * inColour;
+    if(col.w == 0)
+    discard;
+    outColour = col;
+}
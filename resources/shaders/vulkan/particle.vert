@@ -0,0 +1,47 @@
+#version 450
+
+layout(set = 0, binding = 0) uniform UniformBufferObject
+{
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+struct Particle {
+    vec4 colour;
+    vec2 position;
+    vec2 velocity;
+    float life;
+    float maxLife;
+    float size;
+    float padding;
+};
+
+layout(std430, set = 2, binding = 1) readonly buffer AliveList {
+    uint alive[];
+};
+
+layout(std430, set = 2, binding = 2) readonly buffer ParticleBuffer {
+    Particle particles[];
+};
+
+layout(push_constant) uniform DrawParams {
+    float depth;
+    uint texID;
+} draw;
+
+layout(location = 0) out vec2 outTexCoord;
+layout(location = 1) out vec4 outColour;
+
+const vec2 CORNERS[6] = vec2[](
+    vec2(0, 0), vec2(1, 0), vec2(1, 1),
+    vec2(1, 1), vec2(0, 1), vec2(0, 0));
+
+void main()
+{
+    Particle p = particles[alive[gl_InstanceIndex]];
+    vec2 corner = CORNERS[gl_VertexIndex];
+    outTexCoord = corner;
+    outColour = p.colour;
+    vec2 pos = p.position + (corner - 0.5) * p.size;
+    gl_Position = ubo.proj * ubo.view * vec4(pos, draw.depth, 1.0);
+}
@@ -0,0 +1,101 @@
+#include "culling.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define CULL_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace cull {
+
+  float maxAxisScale(const glm::mat4 &model) {
+      return glm::max(glm::length(glm::vec3(model[0])),
+		      glm::max(glm::length(glm::vec3(model[1])),
+			       glm::length(glm::vec3(model[2]))));
+  }
+
+  bool quadOffscreen(const glm::mat4 &viewProj, const glm::mat4 &model) {
+      // clip space origin of the quad and its x and y edges,
+      // the corners are origin, +x, +y and +x+y
+      glm::vec4 o = viewProj * model[3];
+      glm::vec4 ex = viewProj * model[0];
+      glm::vec4 ey = viewProj * model[1];
+#ifdef CULL_USE_SSE
+      __m128 x = _mm_add_ps(_mm_set1_ps(o.x),
+			    _mm_setr_ps(0.0f, ex.x, ey.x, ex.x + ey.x));
+      __m128 y = _mm_add_ps(_mm_set1_ps(o.y),
+			    _mm_setr_ps(0.0f, ex.y, ey.y, ex.y + ey.y));
+      __m128 w = _mm_add_ps(_mm_set1_ps(o.w),
+			    _mm_setr_ps(0.0f, ex.w, ey.w, ex.w + ey.w));
+      __m128 negW = _mm_sub_ps(_mm_setzero_ps(), w);
+      const int ALL_CORNERS = 0xF;
+      return _mm_movemask_ps(_mm_cmplt_ps(x, negW)) == ALL_CORNERS ||
+	  _mm_movemask_ps(_mm_cmpgt_ps(x, w)) == ALL_CORNERS ||
+	  _mm_movemask_ps(_mm_cmplt_ps(y, negW)) == ALL_CORNERS ||
+	  _mm_movemask_ps(_mm_cmpgt_ps(y, w)) == ALL_CORNERS;
+#else
+      glm::vec4 corners[4] = { o, o + ex, o + ey, o + ex + ey };
+      int left = 0, right = 0, top = 0, bottom = 0;
+      for(int i = 0; i < 4; i++) {
+	  left += corners[i].x < -corners[i].w;
+	  right += corners[i].x > corners[i].w;
+	  top += corners[i].y < -corners[i].w;
+	  bottom += corners[i].y > corners[i].w;
+      }
+      return left == 4 || right == 4 || top == 4 || bottom == 4;
+#endif
+  }
+
+  bool quadOutsideRect(glm::vec4 rect, const glm::mat4 &model) {
+      glm::vec2 o = model[3];
+      glm::vec2 ex = model[0];
+      glm::vec2 ey = model[1];
+      glm::vec2 corners[4] = { o, o + ex, o + ey, o + ex + ey };
+      glm::vec2 minCorner = corners[0], maxCorner = corners[0];
+      for(int i = 1; i < 4; i++) {
+	  minCorner = glm::min(minCorner, corners[i]);
+	  maxCorner = glm::max(maxCorner, corners[i]);
+      }
+      return maxCorner.x < rect.x || minCorner.x > rect.x + rect.z ||
+	  maxCorner.y < rect.y || minCorner.y > rect.y + rect.w;
+  }
+
+  void frustumPlanes(const glm::mat4 &viewProj, glm::vec4 planes[6]) {
+      glm::vec4 rows[4];
+      for(int i = 0; i < 4; i++)
+	  rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+      planes[0] = rows[3] + rows[0];
+      planes[1] = rows[3] - rows[0];
+      planes[2] = rows[3] + rows[1];
+      planes[3] = rows[3] - rows[1];
+      planes[4] = rows[2];
+      planes[5] = rows[3] - rows[2];
+      for(int i = 0; i < 6; i++)
+	  planes[i] /= glm::length(glm::vec3(planes[i]));
+  }
+
+  bool sphereOutsideFrustum(const glm::vec4 planes[6], const glm::mat4 &model,
+			    glm::vec4 sphere) {
+      glm::vec4 centre = model * glm::vec4(glm::vec3(sphere), 1.0f);
+      float radius = sphere.w * maxAxisScale(model);
+      for(int i = 0; i < 6; i++)
+	  if(glm::dot(glm::vec3(planes[i]), glm::vec3(centre)) + planes[i].w < -radius)
+	      return true;
+      return false;
+  }
+
+  float sphereScreenHeight(const glm::mat4 &view, const glm::mat4 &proj,
+			   const glm::mat4 &model, glm::vec4 sphere) {
+      float radius = sphere.w * maxAxisScale(view * model);
+      float yScale = glm::abs(proj[1][1]);
+      // orthographic projections don't shrink with distance
+      if(proj[2][3] == 0.0f)
+	  return glm::min(radius * yScale, 1.0f);
+      glm::vec3 centre = view * model * glm::vec4(glm::vec3(sphere), 1.0f);
+      // distance rather than depth, so turning the camera doesn't change the size
+      float distance = glm::length(centre);
+      if(distance <= radius)
+	  return 1.0f;
+      return glm::min(radius * yScale / distance, 1.0f);
+  }
+
+}
@@ -0,0 +1,29 @@
+/// CPU visibility tests, used to skip draws before they take up instance slots.
+
+#ifndef VKENV_CULLING_H
+#define VKENV_CULLING_H
+
+#include <glm/glm.hpp>
+
+namespace cull {
+  /// Returns true if the unit quad transformed by model is fully outside
+  /// the x or y bounds of the clip volume of viewProj.
+  /// The four corners are tested together using SSE where available.
+  bool quadOffscreen(const glm::mat4 &viewProj, const glm::mat4 &model);
+  /// Returns true if the unit quad transformed by model is fully outside
+  /// rect (x, y, width, height), which is in the same space as the model.
+  bool quadOutsideRect(glm::vec4 rect, const glm::mat4 &model);
+  /// The normalised planes of viewProj's frustum, pointing inwards.
+  /// Left, right, bottom, top, near, far. Expects a zero to one depth range.
+  void frustumPlanes(const glm::mat4 &viewProj, glm::vec4 planes[6]);
+  /// Returns true if the bounding sphere (xyz centre, w radius) transformed by
+  /// model is fully outside one of the planes. Non-uniform scales use the largest axis.
+  bool sphereOutsideFrustum(const glm::vec4 planes[6], const glm::mat4 &model,
+			    glm::vec4 sphere);
+  /// The fraction of the screen height covered by the bounding sphere transformed by model.
+  /// Returns 1 if the camera is inside the sphere.
+  float sphereScreenHeight(const glm::mat4 &view, const glm::mat4 &proj,
+			   const glm::mat4 &model, glm::vec4 sphere);
+}
+
+#endif
@@ -0,0 +1,134 @@
+#include "debug_draw.h"
+
+#include "vkhelper.h"
+#include "logger.h"
+
+#include <glm/gtc/packing.hpp>
+#include <cstring>
+
+DebugDrawVk::DebugDrawVk(DeviceState base) {
+    this->base = base;
+}
+
+DebugDrawVk::~DebugDrawVk() {
+    destroyPipeline();
+}
+
+bool DebugDrawVk::hasSpace() {
+    if(verts2D.size() + verts3D.size() + 2 <= MAX_DEBUG_VERTICES)
+	return true;
+    if(!warnedFull) {
+	LOG("WARNING: ran out of debug line vertices this frame!\n");
+	warnedFull = true;
+    }
+    return false;
+}
+
+void DebugDrawVk::line2D(glm::vec2 a, glm::vec2 b, glm::vec4 colour) {
+    if(!hasSpace())
+	return;
+    uint32_t c = glm::packUnorm4x8(colour);
+    verts2D.push_back({glm::vec3(a, 0.0f), c});
+    verts2D.push_back({glm::vec3(b, 0.0f), c});
+}
+
+void DebugDrawVk::line3D(glm::vec3 a, glm::vec3 b, glm::vec4 colour) {
+    if(!hasSpace())
+	return;
+    uint32_t c = glm::packUnorm4x8(colour);
+    verts3D.push_back({a, c});
+    verts3D.push_back({b, c});
+}
+
+void DebugDrawVk::setPipelineTarget(VkRenderPass renderPass, VkExtent2D extent,
+				    uint32_t frameCount, part::create::PipelineConfig config) {
+    destroyPipeline();
+    target.renderPass = renderPass;
+    target.extent = extent;
+    target.frameCount = frameCount;
+    target.config = config;
+    targetSet = true;
+}
+
+bool DebugDrawVk::createPipeline() {
+    if(pipelineCreated || !targetSet)
+	return pipelineCreated;
+    checkResultAndThrow(
+	    vkhelper::createBufferAndMemory(
+		    base, sizeof(Vertex) * MAX_DEBUG_VERTICES * target.frameCount,
+		    &buffer, &memory,
+		    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+		    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT),
+	    "failed to create debug line vertex buffer");
+    vkBindBufferMemory(base.device, buffer, memory, 0);
+    void* pMem;
+    vkMapMemory(base.device, memory, 0, VK_WHOLE_SIZE, 0, &pMem);
+    mapped = (Vertex*)pMem;
+
+    std::vector<VkVertexInputBindingDescription> bindingDesc(1);
+    bindingDesc[0].binding = 0;
+    bindingDesc[0].stride = sizeof(Vertex);
+    bindingDesc[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+    std::vector<VkVertexInputAttributeDescription> attribDesc(2);
+    attribDesc[0].binding = 0;
+    attribDesc[0].location = 0;
+    attribDesc[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attribDesc[0].offset = offsetof(Vertex, pos);
+    attribDesc[1].binding = 0;
+    attribDesc[1].location = 1;
+    attribDesc[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+    attribDesc[1].offset = offsetof(Vertex, colour);
+
+    part::create::PipelineConfig config = target.config;
+    config.topology = VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+    config.useDepthTest = false;
+    config.cullMode = VK_CULL_MODE_NONE;
+    part::create::GraphicsPipeline(
+	    base.device, &pipeline, target.renderPass, {},
+	    {{VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4)}},
+	    "shaders/vulkan/debug.vert.spv", "shaders/vulkan/debug.frag.spv",
+	    target.extent, attribDesc, bindingDesc, config);
+    pipelineCreated = true;
+    return true;
+}
+
+void DebugDrawVk::destroyPipeline() {
+    targetSet = false;
+    if(!pipelineCreated)
+	return;
+    pipeline.destroy(base.device);
+    vkUnmapMemory(base.device, memory);
+    vkDestroyBuffer(base.device, buffer, nullptr);
+    vkFreeMemory(base.device, memory, nullptr);
+    mapped = nullptr;
+    pipelineCreated = false;
+}
+
+void DebugDrawVk::recordDraw(VkCommandBuffer cmdBuff, size_t frameIndex,
+			     const glm::mat4 &viewProj2D, const glm::mat4 &viewProj3D) {
+    uint32_t count3D = (uint32_t)verts3D.size();
+    uint32_t count2D = (uint32_t)verts2D.size();
+    if(count3D + count2D > 0 && createPipeline()) {
+	size_t sliceStart = frameIndex * MAX_DEBUG_VERTICES;
+	std::memcpy(mapped + sliceStart, verts3D.data(), sizeof(Vertex) * count3D);
+	std::memcpy(mapped + sliceStart + count3D, verts2D.data(), sizeof(Vertex) * count2D);
+
+	pipeline.begin(cmdBuff, frameIndex);
+	VkDeviceSize offset = sizeof(Vertex) * sliceStart;
+	vkCmdBindVertexBuffers(cmdBuff, 0, 1, &buffer, &offset);
+	if(count3D > 0) {
+	    vkCmdPushConstants(cmdBuff, pipeline.getLayout(), VK_SHADER_STAGE_VERTEX_BIT,
+			       0, sizeof(glm::mat4), &viewProj3D);
+	    vkCmdDraw(cmdBuff, count3D, 1, 0, 0);
+	}
+	if(count2D > 0) {
+	    vkCmdPushConstants(cmdBuff, pipeline.getLayout(), VK_SHADER_STAGE_VERTEX_BIT,
+			       0, sizeof(glm::mat4), &viewProj2D);
+	    vkCmdDraw(cmdBuff, count2D, 1, count3D, 0);
+	}
+    }
+    verts2D.clear();
+    verts3D.clear();
+    warnedFull = false;
+}
@@ -0,0 +1,70 @@
+/// Debug line drawing.
+/// Lines are collected on the cpu over the frame, then copied into this frame's
+/// slice of a host visible vertex ring and drawn as a line list.
+
+#ifndef VKENV_DEBUG_DRAW_H
+#define VKENV_DEBUG_DRAW_H
+
+#include <volk.h>
+#include <graphics/debug_draw.h>
+
+#include "device_state.h"
+#include "pipeline.h"
+#include "parts/render_style.h"
+#include <vector>
+
+// per frame, each line is two vertices
+const uint32_t MAX_DEBUG_VERTICES = 1 << 18;
+
+class DebugDrawVk : public DebugDraw {
+public:
+    DebugDrawVk(DeviceState base);
+    ~DebugDrawVk();
+
+    void line2D(glm::vec2 a, glm::vec2 b, glm::vec4 colour) override;
+    void line3D(glm::vec3 a, glm::vec3 b, glm::vec4 colour) override;
+
+    /// the vertex ring has a slice for each frame in flight,
+    /// called when frame resources are recreated.
+    /// The pipeline and ring are only created once lines are drawn.
+    void setPipelineTarget(VkRenderPass renderPass, VkExtent2D extent, uint32_t frameCount,
+			   part::create::PipelineConfig config);
+    void destroyPipeline();
+
+    /// record the frame's lines, then clear them. Must be in the offscreen render pass
+    void recordDraw(VkCommandBuffer cmdBuff, size_t frameIndex,
+		    const glm::mat4 &viewProj2D, const glm::mat4 &viewProj3D);
+
+    struct Vertex {
+	glm::vec3 pos;
+	// rgba8 unorm
+	uint32_t colour;
+    };
+
+private:
+    bool hasSpace();
+    /// returns false if there is no pipeline target yet
+    bool createPipeline();
+
+    DeviceState base;
+    std::vector<Vertex> verts2D;
+    std::vector<Vertex> verts3D;
+    bool warnedFull = false;
+
+    struct PipelineTarget {
+	VkRenderPass renderPass;
+	VkExtent2D extent;
+	uint32_t frameCount;
+	part::create::PipelineConfig config;
+    };
+    PipelineTarget target;
+    bool targetSet = false;
+
+    Pipeline pipeline;
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    Vertex* mapped = nullptr;
+    bool pipelineCreated = false;
+};
+
+#endif
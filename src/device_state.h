@@ -14,6 +14,10 @@ struct QueueFamilies {
 struct EnabledFeatures {
     bool samplerAnisotropy = false;
     bool sampleRateShading = false;
+    bool multiDrawIndirect = false;
+    bool drawIndirectFirstInstance = false;
+    // the VK_KHR_shader_draw_parameters extension, for gl_DrawID
+    bool shaderDrawParameters = false;
 #ifndef NDEBUG
     bool debugErrorOnly = false;
 #endif
@@ -12,6 +12,8 @@ Frame::Frame(VkDevice device,  uint32_t graphicsQueueIndex) {
 				device, &commandPool,
 				&commandBuffer, graphicsQueueIndex, 0),
 		"failed to create command pool and buffer for frame");
+    checkResultAndThrow(part::create::CommandBuffer(device, commandPool, &preCommandBuffer),
+		"failed to create pre command buffer for frame");
 
     checkResultAndThrow(part::create::Semaphore(device, &swapchainImageReady),
 		"failed to create image available semaphore");
@@ -21,6 +23,12 @@ Frame::Frame(VkDevice device,  uint32_t graphicsQueueIndex) {
 
     checkResultAndThrow(part::create::Fence(device, &frameFinished, true),
 		"failed to create frame finished fence");
+
+    VkQueryPoolCreateInfo queryInfo{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+    queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryInfo.queryCount = TIMESTAMP_COUNT;
+    checkResultAndThrow(vkCreateQueryPool(device, &queryInfo, nullptr, &timestamps),
+		"failed to create frame timestamp query pool");
 }
 
 Frame::~Frame() {
@@ -28,6 +36,7 @@ Frame::~Frame() {
     vkDestroySemaphore(device, swapchainImageReady, nullptr);
     vkDestroySemaphore(device, drawFinished, nullptr);
     vkDestroyFence(device, frameFinished, nullptr);
+    vkDestroyQueryPool(device, timestamps, nullptr);
 }
 
 VkResult Frame::waitForPreviousFrame() {
@@ -42,6 +51,9 @@ VkResult Frame::waitForPreviousFrame() {
 
 VkResult Frame::startFrame(VkCommandBuffer *pCmdBuff) {
     vkResetCommandPool(device, commandPool, 0);
+    usePreCommands = false;
+    prepassTimed = false;
+    colourPassTimed = false;
     VkCommandBufferBeginInfo begin{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
     begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
     begin.pInheritanceInfo = VK_NULL_HANDLE;
@@ -49,3 +61,12 @@ VkResult Frame::startFrame(VkCommandBuffer *pCmdBuff) {
     *pCmdBuff = commandBuffer;
     return result;
 }
+
+VkResult Frame::startPreCommands(VkCommandBuffer *pCmdBuff) {
+    VkCommandBufferBeginInfo begin{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VkResult result = vkBeginCommandBuffer(preCommandBuffer, &begin);
+    usePreCommands = result == VK_SUCCESS;
+    *pCmdBuff = preCommandBuffer;
+    return result;
+}
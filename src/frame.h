@@ -2,6 +2,14 @@
 #define VK_ENV_FRAME
 
 #include <volk.h>
+
+// queries of Frame::timestamps
+const uint32_t TIMESTAMP_PREPASS_START = 0;
+const uint32_t TIMESTAMP_PREPASS_END = 1;
+const uint32_t TIMESTAMP_COLOUR_START = 2;
+const uint32_t TIMESTAMP_COLOUR_END = 3;
+const uint32_t TIMESTAMP_COUNT = 4;
+
 struct Frame {
     Frame(VkDevice device,  uint32_t graphicsQueueIndex);
     ~Frame();
@@ -11,6 +19,18 @@ struct Frame {
     VkDevice device;
     VkCommandPool commandPool;
     VkCommandBuffer commandBuffer;
+    /// Recorded at the end of the frame, but submitted before commandBuffer.
+    /// For compute work on the frame's draws that must run before its render passes.
+    VkCommandBuffer preCommandBuffer;
+    bool usePreCommands = false;
+    VkResult startPreCommands(VkCommandBuffer *pCmdBuff);
+    // command buffers in submission order
+    VkCommandBuffer submitBuffers[2];
+    /// Around the frame's offscreen passes, each pair is only valid if it was
+    /// written since startFrame. Reset by the command buffer that writes them.
+    VkQueryPool timestamps;
+    bool prepassTimed = false;
+    bool colourPassTimed = false;
     VkSemaphore swapchainImageReady;
     VkSemaphore drawFinished;
     VkFence frameFinished;
@@ -0,0 +1,236 @@
+#include "instance_buffers.h"
+
+#include "vkhelper.h"
+#include "logger.h"
+#include "shader_structs.h"
+#include "parts/threading.h"
+
+#include <cstring>
+#include <stdexcept>
+
+struct InstanceBuffers::Buffer {
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    uint32_t count;
+    // PerFrame3D instances, followed by the previous transforms
+    VkDeviceSize prevOffset;
+    // around the instances' origins
+    glm::vec4 originSphere;
+    float maxScale;
+};
+
+InstanceBuffers::InstanceBuffers(DeviceState base, VkCommandPool cmdpool,
+				 VkCommandBuffer cmdbuff) {
+    this->base = base;
+    this->cmdpool = cmdpool;
+    this->cmdbuff = cmdbuff;
+    checkResultAndThrow(part::create::Fence(base.device, &loadedFence, false),
+			"failed to create instance buffer load fence");
+}
+
+InstanceBuffers::~InstanceBuffers() {
+    for(size_t i = 0; i < buffers.size(); i++)
+	if(buffers[i] != nullptr)
+	    destroy(Resource::InstanceBuffer(i));
+    vkDestroyFence(base.device, loadedFence, nullptr);
+}
+
+Resource::InstanceBuffer InstanceBuffers::create(
+	const Resource::InstanceTransform* instances, size_t count) {
+    if(count == 0) {
+	LOG_ERROR("instance buffers must have at least one instance");
+	return Resource::InstanceBuffer();
+    }
+
+    Buffer* b = new Buffer;
+    b->count = (uint32_t)count;
+    b->prevOffset = sizeof(shaderStructs::PerFrame3D) * count;
+    VkDeviceSize size = b->prevOffset + sizeof(glm::mat3x4) * count;
+
+    glm::vec3 minPos = glm::vec3(instances[0].model[3]);
+    glm::vec3 maxPos = minPos;
+    b->maxScale = 0.0f;
+    for(size_t i = 0; i < count; i++) {
+	const glm::mat4 &m = instances[i].model;
+	minPos = glm::min(minPos, glm::vec3(m[3]));
+	maxPos = glm::max(maxPos, glm::vec3(m[3]));
+	b->maxScale = glm::max(b->maxScale,
+			       glm::max(glm::length(glm::vec3(m[0])),
+					glm::max(glm::length(glm::vec3(m[1])),
+						 glm::length(glm::vec3(m[2])))));
+    }
+    b->originSphere = glm::vec4((minPos + maxPos) * 0.5f, 0.0f);
+    for(size_t i = 0; i < count; i++)
+	b->originSphere.w = glm::max(
+		b->originSphere.w,
+		glm::length(glm::vec3(instances[i].model[3]) - glm::vec3(b->originSphere)));
+
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingMemory;
+    checkResultAndThrow(
+	    vkhelper::createBufferAndMemory(
+		    base, size, &stagingBuffer, &stagingMemory,
+		    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT),
+	    "failed to create instance staging buffer");
+    vkBindBufferMemory(base.device, stagingBuffer, stagingMemory, 0);
+    void* pMem;
+    vkMapMemory(base.device, stagingMemory, 0, size, 0, &pMem);
+    // static transforms don't interpolate, so the previous transform is the same
+    for(size_t i = 0; i < count; i++) {
+	shaderStructs::PerFrame3D instance;
+	instance.model = shaderStructs::affineRows(instances[i].model);
+	std::memcpy(static_cast<char*>(pMem) + i * sizeof(instance), &instance,
+		    sizeof(instance));
+	std::memcpy(static_cast<char*>(pMem) + b->prevOffset + i * sizeof(glm::mat3x4),
+		    &instance.model, sizeof(glm::mat3x4));
+    }
+    vkUnmapMemory(base.device, stagingMemory);
+
+    checkResultAndThrow(
+	    vkhelper::createBufferAndMemory(
+		    base, size, &b->buffer, &b->memory,
+		    VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+	    "failed to create instance buffer");
+    vkBindBufferMemory(base.device, b->buffer, b->memory, 0);
+
+    VkCommandBufferBeginInfo beginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(cmdbuff, &beginInfo);
+    VkBufferCopy copyRegion{};
+    copyRegion.size = size;
+    vkCmdCopyBuffer(cmdbuff, stagingBuffer, b->buffer, 1, &copyRegion);
+    vkEndCommandBuffer(cmdbuff);
+    checkResultAndThrow(vkhelper::submitCmdBuffAndWait(
+				base.device,
+				base.queue.graphicsPresentQueue,
+				&cmdbuff, loadedFence,
+				&graphicsPresentMutex),
+			"failed to submit instance buffer load commands");
+    vkDestroyBuffer(base.device, stagingBuffer, nullptr);
+    vkFreeMemory(base.device, stagingMemory, nullptr);
+
+    size_t id = 0;
+    while(id < buffers.size() && buffers[id] != nullptr)
+	id++;
+    if(id == buffers.size())
+	buffers.push_back(b);
+    else
+	buffers[id] = b;
+    LOG("Instance buffer created - id: " << id << " - instances: " << count);
+    return Resource::InstanceBuffer(id);
+}
+
+InstanceBuffers::Buffer* InstanceBuffers::get(Resource::InstanceBuffer buffer) {
+    if(buffer.ID >= buffers.size() || buffers[buffer.ID] == nullptr)
+	return nullptr;
+    return buffers[buffer.ID];
+}
+
+void InstanceBuffers::destroy(Resource::InstanceBuffer buffer) {
+    Buffer* b = get(buffer);
+    if(b == nullptr)
+	return;
+    vkDeviceWaitIdle(base.device);
+    for(size_t i = 0; i < copies.size(); i++)
+	if(copies[i].buffer == b) {
+	    LOG_ERROR("destroyed an instance buffer that was drawn this frame");
+	    copies[i].count = 0;
+	}
+    vkDestroyBuffer(base.device, b->buffer, nullptr);
+    vkFreeMemory(base.device, b->memory, nullptr);
+    delete b;
+    buffers[buffer.ID] = nullptr;
+}
+
+uint32_t InstanceBuffers::getCount(Resource::InstanceBuffer buffer) {
+    Buffer* b = get(buffer);
+    return b == nullptr ? 0 : b->count;
+}
+
+glm::vec4 InstanceBuffers::getBounds(Resource::InstanceBuffer buffer, glm::vec4 modelSphere) {
+    Buffer* b = get(buffer);
+    if(b == nullptr)
+	return glm::vec4(0.0f);
+    // each instance's sphere centre is within scale * |centre| of its origin
+    float radius = b->maxScale * (glm::length(glm::vec3(modelSphere)) + modelSphere.w);
+    return glm::vec4(glm::vec3(b->originSphere), b->originSphere.w + radius);
+}
+
+void InstanceBuffers::queueCopy(Resource::InstanceBuffer buffer, uint32_t firstInstance,
+				uint32_t count) {
+    Buffer* b = get(buffer);
+    if(b == nullptr || count == 0)
+	return;
+    copies.push_back({b, firstInstance, count});
+}
+
+uint32_t InstanceBuffers::skipCopied(uint32_t index) {
+    while(nextCopy < copies.size()) {
+	const Copy &c = copies[nextCopy];
+	if(index < c.firstInstance)
+	    break;
+	if(index < c.firstInstance + c.count)
+	    index = c.firstInstance + c.count;
+	nextCopy++;
+    }
+    return index;
+}
+
+/// one region if the strides match, otherwise one per instance
+void addRegions(std::vector<VkBufferCopy> &regions, VkDeviceSize srcOffset,
+		VkDeviceSize srcStride, VkDeviceSize dstOffset, VkDeviceSize dstStride,
+		uint32_t count) {
+    if(srcStride == dstStride) {
+	regions.push_back({srcOffset, dstOffset, srcStride * count});
+	return;
+    }
+    for(uint32_t i = 0; i < count; i++)
+	regions.push_back({srcOffset + i * srcStride, dstOffset + i * dstStride, srcStride});
+}
+
+void InstanceBuffers::recordCopies(VkCommandBuffer cmdBuff, VkBuffer shaderBuffer,
+				   size_t frameIndex, DS::Binding* instances,
+				   DS::Binding* previous) {
+    if(copies.empty())
+	return;
+
+    // earlier frames may still be reading this frame's instances
+    VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(cmdBuff,
+			 VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+			 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			 VK_PIPELINE_STAGE_TRANSFER_BIT,
+			 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    std::vector<VkBufferCopy> regions;
+    for(const Copy &c: copies) {
+	if(c.count == 0)
+	    continue;
+	regions.clear();
+	addRegions(regions, 0, sizeof(shaderStructs::PerFrame3D),
+		   instances->offset + frameIndex * instances->bufferSize +
+		   c.firstInstance * instances->slotSize,
+		   instances->slotSize, c.count);
+	if(previous != nullptr)
+	    addRegions(regions, c.buffer->prevOffset, sizeof(glm::mat3x4),
+		       previous->offset + frameIndex * previous->bufferSize +
+		       c.firstInstance * previous->slotSize,
+		       previous->slotSize, c.count);
+	vkCmdCopyBuffer(cmdBuff, c.buffer->buffer, shaderBuffer,
+			(uint32_t)regions.size(), regions.data());
+    }
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuff,
+			 VK_PIPELINE_STAGE_TRANSFER_BIT,
+			 VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+			 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    copies.clear();
+    nextCopy = 0;
+}
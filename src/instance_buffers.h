@@ -0,0 +1,64 @@
+/// 3D instance transforms kept in device local memory, for placements that don't move.
+/// Drawing a buffer queues a copy of its instances into the frame's instance data,
+/// recorded before the frame's render passes, so the cpu never writes them again.
+
+#ifndef VKENV_INSTANCE_BUFFERS_H
+#define VKENV_INSTANCE_BUFFERS_H
+
+#include <volk.h>
+#include <graphics/resources.h>
+
+#include "device_state.h"
+#include "shader_internal.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+class InstanceBuffers {
+public:
+    InstanceBuffers(DeviceState base, VkCommandPool cmdpool, VkCommandBuffer cmdbuff);
+    ~InstanceBuffers();
+
+    Resource::InstanceBuffer create(const Resource::InstanceTransform* instances,
+				    size_t count);
+    /// waits for the device to be idle, so the buffer isn't in use
+    void destroy(Resource::InstanceBuffer buffer);
+    /// 0 if the buffer doesn't exist
+    uint32_t getCount(Resource::InstanceBuffer buffer);
+    /// a world space sphere around every instance of a model with the given
+    /// model space bounding sphere, xyz centre, w radius
+    glm::vec4 getBounds(Resource::InstanceBuffer buffer, glm::vec4 modelSphere);
+
+    void beginFrame() { copies.clear(); nextCopy = 0; }
+    /// copy count of the buffer's instances into the frame's instances from firstInstance,
+    /// copies must be queued in order of firstInstance
+    void queueCopy(Resource::InstanceBuffer buffer, uint32_t firstInstance, uint32_t count);
+    bool hasCopies() { return !copies.empty(); }
+    /// the next instance at or after index that isn't copied by the gpu
+    uint32_t skipCopied(uint32_t index);
+    /// instances and previous are the frame's instance and previous transform bindings,
+    /// previous can be nullptr if transforms aren't interpolated.
+    /// Must be outside of a render pass, and submitted before the frame's draws.
+    void recordCopies(VkCommandBuffer cmdBuff, VkBuffer shaderBuffer, size_t frameIndex,
+		      DS::Binding* instances, DS::Binding* previous);
+
+private:
+    struct Buffer;
+    struct Copy {
+	Buffer* buffer;
+	uint32_t firstInstance;
+	uint32_t count;
+    };
+    Buffer* get(Resource::InstanceBuffer buffer);
+
+    DeviceState base;
+    VkCommandPool cmdpool;
+    VkCommandBuffer cmdbuff;
+    VkFence loadedFence;
+    // nullptr for destroyed buffers
+    std::vector<Buffer*> buffers;
+    std::vector<Copy> copies;
+    size_t nextCopy = 0;
+};
+
+#endif
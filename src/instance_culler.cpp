@@ -0,0 +1,356 @@
+#include "instance_culler.h"
+
+#include "culling.h"
+#include "logger.h"
+#include "vkhelper.h"
+#include "parts/images.h"
+#include "parts/render_style.h"
+
+// match in cull.comp
+const uint32_t CULL_WORKGROUP_SIZE = 64;
+// match in depth_pyramid.comp
+const uint32_t PYRAMID_WORKGROUP_SIZE = 8;
+
+struct PyramidParams {
+    int32_t srcSize[2];
+    int32_t dstSize[2];
+};
+
+InstanceCuller::InstanceCuller(DeviceState base) {
+    this->base = base;
+
+    // the pyramid, or the source and destination of a level
+    VkDescriptorSetLayoutBinding bindings[2];
+    bindings[0] = {};
+    bindings[0].binding = 0;
+    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    bindings[0].descriptorCount = 1;
+    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    bindings[1] = bindings[0];
+    bindings[1].binding = 1;
+    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    VkDescriptorSetLayoutCreateInfo layoutInfo{
+	VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = bindings;
+    checkResultAndThrow(
+	    vkCreateDescriptorSetLayout(base.device, &layoutInfo, nullptr, &pyramidSet.layout),
+	    "failed to create depth pyramid descriptor set layout");
+    layoutInfo.bindingCount = 2;
+    checkResultAndThrow(
+	    vkCreateDescriptorSetLayout(base.device, &layoutInfo, nullptr,
+					&pyramidLevelSet.layout),
+	    "failed to create depth pyramid level descriptor set layout");
+}
+
+InstanceCuller::~InstanceCuller() {
+    destroyPipeline();
+    pyramidSet.destroySet(base.device);
+    pyramidLevelSet.destroySet(base.device);
+}
+
+void InstanceCuller::createPipeline(DescSet* perFrame3D, DescSet* cullSet,
+				    VkBuffer shaderBuffer, uint32_t instanceCapacity,
+				    uint32_t culledCapacity, VkExtent2D depthExtent,
+				    std::vector<VkImageView> depthViews) {
+    destroyPipeline();
+    this->perFrame3D = perFrame3D;
+    this->cullSet = cullSet;
+    this->shaderBuffer = shaderBuffer;
+    this->instanceCapacity = instanceCapacity;
+    this->culledCapacity = culledCapacity;
+    this->depthExtent = depthExtent;
+    this->depthViews = depthViews;
+    part::create::ComputePipeline(
+	    base.device, &pipeline,
+	    {&perFrame3D->set, &cullSet->set, &pyramidSet}, {},
+	    "shaders/vulkan/cull.comp.spv");
+    part::create::ComputePipeline(
+	    base.device, &pyramidPipeline,
+	    {&pyramidLevelSet},
+	    {{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PyramidParams)}},
+	    "shaders/vulkan/depth_pyramid.comp.spv");
+    createPyramid();
+    pipelineCreated = true;
+}
+
+void InstanceCuller::destroyPipeline() {
+    if(!pipelineCreated)
+	return;
+    pipeline.destroy(base.device);
+    pyramidPipeline.destroy(base.device);
+    destroyPyramid();
+    pipelineCreated = false;
+}
+
+VkImageView createLevelView(VkDevice device, VkImage image,
+			    uint32_t baseLevel, uint32_t levelCount) {
+    VkImageViewCreateInfo viewInfo{VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+    viewInfo.image = image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = VK_FORMAT_R32_SFLOAT;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.baseMipLevel = baseLevel;
+    viewInfo.subresourceRange.levelCount = levelCount;
+    viewInfo.subresourceRange.baseArrayLayer = 0;
+    viewInfo.subresourceRange.layerCount = 1;
+    VkImageView view;
+    checkResultAndThrow(vkCreateImageView(device, &viewInfo, nullptr, &view),
+			"failed to create depth pyramid image view");
+    return view;
+}
+
+void InstanceCuller::createPyramid() {
+    levelExtents.clear();
+    VkExtent2D extent = {1, 1};
+    if(!depthViews.empty())
+	extent = {depthExtent.width / 2, depthExtent.height / 2};
+    extent.width = extent.width == 0 ? 1 : extent.width;
+    extent.height = extent.height == 0 ? 1 : extent.height;
+    levelExtents.push_back(extent);
+    while(extent.width > 1 || extent.height > 1) {
+	extent.width = extent.width > 1 ? extent.width / 2 : 1;
+	extent.height = extent.height > 1 ? extent.height / 2 : 1;
+	levelExtents.push_back(extent);
+    }
+    uint32_t levelCount = (uint32_t)levelExtents.size();
+
+    VkMemoryRequirements memReq;
+    checkResultAndThrow(
+	    part::create::Image(base.device, &pyramid, &memReq,
+				VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
+				levelExtents[0], VK_FORMAT_R32_SFLOAT,
+				VK_SAMPLE_COUNT_1_BIT, levelCount),
+	    "failed to create depth pyramid image");
+    checkResultAndThrow(
+	    vkhelper::allocateMemory(base.device, base.physicalDevice, memReq.size,
+				     &pyramidMemory, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+				     memReq.memoryTypeBits),
+	    "failed to allocate depth pyramid memory");
+    vkBindImageMemory(base.device, pyramid, pyramidMemory, 0);
+    pyramidView = createLevelView(base.device, pyramid, 0, levelCount);
+    pyramidSampler = vkhelper::createTextureSampler(
+	    base.device, base.physicalDevice, (float)levelCount, false, true,
+	    VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+
+    uint32_t levelSetCount = depthViews.empty() ? 0 :
+	(uint32_t)depthViews.size() + levelCount - 1;
+    VkDescriptorPoolSize poolSizes[2];
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[0].descriptorCount = 1 + levelSetCount;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[1].descriptorCount = levelSetCount == 0 ? 1 : levelSetCount;
+    VkDescriptorPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.maxSets = 1 + levelSetCount;
+    poolInfo.poolSizeCount = 2;
+    poolInfo.pPoolSizes = poolSizes;
+    checkResultAndThrow(
+	    vkCreateDescriptorPool(base.device, &poolInfo, nullptr, &descPool),
+	    "failed to create depth pyramid descriptor pool");
+
+    std::vector<VkDescriptorSetLayout> layouts(1 + levelSetCount, pyramidLevelSet.layout);
+    layouts[0] = pyramidSet.layout;
+    std::vector<VkDescriptorSet> sets(layouts.size());
+    VkDescriptorSetAllocateInfo allocInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocInfo.descriptorPool = descPool;
+    allocInfo.descriptorSetCount = (uint32_t)layouts.size();
+    allocInfo.pSetLayouts = layouts.data();
+    checkResultAndThrow(vkAllocateDescriptorSets(base.device, &allocInfo, sets.data()),
+			"failed to allocate depth pyramid descriptor sets");
+    pyramidDescSet = sets[0];
+    levelDescSets.assign(sets.begin() + 1, sets.end());
+
+    // each level reads the one before it, the first reads the depth attachment
+    levelViews.clear();
+    if(!depthViews.empty())
+	for(uint32_t i = 0; i < levelCount; i++)
+	    levelViews.push_back(createLevelView(base.device, pyramid, i, 1));
+    std::vector<VkDescriptorImageInfo> srcInfos(sets.size());
+    std::vector<VkDescriptorImageInfo> dstInfos(sets.size());
+    std::vector<VkWriteDescriptorSet> writes;
+    srcInfos[0] = {pyramidSampler, pyramidView, VK_IMAGE_LAYOUT_GENERAL};
+    for(size_t i = 0; i < levelDescSets.size(); i++) {
+	uint32_t level = i < depthViews.size() ? 0 : (uint32_t)(i - depthViews.size() + 1);
+	if(level == 0)
+	    srcInfos[i + 1] = {pyramidSampler, depthViews[i],
+			       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+	else
+	    srcInfos[i + 1] = {pyramidSampler, levelViews[level - 1], VK_IMAGE_LAYOUT_GENERAL};
+	dstInfos[i + 1] = {VK_NULL_HANDLE, levelViews[level], VK_IMAGE_LAYOUT_GENERAL};
+    }
+    for(size_t i = 0; i < sets.size(); i++) {
+	VkWriteDescriptorSet write{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+	write.dstSet = sets[i];
+	write.dstBinding = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.pImageInfo = &srcInfos[i];
+	writes.push_back(write);
+	if(i == 0)
+	    continue;
+	write.dstBinding = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	write.pImageInfo = &dstInfos[i];
+	writes.push_back(write);
+    }
+    vkUpdateDescriptorSets(base.device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+    pyramidInitialised = false;
+    pyramidValid = false;
+}
+
+void InstanceCuller::destroyPyramid() {
+    vkDestroyDescriptorPool(base.device, descPool, nullptr);
+    levelDescSets.clear();
+    for(VkImageView view: levelViews)
+	vkDestroyImageView(base.device, view, nullptr);
+    levelViews.clear();
+    vkDestroyImageView(base.device, pyramidView, nullptr);
+    vkDestroySampler(base.device, pyramidSampler, nullptr);
+    vkDestroyImage(base.device, pyramid, nullptr);
+    vkFreeMemory(base.device, pyramidMemory, nullptr);
+}
+
+void InstanceCuller::initPyramidLayout(VkCommandBuffer cmdBuff) {
+    if(pyramidInitialised)
+	return;
+    VkImageMemoryBarrier barrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = pyramid;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = (uint32_t)levelExtents.size();
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    vkCmdPipelineBarrier(cmdBuff,
+			 VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    pyramidInitialised = true;
+}
+
+void InstanceCuller::beginFrame(size_t frameIndex) {
+    this->frameIndex = frameIndex;
+    jobCount = 0;
+    culledCount = 0;
+    maxJobInstances = 0;
+}
+
+bool InstanceCuller::hasSpace(uint32_t meshCount, uint32_t instanceCount) {
+    return pipelineCreated &&
+	jobCount + meshCount <= MAX_CULL_JOBS &&
+	culledCount + meshCount * instanceCount <= culledCapacity;
+}
+
+VkDeviceSize InstanceCuller::addJob(uint32_t instanceStart, uint32_t instanceCount,
+				    shaderStructs::CullDrawCommand command, glm::vec4 bounds) {
+    uint32_t visibleOffset = instanceCapacity + culledCount;
+    shaderStructs::CullJob job;
+    job.range = glm::uvec4(instanceStart, instanceCount, visibleOffset, jobCount);
+    job.bounds = bounds;
+    command.instanceCount = 0;
+    command.firstInstance = visibleOffset;
+    cullSet->bindings[0].storeSetData(frameIndex, &job, 0, jobCount, 0);
+    cullSet->bindings[1].storeSetData(frameIndex, &command, 0, jobCount, 0);
+    DS::Binding &commands = cullSet->bindings[1];
+    VkDeviceSize offset = commands.offset + frameIndex * commands.bufferSize +
+	jobCount * commands.slotSize;
+    jobCount++;
+    culledCount += instanceCount;
+    if(instanceCount > maxJobInstances)
+	maxJobInstances = instanceCount;
+    return offset;
+}
+
+void InstanceCuller::recordCulling(VkCommandBuffer cmdBuff, const glm::mat4 &viewProj) {
+    if(!hasJobs())
+	return;
+
+    initPyramidLayout(cmdBuff);
+    // earlier frames may still be drawing with this frame's visible list and commands,
+    // and the previous frame's pyramid is read
+    VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuff,
+			 VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+			 VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+			 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    shaderStructs::CullParams params;
+    cull::frustumPlanes(viewProj, params.planes);
+    params.occlusionViewProj = pyramidViewProj;
+    params.occlusion = glm::uvec4(depthExtent.width, depthExtent.height,
+				   (uint32_t)levelExtents.size(),
+				   occlusionEnabled() && pyramidValid ? 1 : 0);
+    params.jobCount = jobCount;
+    cullSet->bindings[2].storeSetData(frameIndex, &params, 0, 0, 0);
+    pipeline.begin(cmdBuff, frameIndex);
+    vkCmdBindDescriptorSets(cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.getLayout(),
+			    2, 1, &pyramidDescSet, 0, nullptr);
+    vkCmdDispatch(cmdBuff,
+		  (maxJobInstances + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE,
+		  jobCount, 1);
+
+    // the commands are submitted after this, so the barrier covers the frame's draws
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuff,
+			 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			 VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+			 VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+			 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void InstanceCuller::recordDepthPyramid(VkCommandBuffer cmdBuff, uint32_t swapchainIndex,
+					const glm::mat4 &viewProj) {
+    if(!occlusionEnabled())
+	return;
+    initPyramidLayout(cmdBuff);
+    // the previous frame's culling may still be reading the pyramid,
+    // the depth pre-pass makes the depth attachment visible to compute shaders
+    VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(cmdBuff,
+			 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    pyramidPipeline.begin(cmdBuff, 0);
+    VkExtent2D src = depthExtent;
+    for(size_t level = 0; level < levelExtents.size(); level++) {
+	VkExtent2D dst = levelExtents[level];
+	VkDescriptorSet set = level == 0 ? levelDescSets[swapchainIndex] :
+	    levelDescSets[depthViews.size() + level - 1];
+	vkCmdBindDescriptorSets(cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE,
+				pyramidPipeline.getLayout(), 0, 1, &set, 0, nullptr);
+	PyramidParams params = {{(int32_t)src.width, (int32_t)src.height},
+				{(int32_t)dst.width, (int32_t)dst.height}};
+	vkCmdPushConstants(cmdBuff, pyramidPipeline.getLayout(), VK_SHADER_STAGE_COMPUTE_BIT,
+			   0, sizeof(params), &params);
+	vkCmdDispatch(cmdBuff,
+		      (dst.width + PYRAMID_WORKGROUP_SIZE - 1) / PYRAMID_WORKGROUP_SIZE,
+		      (dst.height + PYRAMID_WORKGROUP_SIZE - 1) / PYRAMID_WORKGROUP_SIZE, 1);
+
+	// the next level reads this one, and the next frame's depth
+	// attachment writes must wait for the reads of this one
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(cmdBuff,
+			     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+			     VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+			     VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			     0, 1, &barrier, 0, nullptr, 0, nullptr);
+	src = dst;
+    }
+    pyramidViewProj = viewProj;
+    pyramidValid = true;
+}
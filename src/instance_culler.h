@@ -0,0 +1,105 @@
+/// GPU frustum culling of 3D instances.
+/// Each batched mesh becomes a cull job. A compute pass, recorded before the frame's
+/// render passes, tests the job's instances against the view frustum, appends the
+/// visible ones to a list read by the vertex shaders, and counts them into an
+/// indexed indirect draw command that the batch was recorded with.
+/// With occlusion culling, a pyramid of the furthest depth is built from each frame's
+/// 3D depth pre-pass, and the next frame also tests instances against it.
+
+#ifndef VKENV_INSTANCE_CULLER_H
+#define VKENV_INSTANCE_CULLER_H
+
+#include <volk.h>
+
+#include "device_state.h"
+#include "pipeline.h"
+#include "shader_internal.h"
+#include "shader_structs.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// draw commands per frame
+const uint32_t MAX_CULL_JOBS = 512;
+
+class InstanceCuller {
+public:
+    InstanceCuller(DeviceState base);
+    ~InstanceCuller();
+
+    /// perFrame3D holds the instance data and visible list,
+    /// cullSet holds the jobs, the draw commands and the cull params, all in shaderBuffer.
+    /// The visible list has instanceCapacity identity slots, then culledCapacity slots
+    /// for the visible instances of each job. Batches that don't fit are drawn directly.
+    /// depthViews are the depth attachment's views for each swapchain image,
+    /// occlusion culling is off if there are none.
+    void createPipeline(DescSet* perFrame3D, DescSet* cullSet, VkBuffer shaderBuffer,
+			uint32_t instanceCapacity, uint32_t culledCapacity, VkExtent2D depthExtent,
+			std::vector<VkImageView> depthViews);
+    void destroyPipeline();
+    bool enabled() { return pipelineCreated; }
+    bool occlusionEnabled() { return pipelineCreated && !depthViews.empty(); }
+
+    void beginFrame(size_t frameIndex);
+    /// false if there isn't room for the meshes this frame, they should be drawn directly
+    bool hasSpace(uint32_t meshCount, uint32_t instanceCount);
+    /// returns the offset of the job's draw command in the shader buffer
+    VkDeviceSize addJob(uint32_t instanceStart, uint32_t instanceCount,
+			shaderStructs::CullDrawCommand command, glm::vec4 bounds);
+    VkBuffer getCommandBuffer() { return shaderBuffer; }
+    /// bytes between consecutive jobs' draw commands
+    uint32_t getCommandStride() { return (uint32_t)cullSet->bindings[1].slotSize; }
+
+    bool hasJobs() { return pipelineCreated && jobCount > 0; }
+    /// must be outside of a render pass, and submitted before the frame's draws
+    void recordCulling(VkCommandBuffer cmdBuff, const glm::mat4 &viewProj);
+    /// must be outside of a render pass, after the depth attachment of
+    /// swapchainIndex has been written with viewProj
+    void recordDepthPyramid(VkCommandBuffer cmdBuff, uint32_t swapchainIndex,
+			    const glm::mat4 &viewProj);
+
+private:
+    void createPyramid();
+    void destroyPyramid();
+    /// the pyramid is kept in the general layout, so levels can be read and written
+    void initPyramidLayout(VkCommandBuffer cmdBuff);
+
+    DeviceState base;
+    Pipeline pipeline;
+    Pipeline pyramidPipeline;
+    bool pipelineCreated = false;
+    DescSet* perFrame3D;
+    DescSet* cullSet;
+    VkBuffer shaderBuffer;
+    uint32_t instanceCapacity = 0;
+    uint32_t culledCapacity = 0;
+
+    size_t frameIndex = 0;
+    uint32_t jobCount = 0;
+    uint32_t culledCount = 0;
+    uint32_t maxJobInstances = 0;
+
+    // sampled by the culling
+    DS::DescriptorSet pyramidSet;
+    // source and destination of a pyramid level
+    DS::DescriptorSet pyramidLevelSet;
+    VkDescriptorPool descPool;
+    VkDescriptorSet pyramidDescSet;
+    // one per depth view, then one per level after the first
+    std::vector<VkDescriptorSet> levelDescSets;
+    std::vector<VkImageView> depthViews;
+    VkExtent2D depthExtent;
+    // a single texel when there are no depth views, so the culling still has a pyramid bound
+    VkImage pyramid;
+    VkDeviceMemory pyramidMemory;
+    VkImageView pyramidView;
+    std::vector<VkImageView> levelViews;
+    std::vector<VkExtent2D> levelExtents;
+    VkSampler pyramidSampler;
+    bool pyramidInitialised = false;
+    // holds depth seen with pyramidViewProj
+    bool pyramidValid = false;
+    glm::mat4 pyramidViewProj;
+};
+
+#endif
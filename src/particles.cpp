@@ -0,0 +1,340 @@
+#include "particles.h"
+
+#include "vkhelper.h"
+#include "logger.h"
+#include "shader_structs.h"
+
+#include <cmath>
+#include <stdexcept>
+
+// match in particles.comp
+const uint32_t PARTICLE_WORKGROUP_SIZE = 256;
+// vec4 colour, vec2 position, vec2 velocity, float life, maxLife, size, padding
+const VkDeviceSize PARTICLE_SIZE = 48;
+
+/// indirect draw command followed by the spawn counter, reset before each simulation
+struct EmitterState {
+    VkDrawIndirectCommand draw;
+    uint32_t emitted;
+};
+
+struct ParticleSystem::Emitter {
+    ParticleEmitterConfig config;
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    VkDescriptorSet set;
+    VkDeviceSize aliveOffset;
+    VkDeviceSize particleOffset;
+    // particles start dead, the buffer is zeroed before its first simulation
+    bool cleared = false;
+    float pendingTime = 0.0f;
+    // fraction of a particle carried over to the next simulation
+    float emitRemainder = 0.0f;
+};
+
+ParticleSystem::ParticleSystem(DeviceState base) {
+    this->base = base;
+
+    // state, alive list, particles
+    VkDescriptorSetLayoutBinding bindings[3];
+    for(uint32_t i = 0; i < 3; i++) {
+	bindings[i] = {};
+	bindings[i].binding = i;
+	bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[i].descriptorCount = 1;
+	bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+    }
+    VkDescriptorSetLayoutCreateInfo layoutInfo{
+	VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    layoutInfo.bindingCount = 3;
+    layoutInfo.pBindings = bindings;
+    checkResultAndThrow(
+	    vkCreateDescriptorSetLayout(base.device, &layoutInfo, nullptr, &particleSet.layout),
+	    "failed to create particle descriptor set layout");
+
+    VkDescriptorPoolSize poolSize;
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = 3 * MAX_PARTICLE_EMITTERS;
+    VkDescriptorPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    poolInfo.maxSets = MAX_PARTICLE_EMITTERS;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    checkResultAndThrow(
+	    vkCreateDescriptorPool(base.device, &poolInfo, nullptr, &descPool),
+	    "failed to create particle descriptor pool");
+}
+
+ParticleSystem::~ParticleSystem() {
+    for(size_t i = 0; i < emitters.size(); i++)
+	if(emitters[i] != nullptr)
+	    destroy(Resource::ParticleEmitter(i));
+    destroyPipelines();
+    vkDestroyDescriptorPool(base.device, descPool, nullptr);
+    particleSet.destroySet(base.device);
+}
+
+Resource::ParticleEmitter ParticleSystem::create(ParticleEmitterConfig config) {
+    if(config.maxParticles == 0) {
+	LOG_ERROR("particle emitter must have a max particle count above zero");
+	return Resource::ParticleEmitter();
+    }
+    size_t id = 0;
+    while(id < emitters.size() && emitters[id] != nullptr)
+	id++;
+    if(id >= MAX_PARTICLE_EMITTERS) {
+	LOG_ERROR("ran out of particle emitters, max: " << MAX_PARTICLE_EMITTERS);
+	return Resource::ParticleEmitter();
+    }
+
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(base.physicalDevice, &props);
+    VkDeviceSize particleRange = PARTICLE_SIZE * config.maxParticles;
+    uint32_t groups = (config.maxParticles + PARTICLE_WORKGROUP_SIZE - 1) /
+	PARTICLE_WORKGROUP_SIZE;
+    if(particleRange > props.limits.maxStorageBufferRange ||
+       groups > props.limits.maxComputeWorkGroupCount[0]) {
+	LOG_ERROR("particle emitter max particle count is too large for this device: "
+		  << config.maxParticles);
+	return Resource::ParticleEmitter();
+    }
+
+    Emitter* e = new Emitter;
+    e->config = config;
+    VkDeviceSize align = props.limits.minStorageBufferOffsetAlignment;
+    e->aliveOffset = vkhelper::correctMemoryAlignment(sizeof(EmitterState), align);
+    e->particleOffset = vkhelper::correctMemoryAlignment(
+	    e->aliveOffset + sizeof(uint32_t) * config.maxParticles, align);
+    VkDeviceSize size = e->particleOffset + particleRange;
+
+    checkResultAndThrow(
+	    vkhelper::createBufferAndMemory(
+		    base, size, &e->buffer, &e->memory,
+		    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+		    VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+		    VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+	    "failed to create particle buffer");
+    vkBindBufferMemory(base.device, e->buffer, e->memory, 0);
+
+    VkDescriptorSetAllocateInfo allocInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocInfo.descriptorPool = descPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &particleSet.layout;
+    checkResultAndThrow(vkAllocateDescriptorSets(base.device, &allocInfo, &e->set),
+			"failed to allocate particle descriptor set");
+
+    VkDescriptorBufferInfo buffInfos[3] = {
+	{e->buffer, 0, sizeof(EmitterState)},
+	{e->buffer, e->aliveOffset, sizeof(uint32_t) * config.maxParticles},
+	{e->buffer, e->particleOffset, particleRange},
+    };
+    VkWriteDescriptorSet writes[3];
+    for(uint32_t i = 0; i < 3; i++) {
+	writes[i] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+	writes[i].dstSet = e->set;
+	writes[i].dstBinding = i;
+	writes[i].descriptorCount = 1;
+	writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	writes[i].pBufferInfo = &buffInfos[i];
+    }
+    vkUpdateDescriptorSets(base.device, 3, writes, 0, nullptr);
+
+    if(id == emitters.size())
+	emitters.push_back(e);
+    else
+	emitters[id] = e;
+    LOG("Particle emitter created - id: " << id << " - max particles: "
+	<< config.maxParticles);
+    return Resource::ParticleEmitter(id);
+}
+
+ParticleSystem::Emitter* ParticleSystem::get(Resource::ParticleEmitter emitter) {
+    if(emitter.ID >= emitters.size() || emitters[emitter.ID] == nullptr)
+	return nullptr;
+    return emitters[emitter.ID];
+}
+
+const ParticleEmitterConfig* ParticleSystem::getConfig(Resource::ParticleEmitter emitter) {
+    Emitter* e = get(emitter);
+    return e == nullptr ? nullptr : &e->config;
+}
+
+void ParticleSystem::set(Resource::ParticleEmitter emitter, ParticleEmitterConfig config) {
+    Emitter* e = get(emitter);
+    if(e == nullptr) {
+	LOG_ERROR("tried to set particle emitter that doesn't exist");
+	return;
+    }
+    config.maxParticles = e->config.maxParticles;
+    e->config = config;
+}
+
+void ParticleSystem::destroy(Resource::ParticleEmitter emitter) {
+    Emitter* e = get(emitter);
+    if(e == nullptr)
+	return;
+    vkDeviceWaitIdle(base.device);
+    vkFreeDescriptorSets(base.device, descPool, 1, &e->set);
+    vkDestroyBuffer(base.device, e->buffer, nullptr);
+    vkFreeMemory(base.device, e->memory, nullptr);
+    delete e;
+    emitters[emitter.ID] = nullptr;
+}
+
+void ParticleSystem::update(Resource::ParticleEmitter emitter, float deltaTime) {
+    Emitter* e = get(emitter);
+    if(e == nullptr) {
+	LOG_ERROR("tried to update particle emitter that doesn't exist");
+	return;
+    }
+    if(deltaTime > 0.0f)
+	e->pendingTime += deltaTime;
+}
+
+void ParticleSystem::setPipelineTarget(VkRenderPass renderPass, VkExtent2D extent,
+				      DS::DescriptorSet* viewProjSet,
+				      DS::DescriptorSet* textureSet,
+				      part::create::PipelineConfig config) {
+    destroyPipelines();
+    target.renderPass = renderPass;
+    target.extent = extent;
+    target.viewProjSet = viewProjSet;
+    target.textureSet = textureSet;
+    target.config = config;
+    targetSet = true;
+}
+
+void ParticleSystem::destroyPipelines() {
+    targetSet = false;
+    if(!pipelinesCreated)
+	return;
+    simPipeline.destroy(base.device);
+    drawPipeline.destroy(base.device);
+    pipelinesCreated = false;
+}
+
+bool ParticleSystem::createPipelines() {
+    if(pipelinesCreated || !targetSet)
+	return pipelinesCreated;
+    part::create::ComputePipeline(
+	    base.device, &simPipeline,
+	    {&particleSet},
+	    {{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(shaderStructs::ParticleSimParams)}},
+	    "shaders/vulkan/particles.comp.spv");
+    part::create::GraphicsPipeline(
+	    base.device, &drawPipeline, target.renderPass,
+	    {target.viewProjSet, target.textureSet, &particleSet},
+	    {{VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+	      0, sizeof(shaderStructs::ParticleDrawParams)}},
+	    "shaders/vulkan/particle.vert.spv", "shaders/vulkan/particle.frag.spv",
+	    target.extent, {}, {}, target.config);
+    pipelinesCreated = true;
+    return true;
+}
+
+void ParticleSystem::recordSimulation(VkCommandBuffer cmdBuff) {
+    std::vector<Emitter*> active;
+    for(Emitter* e: emitters)
+	if(e != nullptr && (!e->cleared || e->pendingTime > 0.0f))
+	    active.push_back(e);
+    if(active.empty() || !createPipelines())
+	return;
+
+    // previous frames may still be simulating or drawing these emitters
+    VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT |
+	VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmdBuff,
+			 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+			 VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+			 VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+			 VK_PIPELINE_STAGE_TRANSFER_BIT,
+			 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    EmitterState resetState = {};
+    resetState.draw.vertexCount = 6;
+    for(Emitter* e: active) {
+	if(!e->cleared) {
+	    vkCmdFillBuffer(cmdBuff, e->buffer, e->particleOffset, VK_WHOLE_SIZE, 0);
+	    e->cleared = true;
+	}
+	vkCmdUpdateBuffer(cmdBuff, e->buffer, 0, sizeof(EmitterState), &resetState);
+    }
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT |
+	VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuff,
+			 VK_PIPELINE_STAGE_TRANSFER_BIT,
+			 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+			 VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+			 VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+			 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    simPipeline.begin(cmdBuff, 0);
+    for(Emitter* e: active) {
+	if(e->pendingTime <= 0.0f)
+	    continue;
+	const ParticleEmitterConfig &c = e->config;
+	float toEmit = e->emitRemainder + c.emitRate * e->pendingTime;
+	float emitCount = std::floor(toEmit);
+	e->emitRemainder = toEmit - emitCount;
+	if(emitCount > (float)c.maxParticles) {
+	    emitCount = (float)c.maxParticles;
+	    e->emitRemainder = 0.0f;
+	}
+
+	shaderStructs::ParticleSimParams params;
+	params.startColour = c.startColour;
+	params.endColour = c.endColour;
+	params.position = c.position;
+	params.spawnArea = c.spawnArea;
+	params.velocity = c.velocity;
+	params.velocityVariance = c.velocityVariance;
+	params.acceleration = c.acceleration;
+	params.lifetime = c.lifetime;
+	params.lifetimeVariance = c.lifetimeVariance;
+	params.startSize = c.startSize;
+	params.endSize = c.endSize;
+	params.deltaTime = e->pendingTime;
+	params.emitCount = (uint32_t)emitCount;
+	params.maxParticles = c.maxParticles;
+	params.seed = seed++;
+	e->pendingTime = 0.0f;
+
+	vkCmdBindDescriptorSets(cmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE,
+				simPipeline.getLayout(), 0, 1, &e->set, 0, nullptr);
+	vkCmdPushConstants(cmdBuff, simPipeline.getLayout(), VK_SHADER_STAGE_COMPUTE_BIT,
+			   0, sizeof(params), &params);
+	vkCmdDispatch(cmdBuff,
+		      (c.maxParticles + PARTICLE_WORKGROUP_SIZE - 1) / PARTICLE_WORKGROUP_SIZE,
+		      1, 1);
+    }
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuff,
+			 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			 VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+			 VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+			 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void ParticleSystem::recordDraw(VkCommandBuffer cmdBuff, size_t frameIndex,
+				Resource::ParticleEmitter emitter, uint32_t texID) {
+    Emitter* e = get(emitter);
+    if(e == nullptr || !createPipelines())
+	return;
+    shaderStructs::ParticleDrawParams params;
+    params.depth = e->config.depth;
+    params.texID = texID;
+    drawPipeline.begin(cmdBuff, frameIndex);
+    vkCmdBindDescriptorSets(cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS,
+			    drawPipeline.getLayout(), 2, 1, &e->set, 0, nullptr);
+    vkCmdPushConstants(cmdBuff, drawPipeline.getLayout(),
+		       VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+		       0, sizeof(params), &params);
+    vkCmdDrawIndirect(cmdBuff, e->buffer, 0, 1, sizeof(VkDrawIndirectCommand));
+}
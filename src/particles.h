@@ -0,0 +1,79 @@
+/// GPU particle emitters.
+/// Particle state lives in device local memory, and is simulated, spawned and killed
+/// by a compute shader. Live particles are drawn with an indirect draw whose instance
+/// count is written by the simulation, so the cpu never reads or writes particles.
+
+#ifndef VKENV_PARTICLES_H
+#define VKENV_PARTICLES_H
+
+#include <volk.h>
+#include <graphics/particles.h>
+
+#include "device_state.h"
+#include "pipeline.h"
+#include "shader_internal.h"
+#include "parts/render_style.h"
+#include <vector>
+
+const uint32_t MAX_PARTICLE_EMITTERS = 64;
+
+class ParticleSystem {
+public:
+    ParticleSystem(DeviceState base);
+    ~ParticleSystem();
+
+    Resource::ParticleEmitter create(ParticleEmitterConfig config);
+    void set(Resource::ParticleEmitter emitter, ParticleEmitterConfig config);
+    /// waits for the device to be idle, so the emitter's memory isn't in use
+    void destroy(Resource::ParticleEmitter emitter);
+    /// time is accumulated until the next call to recordSimulation
+    void update(Resource::ParticleEmitter emitter, float deltaTime);
+    /// returns nullptr if the emitter doesn't exist
+    const ParticleEmitterConfig* getConfig(Resource::ParticleEmitter emitter);
+
+    /// the draw pipeline uses the 2D view projection and texture sets,
+    /// called when frame resources are recreated.
+    /// The pipelines are only created once an emitter is simulated or drawn,
+    /// so apps without particles don't need the particle shaders.
+    void setPipelineTarget(VkRenderPass renderPass, VkExtent2D extent,
+			   DS::DescriptorSet* viewProjSet, DS::DescriptorSet* textureSet,
+			   part::create::PipelineConfig config);
+    void destroyPipelines();
+
+    /// record simulation of emitters that have been updated since the last call,
+    /// must be called outside of a render pass
+    void recordSimulation(VkCommandBuffer cmdBuff);
+    /// record an indirect draw of the emitter's live particles
+    void recordDraw(VkCommandBuffer cmdBuff, size_t frameIndex,
+		    Resource::ParticleEmitter emitter, uint32_t texID);
+
+private:
+    struct Emitter;
+    Emitter* get(Resource::ParticleEmitter emitter);
+    /// returns false if there is no pipeline target yet
+    bool createPipelines();
+
+    DeviceState base;
+    VkDescriptorPool descPool;
+    // layout shared by the emitters, each emitter allocates its own set
+    DS::DescriptorSet particleSet;
+    // nullptr for unused emitter slots
+    std::vector<Emitter*> emitters;
+
+    struct PipelineTarget {
+	VkRenderPass renderPass;
+	VkExtent2D extent;
+	DS::DescriptorSet* viewProjSet;
+	DS::DescriptorSet* textureSet;
+	part::create::PipelineConfig config;
+    };
+    PipelineTarget target;
+    bool targetSet = false;
+
+    Pipeline simPipeline;
+    Pipeline drawPipeline;
+    bool pipelinesCreated = false;
+    uint32_t seed = 0;
+};
+
+#endif
@@ -113,13 +113,23 @@ namespace part {
 	deviceInfo.queueCreateInfoCount = (uint32_t)queueInfos.size();
 	deviceInfo.pQueueCreateInfos = queueInfos.data();
 
-	deviceInfo.enabledExtensionCount = (uint32_t)REQUESTED_DEVICE_EXTENSIONS.size();
-	deviceInfo.ppEnabledExtensionNames = REQUESTED_DEVICE_EXTENSIONS.data();
-	    
 	VkPhysicalDeviceFeatures chosenDeviceFeatures = setRequestedDeviceFeatures(
 		deviceState->physicalDevice,
 		requestFeatures,
 		&deviceState->features);
+
+	// shader draw parameters for gl_DrawID in the 3D vertex shaders,
+	// without it the meshes of a model are drawn one at a time
+	std::vector<const char*> extensions = REQUESTED_DEVICE_EXTENSIONS;
+	if(requestFeatures.shaderDrawParameters &&
+	   checkRequestedExtensionsAreSupported(
+		   deviceState->physicalDevice,
+		   {VK_KHR_SHADER_DRAW_PARAMETERS_EXTENSION_NAME})) {
+	    extensions.push_back(VK_KHR_SHADER_DRAW_PARAMETERS_EXTENSION_NAME);
+	    deviceState->features.shaderDrawParameters = true;
+	}
+	deviceInfo.enabledExtensionCount = (uint32_t)extensions.size();
+	deviceInfo.ppEnabledExtensionNames = extensions.data();
 	deviceInfo.pEnabledFeatures = &chosenDeviceFeatures;
 
 	deviceInfo.enabledLayerCount = (uint32_t)OPTIONAL_LAYERS.size();
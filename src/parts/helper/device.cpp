@@ -81,6 +81,15 @@ VkPhysicalDeviceFeatures setRequestedDeviceFeatures(
 	chosenDeviceFeatures.sampleRateShading = VK_TRUE;
 	setFeatures->sampleRateShading = true;
     }
+    if (availableDeviceFeatures.multiDrawIndirect && requestedFeatures.multiDrawIndirect) {
+	chosenDeviceFeatures.multiDrawIndirect = VK_TRUE;
+	setFeatures->multiDrawIndirect = true;
+    }
+    if (availableDeviceFeatures.drawIndirectFirstInstance &&
+	requestedFeatures.drawIndirectFirstInstance) {
+	chosenDeviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+	setFeatures->drawIndirectFirstInstance = true;
+    }
     return chosenDeviceFeatures;
 }
 
@@ -37,7 +37,7 @@ namespace create
       // config input assemby
       VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo{
 	  VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
-      inputAssemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+      inputAssemblyInfo.topology = config.topology;
       inputAssemblyInfo.primitiveRestartEnable = VK_FALSE;
 
       // config vertex input
@@ -90,13 +90,13 @@ namespace create
 	  VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
       if (config.useDepthTest) {
 	  depthStencilInfo.depthTestEnable = VK_TRUE;
-	  depthStencilInfo.depthWriteEnable = VK_TRUE;
+	  depthStencilInfo.depthWriteEnable = config.depthWrite ? VK_TRUE : VK_FALSE;
       } else {
 	  depthStencilInfo.depthTestEnable = VK_FALSE;
 	  depthStencilInfo.depthWriteEnable = VK_FALSE;
       }
 
-      depthStencilInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+      depthStencilInfo.depthCompareOp = config.depthCompareOp;
       depthStencilInfo.depthBoundsTestEnable = VK_FALSE;
 
       // config colour blend attachment
@@ -118,7 +118,7 @@ namespace create
       VkPipelineColorBlendStateCreateInfo blendInfo{
 	  VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
       blendInfo.logicOpEnable = VK_FALSE;
-      blendInfo.attachmentCount = 1;
+      blendInfo.attachmentCount = config.colourAttachment ? 1 : 0;
       blendInfo.pAttachments = &blendAttachment;
 
       // set dynamic states
@@ -128,10 +128,14 @@ namespace create
       dynamicStateInfo.pDynamicStates = nullptr;
 
       auto vertexShaderModule = _loadShaderModule(device, vertexShaderPath);
-      auto fragmentShaderModule = _loadShaderModule(device, fragmentShaderPath);
-      std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = {
-	  shaderStageInfo(vertexShaderModule, VK_SHADER_STAGE_VERTEX_BIT),
-	  shaderStageInfo(fragmentShaderModule, VK_SHADER_STAGE_FRAGMENT_BIT)};
+      VkShaderModule fragmentShaderModule = VK_NULL_HANDLE;
+      std::vector<VkPipelineShaderStageCreateInfo> shaderStages = {
+	  shaderStageInfo(vertexShaderModule, VK_SHADER_STAGE_VERTEX_BIT)};
+      if(!fragmentShaderPath.empty()) {
+	  fragmentShaderModule = _loadShaderModule(device, fragmentShaderPath);
+	  shaderStages.push_back(
+		  shaderStageInfo(fragmentShaderModule, VK_SHADER_STAGE_FRAGMENT_BIT));
+      }
 
       // create graphics pipeline
       VkPipeline vkpipeline;
@@ -157,7 +161,32 @@ namespace create
   
       // destory shader modules
       vkDestroyShaderModule(device, vertexShaderModule, nullptr);
-      vkDestroyShaderModule(device, fragmentShaderModule, nullptr);
+      if(fragmentShaderModule != VK_NULL_HANDLE)
+	  vkDestroyShaderModule(device, fragmentShaderModule, nullptr);
+  }
+
+  void ComputePipeline(
+	  VkDevice device, Pipeline *pipeline,
+	  std::vector<DS::DescriptorSet*> descriptorSets,
+	  std::vector<VkPushConstantRange> pushConstantsRanges,
+	  std::string computeShaderPath) {
+      VkPipelineLayout layout = createPipelineLayout(device, pushConstantsRanges, descriptorSets);
+
+      auto computeShaderModule = _loadShaderModule(device, computeShaderPath);
+
+      VkPipeline vkpipeline;
+      VkComputePipelineCreateInfo createInfo{
+	  VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+      createInfo.layout = layout;
+      createInfo.stage = shaderStageInfo(computeShaderModule, VK_SHADER_STAGE_COMPUTE_BIT);
+
+      if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &createInfo, nullptr,
+				   &vkpipeline) != VK_SUCCESS)
+	  throw std::runtime_error("failed to create compute pipeline!");
+
+      *pipeline = Pipeline(layout, vkpipeline, descriptorSets, VK_PIPELINE_BIND_POINT_COMPUTE);
+
+      vkDestroyShaderModule(device, computeShaderModule, nullptr);
   }
 
 
@@ -13,14 +13,22 @@ namespace part {
 
     struct PipelineConfig {
 	bool useDepthTest = true;
+	// ignored if useDepthTest is false
+	bool depthWrite = true;
+	VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
 	bool useMultisampling;
 	VkSampleCountFlagBits msaaSamples;
 	bool useSampleShading;
 	bool blendEnabled = true;
 	VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
 	VkBlendOp blendOp = VK_BLEND_OP_ADD;
+	VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	// false for depth only passes, which have no colour attachment
+	bool colourAttachment = true;
     };
-    
+
+    /// fragmentShaderPath can be empty for depth only pipelines
+
     void GraphicsPipeline(VkDevice device,
 			  Pipeline* pipeline,
 			  VkRenderPass renderPass,
@@ -32,6 +40,12 @@ namespace part {
 			  std::vector<VkVertexInputBindingDescription> vertexBindingDesc,
 			  PipelineConfig config);
 
+    void ComputePipeline(VkDevice device,
+			 Pipeline* pipeline,
+			 std::vector<DS::DescriptorSet*> descriptorSets,
+			 std::vector<VkPushConstantRange> pushConstantsRanges,
+			 std::string computeShaderPath);
+
   }
 }
 
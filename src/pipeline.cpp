@@ -2,8 +2,10 @@
 
 
 Pipeline::Pipeline(
-	VkPipelineLayout layout, VkPipeline pipeline, std::vector<DS::DescriptorSet*> sets) {
+	VkPipelineLayout layout, VkPipeline pipeline, std::vector<DS::DescriptorSet*> sets,
+	VkPipelineBindPoint bindPoint) {
     this->descriptorSets = sets;
+    this->bindPoint = bindPoint;
     this->layout = layout;
     this->pipeline = pipeline;
     this->descriptorSetsActive = std::vector<bool>(descriptorSets.size(), true);
@@ -24,7 +26,7 @@ void Pipeline::begin(VkCommandBuffer cmdBuff, size_t frameIndex) {
 	if(descriptorSetsActive[i] &&
 	   !descriptorSets[i]->dynamicBuffer &&
 	   descriptorSets[i]->sets.size() != 0)
-	    vkCmdBindDescriptorSets(cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, layout,
+	    vkCmdBindDescriptorSets(cmdBuff, bindPoint, layout,
 				    static_cast<uint32_t>(i - bindOffset), 1,
 				    &descriptorSets[i]->sets[frameIndex],
 				    0, nullptr);
@@ -33,7 +35,7 @@ void Pipeline::begin(VkCommandBuffer cmdBuff, size_t frameIndex) {
 	    bindOffset++;
 	}
     }
-    vkCmdBindPipeline(cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdBindPipeline(cmdBuff, bindPoint, pipeline);
 }
 
 void Pipeline::bindDynamicDS(
@@ -41,7 +43,7 @@ void Pipeline::bindDynamicDS(
     for (size_t i = 0; i < descriptorSets.size(); i++)
 	if(descriptorSets[i]->dynamicBuffer)
 	    if(descriptorSets[i] == ds)
-		vkCmdBindDescriptorSets(cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, layout,
+		vkCmdBindDescriptorSets(cmdBuff, bindPoint, layout,
 					static_cast<uint32_t>(i), 1,
 					&descriptorSets[i]->sets[frameIndex],
 					1, &dynOffset);
@@ -17,17 +17,20 @@
 class Pipeline {
 public:
     Pipeline() {};
-    Pipeline(VkPipelineLayout layout, VkPipeline pipeline, std::vector<DS::DescriptorSet*> sets);
+    Pipeline(VkPipelineLayout layout, VkPipeline pipeline, std::vector<DS::DescriptorSet*> sets,
+	     VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS);
     void setDescSetState(DS::DescriptorSet* set, bool isActive);    
     void begin(VkCommandBuffer cmdBuff, size_t frameIndex);
     void bindDynamicDS(
 	    VkCommandBuffer cmdBuff, DS::DescriptorSet *ds, size_t frameIndex, uint32_t dynOffset);
     void destroy(VkDevice device);
     VkPipelineLayout getLayout() { return layout; }
+    VkPipelineBindPoint getBindPoint() { return bindPoint; }
 
 private:
     VkPipelineLayout layout;
     VkPipeline pipeline;
+    VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     std::vector<DS::DescriptorSet*> descriptorSets;
     std::vector<bool> descriptorSetsActive;
 };
@@ -35,7 +35,7 @@ namespace pipeline_inputs {
     std::vector<VkVertexInputBindingDescription> bindingDescriptions() {
 	std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
 	bindingDescriptions[0].binding = 0;
-	bindingDescriptions[0].stride = sizeof(Vertex3D);
+	bindingDescriptions[0].stride = sizeof(PackedVertex3D);
 	bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
       
 	return bindingDescriptions;
@@ -44,21 +44,22 @@ namespace pipeline_inputs {
     std::vector<VkVertexInputAttributeDescription> attributeDescriptions() {
 	std::vector<VkVertexInputAttributeDescription> attributeDescriptions(3);
       
-	//position
+	//position, within the mesh's position range
 	attributeDescriptions[0].binding = 0;
 	attributeDescriptions[0].location = 0;
-	attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attributeDescriptions[0].offset = offsetof(Vertex3D, Position);
+	attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+	attributeDescriptions[0].offset = offsetof(PackedVertex3D, Position);
 
+	//octahedral normal
 	attributeDescriptions[1].binding = 0;
 	attributeDescriptions[1].location = 1;
-	attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attributeDescriptions[1].offset = offsetof(Vertex3D, Normal);
+	attributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM;
+	attributeDescriptions[1].offset = offsetof(PackedVertex3D, Normal);
 
 	attributeDescriptions[2].binding = 0;
 	attributeDescriptions[2].location = 2;
-	attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-	attributeDescriptions[2].offset = offsetof(Vertex3D, TexCoord);
+	attributeDescriptions[2].format = VK_FORMAT_R16G16_SFLOAT;
+	attributeDescriptions[2].offset = offsetof(PackedVertex3D, TexCoord);
 
 	return attributeDescriptions;
     }
@@ -69,7 +70,7 @@ namespace pipeline_inputs {
     std::vector<VkVertexInputBindingDescription> bindingDescriptions() {
 	std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
 	bindingDescriptions[0].binding = 0;
-	bindingDescriptions[0].stride = sizeof(VertexAnim3D);
+	bindingDescriptions[0].stride = sizeof(PackedVertexAnim3D);
 	bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
 	return bindingDescriptions;
@@ -78,31 +79,32 @@ namespace pipeline_inputs {
     std::vector<VkVertexInputAttributeDescription> attributeDescriptions() {
 	std::vector<VkVertexInputAttributeDescription> attributeDescriptions(5);
 
-	//position
+	//position, within the mesh's position range
 	attributeDescriptions[0].binding = 0;
 	attributeDescriptions[0].location = 0;
-	attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attributeDescriptions[0].offset = offsetof(VertexAnim3D, Position);
+	attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+	attributeDescriptions[0].offset = offsetof(PackedVertexAnim3D, Position);
 
+	//octahedral normal
 	attributeDescriptions[1].binding = 0;
 	attributeDescriptions[1].location = 1;
-	attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attributeDescriptions[1].offset = offsetof(VertexAnim3D, Normal);
+	attributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM;
+	attributeDescriptions[1].offset = offsetof(PackedVertexAnim3D, Normal);
 
 	attributeDescriptions[2].binding = 0;
 	attributeDescriptions[2].location = 2;
-	attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-	attributeDescriptions[2].offset = offsetof(VertexAnim3D, TexCoord);
+	attributeDescriptions[2].format = VK_FORMAT_R16G16_SFLOAT;
+	attributeDescriptions[2].offset = offsetof(PackedVertexAnim3D, TexCoord);
 
 	attributeDescriptions[3].binding = 0;
 	attributeDescriptions[3].location = 3;
-	attributeDescriptions[3].format = VK_FORMAT_R32G32B32A32_SINT;
-	attributeDescriptions[3].offset = offsetof(VertexAnim3D, BoneIDs);
+	attributeDescriptions[3].format = VK_FORMAT_R8G8B8A8_UINT;
+	attributeDescriptions[3].offset = offsetof(PackedVertexAnim3D, BoneIDs);
 
 	attributeDescriptions[4].binding = 0;
 	attributeDescriptions[4].location = 4;
-	attributeDescriptions[4].format = VK_FORMAT_R32G32B32A32_SFLOAT;
-	attributeDescriptions[4].offset = offsetof(VertexAnim3D, Weights);
+	attributeDescriptions[4].format = VK_FORMAT_R8G8B8A8_UNORM;
+	attributeDescriptions[4].offset = offsetof(PackedVertexAnim3D, Weights);
 
 	return attributeDescriptions;
     }
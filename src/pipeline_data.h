@@ -1,5 +1,5 @@
 /// The input data descriptions for the default graphics pipelines.
-/// Vertex2D, Vertex3D, VertexAnim3D bindings and attribute descriptions.
+/// Vertex2D, PackedVertex3D, PackedVertexAnim3D bindings and attribute descriptions.
 
 #ifndef VKENV_PIPELINE_DATA_H
 #define VKENV_PIPELINE_DATA_H
@@ -8,12 +8,6 @@
 #include <volk.h>
 #include <vector>
 
-struct fragPushConstants {
-    glm::vec4 colour;
-    glm::vec4 texOffset;
-    int32_t TexID;
-};
-
 namespace pipeline_inputs {
   namespace V2D {
     std::vector<VkVertexInputBindingDescription> bindingDescriptions();
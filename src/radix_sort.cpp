@@ -0,0 +1,60 @@
+#include "radix_sort.h"
+
+#include <cstring>
+#include <utility>
+
+namespace radix {
+
+  const int DIGIT_BITS = 8;
+  const int DIGIT_COUNT = 1 << DIGIT_BITS;
+  const int PASSES = 32 / DIGIT_BITS;
+
+  void sort(uint32_t* keys, uint32_t* values, size_t count,
+	    std::vector<uint32_t> &tmpKeys, std::vector<uint32_t> &tmpValues) {
+      if(count < 2)
+	  return;
+      tmpKeys.resize(count);
+      tmpValues.resize(count);
+
+      // histograms for every pass in one read of the keys
+      size_t histogram[PASSES][DIGIT_COUNT];
+      std::memset(histogram, 0, sizeof(histogram));
+      for(size_t i = 0; i < count; i++)
+	  for(int p = 0; p < PASSES; p++)
+	      histogram[p][(keys[i] >> (p * DIGIT_BITS)) & (DIGIT_COUNT - 1)]++;
+
+      uint32_t *srcKeys = keys, *srcValues = values;
+      uint32_t *dstKeys = tmpKeys.data(), *dstValues = tmpValues.data();
+      for(int p = 0; p < PASSES; p++) {
+	  int shift = p * DIGIT_BITS;
+	  // every key has the same digit, so this pass wouldn't change the order
+	  if(histogram[p][(srcKeys[0] >> shift) & (DIGIT_COUNT - 1)] == count)
+	      continue;
+	  size_t offset = 0;
+	  for(int d = 0; d < DIGIT_COUNT; d++) {
+	      size_t n = histogram[p][d];
+	      histogram[p][d] = offset;
+	      offset += n;
+	  }
+	  for(size_t i = 0; i < count; i++) {
+	      size_t dst = histogram[p][(srcKeys[i] >> shift) & (DIGIT_COUNT - 1)]++;
+	      dstKeys[dst] = srcKeys[i];
+	      dstValues[dst] = srcValues[i];
+	  }
+	  std::swap(srcKeys, dstKeys);
+	  std::swap(srcValues, dstValues);
+      }
+      if(srcKeys != keys) {
+	  std::memcpy(keys, srcKeys, count * sizeof(uint32_t));
+	  std::memcpy(values, srcValues, count * sizeof(uint32_t));
+      }
+  }
+
+  uint32_t floatKey(float f) {
+      uint32_t u;
+      std::memcpy(&u, &f, sizeof(u));
+      // negative floats sort in reverse, so flip all their bits,
+      // positive floats just need to come after the negatives
+      return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+  }
+}
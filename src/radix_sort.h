@@ -0,0 +1,21 @@
+/// Sorting for draw ordering on the CPU.
+
+#ifndef VKENV_RADIX_SORT_H
+#define VKENV_RADIX_SORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace radix {
+  /// Stable least significant digit radix sort of 32 bit keys in ascending order.
+  /// values are moved with their keys.
+  /// tmpKeys and tmpValues are scratch space, resized as needed.
+  void sort(uint32_t* keys, uint32_t* values, size_t count,
+	    std::vector<uint32_t> &tmpKeys, std::vector<uint32_t> &tmpValues);
+
+  /// map a float to a key that sorts in the same order
+  uint32_t floatKey(float f);
+}
+
+#endif
@@ -8,6 +8,8 @@
 #include "pipeline.h"
 #include "pipeline_data.h"
 #include "resources/resource_pool.h"
+#include "culling.h"
+#include "radix_sort.h"
 #include "vkhelper.h"
 #include "logger.h"
 
@@ -59,8 +61,21 @@ RenderVk::RenderVk(GLFWwindow *window, RenderConfig renderConf) : Render(window,
     this->prevRenderConf = renderConf;
     EnabledFeatures features;
     features.sampleRateShading = renderConf.sample_shading;
+    features.multiDrawIndirect = true;
+    features.drawIndirectFirstInstance = true;
+    features.shaderDrawParameters = true;
     manager = new VulkanManager(window, features);
+    ModelLoaderVk::createMaterialSetLayout(manager->deviceState.device, &materialSet.layout);
     offscreenDepthFormat = getDepthBufferFormat(manager->deviceState.physicalDevice);
+    VkFormatProperties depthProps;
+    vkGetPhysicalDeviceFormatProperties(manager->deviceState.physicalDevice,
+					offscreenDepthFormat, &depthProps);
+    offscreenDepthSampled =
+	(depthProps.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+    VkPhysicalDeviceProperties deviceProps;
+    vkGetPhysicalDeviceProperties(manager->deviceState.physicalDevice, &deviceProps);
+    if(deviceProps.limits.timestampComputeAndGraphics)
+	timestampPeriod = deviceProps.limits.timestampPeriod;
     
     frames = new Frame*[frameCount];
     for(int i = 0; i < frameCount; i++)
@@ -68,13 +83,23 @@ RenderVk::RenderVk(GLFWwindow *window, RenderConfig renderConf) : Render(window,
 			      manager->deviceState.queue.graphicsPresentFamilyIndex);
     pools = new PoolManagerVk;
     defaultPool = CreateResourcePool()->id();
+    particles = new ParticleSystem(manager->deviceState);
+    debugDraw = new DebugDrawVk(manager->deviceState);
+    culler = new InstanceCuller(manager->deviceState);
+    instanceBuffers = new InstanceBuffers(manager->deviceState, manager->generalCommandPool,
+					  manager->generalCommandBuffer);
 }
   
 RenderVk::~RenderVk() {
     vkDeviceWaitIdle(manager->deviceState.device);
 
     _destroyFrameResources();
+    delete particles;
+    delete debugDraw;
+    delete culler;
+    delete instanceBuffers;
     delete pools;
+    materialSet.destroySet(manager->deviceState.device);
     if(offscreenRenderPass != nullptr || finalRenderPass != nullptr) {
 	delete offscreenRenderPass;
 	delete finalRenderPass;
@@ -142,6 +167,12 @@ bool swapchainRecreationRequired(VkResult result) {
 	  LOG_ERROR("Ran out of texture slots in shader! current limit: "
 		    << Resource::MAX_TEXTURES_SUPPORTED);
       }
+      // material tables hold texture view indices
+      for(int i = 0; i < pools->PoolCount(); i++) {
+	  ResourcePoolVk* p = pools->get(i);
+	  if(p != nullptr && p->usingGPUResources)
+	      p->modelLoader->updateMaterials();
+      }
   }
 
   
@@ -181,7 +212,28 @@ bool swapchainRecreationRequired(VkResult result) {
       if(!renderConf.multisampling)
 	  sampleCount = VK_SAMPLE_COUNT_1_BIT;
 
-      if(swapchainFormat != prevSwapchainFormat || sampleCount != prevSampleCount) {
+      // culled draws start at each job's visible instance offset
+      bool gpuCull = renderConf.gpu_cull_3D;
+      if(gpuCull && !manager->deviceState.features.drawIndirectFirstInstance) {
+	  LOG("the device doesn't support drawIndirectFirstInstance, gpu culling is disabled");
+	  gpuCull = false;
+      }
+      // the pyramid is built by sampling the depth attachment, so it can't be multisampled
+      bool occlusionCull = gpuCull && renderConf.occlusion_cull_3D;
+      if(occlusionCull && sampleCount != VK_SAMPLE_COUNT_1_BIT) {
+	  LOG("occlusion culling is not supported with multisampling, it is disabled");
+	  occlusionCull = false;
+      }
+      if(occlusionCull && !offscreenDepthSampled) {
+	  LOG("the depth buffer format can't be sampled, so occlusion culling is disabled");
+	  occlusionCull = false;
+      }
+
+      // the pyramid is built from the pre-pass, so only 3D models occlude
+      bool depthPrepass = renderConf.depth_prepass_3D || occlusionCull;
+
+      if(swapchainFormat != prevSwapchainFormat || sampleCount != prevSampleCount ||
+	 occlusionCull != prevOcclusionCull || depthPrepass != prevDepthPrepass) {
 	  if(offscreenRenderPass != nullptr) {
 	      LOG("not nullptr");
 	      delete offscreenRenderPass;
@@ -203,14 +255,17 @@ bool swapchainRecreationRequired(VkResult result) {
 		      AttachmentDesc(0, AttachmentType::Colour,
 				     AttachmentUse::ShaderRead,
 				     VK_SAMPLE_COUNT_1_BIT, swapchainFormat));
+	  // sampled after the depth pre-pass to build the pyramid when occlusion culling
 	  offscreenAttachments.push_back(
 		  AttachmentDesc(1, AttachmentType::Depth,
+				 occlusionCull ? AttachmentUse::ShaderRead :
 				 AttachmentUse::Attachment,
 				 sampleCount, offscreenDepthFormat));
 	  
 	  LOG("making new renderpasses");
 	  offscreenRenderPass = new RenderPass(manager->deviceState.device, offscreenAttachments,
-					       renderConf.clear_colour);
+					       renderConf.clear_colour,
+					       depthPrepass);
 	  finalRenderPass =
 	      new RenderPass(manager->deviceState.device,
 			     { AttachmentDesc(0, AttachmentType::Colour,
@@ -221,6 +276,8 @@ bool swapchainRecreationRequired(VkResult result) {
       
       prevSwapchainFormat = swapchainFormat;
       prevSampleCount = sampleCount;
+      prevOcclusionCull = occlusionCull;
+      prevDepthPrepass = depthPrepass;
 
       std::vector<VkImage>* swapchainImages = swapchain->getSwapchainImages();
       swapchainFrameCount = swapchainImages->size();
@@ -275,6 +332,7 @@ bool swapchainRecreationRequired(VkResult result) {
 
       descriptor::Set VP2D_Set("VP2D", descriptor::ShaderStage::Vertex);
       VP2D_Set.AddDescriptor(viewProjectionBinding);
+      VP2D_Set.AddDescriptor(timeBinding);
       VP2D = new DescSet(VP2D_Set, swapchainFrameCount, manager->deviceState.device);
 
       descriptor::Set Time_Set("Time", descriptor::ShaderStage::Vertex);
@@ -282,13 +340,57 @@ bool swapchainRecreationRequired(VkResult result) {
 	      "Time Struct", descriptor::Type::UniformBuffer, sizeof(shaderStructs::timeUbo), 1);
       
 
-      descriptor::Set PerFrame3D_Set("Per Frame 3D", descriptor::ShaderStage::Vertex);
+      _max3DInstances = renderConf.max_3D_instances > 0 ? renderConf.max_3D_instances : 1;
+      perFrame3DData.resize(_max3DInstances);
+      perFrame3DPrevData.resize(_max3DInstances);
+      // each mesh of a culled batch lists its visible instances separately,
+      // so every instance can be visible in every mesh of the largest model
+      uint32_t culledCapacity = 0;
+      if(gpuCull) {
+	  uint32_t maxMeshes = 1;
+	  for(int i = 0; i < pools->PoolCount(); i++) {
+	      ResourcePoolVk* p = pools->get(i);
+	      if(p != nullptr && p->UseGPUResources)
+		  maxMeshes = glm::max(
+			  maxMeshes, p->modelLoader->getMaxMeshCount(Resource::ModelType::m3D));
+	  }
+	  culledCapacity = _max3DInstances * maxMeshes;
+      }
+      descriptor::Set PerFrame3D_Set("Per Frame 3D", descriptor::ShaderStage::VertexCompute);
       PerFrame3D_Set.AddSingleArrayStructDescriptor(
 	      "3D Instance Array",
 	      descriptor::Type::StorageBuffer,
 	      sizeof(shaderStructs::PerFrame3D),
-	      Resource::MAX_3D_BATCH);
+	      _max3DInstances);
+      PerFrame3D_Set.AddSingleArrayStructDescriptor(
+	      "3D Previous Transforms",
+	      descriptor::Type::StorageBuffer,
+	      sizeof(glm::mat3x4),
+	      _max3DInstances);
+      PerFrame3D_Set.AddSingleArrayStructDescriptor(
+	      "3D Visible Instances",
+	      descriptor::Type::StorageBuffer,
+	      sizeof(glm::uvec4),
+	      _max3DInstances + culledCapacity);
       perFrame3D = new DescSet(PerFrame3D_Set, swapchainFrameCount, manager->deviceState.device);
+
+      if(gpuCull) {
+	  descriptor::Set cull3D_Set("3D Culling", descriptor::ShaderStage::Compute);
+	  cull3D_Set.AddSingleArrayStructDescriptor(
+		  "Cull Jobs",
+		  descriptor::Type::StorageBuffer,
+		  sizeof(shaderStructs::CullJob),
+		  MAX_CULL_JOBS);
+	  cull3D_Set.AddSingleArrayStructDescriptor(
+		  "Cull Draw Commands",
+		  descriptor::Type::StorageBuffer,
+		  sizeof(shaderStructs::CullDrawCommand),
+		  MAX_CULL_JOBS);
+	  cull3D_Set.AddDescriptor(
+		  "Cull Params", descriptor::Type::UniformBuffer,
+		  sizeof(shaderStructs::CullParams), 1);
+	  cull3D = new DescSet(cull3D_Set, swapchainFrameCount, manager->deviceState.device);
+      }
       
 
       descriptor::Set bones_Set("Bones Animation", descriptor::ShaderStage::Vertex);
@@ -296,10 +398,22 @@ bool swapchainRecreationRequired(VkResult result) {
 			      sizeof(shaderStructs::Bones), MAX_ANIMATIONS_PER_FRAME);
       bones = new DescSet(bones_Set, swapchainFrameCount, manager->deviceState.device);
 
+      _max2DInstances = renderConf.max_2D_instances > 0 ? renderConf.max_2D_instances : 1;
+      perFrame2DVertData.resize(_max2DInstances);
+      perFrame2DAnimData.resize(_max2DInstances);
+      perFrame2DPrevData.resize(_max2DInstances);
+      perFrame2DSortKey.resize(_max2DInstances);
+      perFrame2DFragData.resize(_max2DInstances);
       descriptor::Set vert2D_Set("Per Frame 2D Vert", descriptor::ShaderStage::Vertex);
       vert2D_Set.AddSingleArrayStructDescriptor(
 	      "vert struct", descriptor::Type::StorageBuffer,
-	      sizeof(glm::mat4), Resource::MAX_2D_BATCH);
+	      sizeof(glm::mat4), _max2DInstances);
+      vert2D_Set.AddSingleArrayStructDescriptor(
+	      "anim struct", descriptor::Type::StorageBuffer,
+	      sizeof(shaderStructs::Anim2D), _max2DInstances);
+      vert2D_Set.AddSingleArrayStructDescriptor(
+	      "previous vert struct", descriptor::Type::StorageBuffer,
+	      sizeof(glm::mat4), _max2DInstances);
       perFrame2DVert = new DescSet(vert2D_Set, swapchainFrameCount, manager->deviceState.device);
 
       descriptor::Set offscreenView_Set("Offscreen Transform", descriptor::ShaderStage::Vertex);
@@ -361,7 +475,11 @@ bool swapchainRecreationRequired(VkResult result) {
       frag2D_Set.AddSingleArrayStructDescriptor(
 	      "Per frag struct",
 	      descriptor::Type::StorageBuffer,
-	      sizeof(shaderStructs::Frag2DData), Resource::MAX_2D_BATCH);
+	      sizeof(shaderStructs::Frag2DData), _max2DInstances);
+      frag2D_Set.AddSingleArrayStructDescriptor(
+	      "Clip rects",
+	      descriptor::Type::StorageBuffer,
+	      sizeof(glm::vec4), Resource::MAX_2D_CLIP_RECTS);
       perFrame2DFrag = new DescSet(frag2D_Set, swapchainFrameCount, manager->deviceState.device);
 
       emptyDS = new DescSet(
@@ -390,6 +508,8 @@ bool swapchainRecreationRequired(VkResult result) {
 	  VP3D, VP2D, perFrame3D, bones, emptyDS, perFrame2DVert,
 	  perFrame2DFrag, offscreenTransform, lighting,
 	  textures, offscreenTex};
+      if(cull3D != nullptr)
+	  descriptorSets.push_back(cull3D);
       
       LOG("Creating Descriptor pool and memory for set bindings");
       
@@ -411,6 +531,13 @@ bool swapchainRecreationRequired(VkResult result) {
 	      manager->deviceState, bindings,
 	      &_shaderBuffer, &_shaderMemory);
 
+      // direct 3D draws index the visible instance list with their instance index
+      for(size_t frame = 0; frame < swapchainFrameCount; frame++)
+	  for(uint32_t i = 0; i < _max3DInstances; i++) {
+	      glm::uvec4 index(i, 0, 0, 0);
+	      perFrame3D->bindings[2].storeSetData(frame, &index, 0, i, 0);
+	  }
+
       LOG("Creating Graphics Pipelines");
 
       // create pipeline for each shader set -> 3D, animated 3D, 2D, and final
@@ -418,28 +545,72 @@ bool swapchainRecreationRequired(VkResult result) {
       pipelineConf.useMultisampling = renderConf.multisampling;
       pipelineConf.msaaSamples = sampleCount;
       pipelineConf.useSampleShading = manager->deviceState.features.sampleRateShading;
+      // the 3D vertex shaders index materials by gl_DrawID when draw parameters are supported
+      std::string vert3DSuffix = manager->deviceState.features.shaderDrawParameters ?
+	  ".spv" : ".nodrawid.spv";
+      if(offscreenRenderPass->hasDepthPrepass()) {
+	  // the same layout as the colour pipeline, so the model loaders can draw with it
+	  part::create::PipelineConfig depthConf = pipelineConf;
+	  depthConf.colourAttachment = false;
+	  depthConf.blendEnabled = false;
+	  part::create::GraphicsPipeline(
+		  manager->deviceState.device, &_pipeline3DDepth,
+		  offscreenRenderPass->getDepthPrepass(),
+		  {&VP3D->set, &perFrame3D->set, &emptyDS->set, &textures->set, &lighting->set,
+		   &materialSet},
+		  {{VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(shaderStructs::Draw3DParams)}},
+		  "shaders/vulkan/3D-depth.vert" + vert3DSuffix, "",
+		  offscreenBufferExtent,
+		  pipeline_inputs::V3D::attributeDescriptions(),
+		  pipeline_inputs::V3D::bindingDescriptions(),
+		  depthConf);
+	  part::create::GraphicsPipeline(
+		  manager->deviceState.device, &_pipeline3DDepthAlpha,
+		  offscreenRenderPass->getDepthPrepass(),
+		  {&VP3D->set, &perFrame3D->set, &emptyDS->set, &textures->set, &lighting->set,
+		   &materialSet},
+		  {{VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(shaderStructs::Draw3DParams)}},
+		  "shaders/vulkan/3D-depth.vert" + vert3DSuffix, "shaders/vulkan/3D-depth.frag.spv",
+		  offscreenBufferExtent,
+		  pipeline_inputs::V3D::attributeDescriptions(),
+		  pipeline_inputs::V3D::bindingDescriptions(),
+		  depthConf);
+	  _pipeline3DDepthCreated = true;
+	  // only the nearest fragments, found by the pre-pass, are shaded
+	  pipelineConf.depthCompareOp = VK_COMPARE_OP_EQUAL;
+	  pipelineConf.depthWrite = false;
+      }
       part::create::GraphicsPipeline(
 	      manager->deviceState.device, &_pipeline3D,
 	      offscreenRenderPass->getRenderPass(),
-	      {&VP3D->set, &perFrame3D->set, &emptyDS->set, &textures->set, &lighting->set},
-	      {{VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(fragPushConstants)}},
-	      "shaders/vulkan/3D-lighting.vert.spv", "shaders/vulkan/blinnphong.frag.spv",
+	      {&VP3D->set, &perFrame3D->set, &emptyDS->set, &textures->set, &lighting->set,
+	       &materialSet},
+	      {{VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(shaderStructs::Draw3DParams)}},
+	      "shaders/vulkan/3D-lighting.vert" + vert3DSuffix,
+	      "shaders/vulkan/blinnphong.frag.spv",
 	      offscreenBufferExtent,
 	      pipeline_inputs::V3D::attributeDescriptions(),
 	      pipeline_inputs::V3D::bindingDescriptions(),
 	      pipelineConf);
+      pipelineConf.depthCompareOp = VK_COMPARE_OP_LESS;
+      pipelineConf.depthWrite = true;
 	    
       part::create::GraphicsPipeline(
 	      manager->deviceState.device, &_pipelineAnim3D,
 	      offscreenRenderPass->getRenderPass(),
-	      {&VP3D->set, &perFrame3D->set, &bones->set, &textures->set, &lighting->set},
-	      {{VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(fragPushConstants)}},
-	      "shaders/vulkan/3D-lighting-anim.vert.spv", "shaders/vulkan/blinnphong.frag.spv",
+	      {&VP3D->set, &perFrame3D->set, &bones->set, &textures->set, &lighting->set,
+	       &materialSet},
+	      {{VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(shaderStructs::Draw3DParams)}},
+	      "shaders/vulkan/3D-lighting-anim.vert" + vert3DSuffix,
+	      "shaders/vulkan/blinnphong.frag.spv",
 	      offscreenBufferExtent,
 	      pipeline_inputs::VAnim3D::attributeDescriptions(),
 	      pipeline_inputs::VAnim3D::bindingDescriptions(),
 	      pipelineConf);
 
+      // sorted quads at the same depth must draw over the ones before them
+      if(renderConf.sort_2D_by_key)
+	  pipelineConf.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
       part::create::GraphicsPipeline(
 	      manager->deviceState.device, &_pipeline2D,
 	      offscreenRenderPass->getRenderPass(),
@@ -450,6 +621,37 @@ bool swapchainRecreationRequired(VkResult result) {
 	      pipeline_inputs::V2D::bindingDescriptions(),
 	      pipelineConf);
 
+      if(renderConf.sort_2D_by_opacity) {
+	  pipelineConf.blendEnabled = false;
+	  part::create::GraphicsPipeline(
+		  manager->deviceState.device, &_pipeline2DOpaque,
+		  offscreenRenderPass->getRenderPass(),
+		  {&VP2D->set, &perFrame2DVert->set, &textures->set, &perFrame2DFrag->set}, {},
+		  "shaders/vulkan/flat.vert.spv", "shaders/vulkan/flat-opaque.frag.spv",
+		  offscreenBufferExtent,
+		  pipeline_inputs::V2D::attributeDescriptions(),
+		  pipeline_inputs::V2D::bindingDescriptions(),
+		  pipelineConf);
+	  pipelineConf.blendEnabled = true;
+	  _pipeline2DOpaqueCreated = true;
+      }
+      pipelineConf.depthCompareOp = VK_COMPARE_OP_LESS;
+
+      // particles are blended, so they don't write depth
+      part::create::PipelineConfig particleConf = pipelineConf;
+      particleConf.depthWrite = false;
+      particleConf.cullMode = VK_CULL_MODE_NONE;
+      particles->setPipelineTarget(offscreenRenderPass->getRenderPass(), offscreenBufferExtent,
+				   &VP2D->set, &textures->set, particleConf);
+      debugDraw->setPipelineTarget(offscreenRenderPass->getRenderPass(), offscreenBufferExtent,
+				   swapchainFrameCount, pipelineConf);
+      if(cull3D != nullptr)
+	  culler->createPipeline(perFrame3D, cull3D, _shaderBuffer,
+				 _max3DInstances, culledCapacity,
+				 offscreenRenderPass->getExtent(),
+				 prevOcclusionCull ? offscreenRenderPass->getAttachmentViews(1) :
+				 std::vector<VkImageView>());
+
       pipelineConf.useMultisampling = false;
       pipelineConf.useDepthTest = false;
       pipelineConf.blendEnabled = false;
@@ -482,12 +684,25 @@ bool swapchainRecreationRequired(VkResult result) {
       for(int i = 0; i < descriptorSets.size(); i++)
 	  delete descriptorSets[i];
       descriptorSets.clear();
+      cull3D = nullptr;
       vkDestroyDescriptorPool(manager->deviceState.device, _descPool, nullptr);
       LOG("    destroying Pipelines");
       _pipeline3D.destroy(manager->deviceState.device);
       _pipelineAnim3D.destroy(manager->deviceState.device);
       _pipeline2D.destroy(manager->deviceState.device);
+      if(_pipeline2DOpaqueCreated) {
+	  _pipeline2DOpaque.destroy(manager->deviceState.device);
+	  _pipeline2DOpaqueCreated = false;
+      }
+      if(_pipeline3DDepthCreated) {
+	  _pipeline3DDepth.destroy(manager->deviceState.device);
+	  _pipeline3DDepthAlpha.destroy(manager->deviceState.device);
+	  _pipeline3DDepthCreated = false;
+      }
       _pipelineFinal.destroy(manager->deviceState.device);
+      particles->destroyPipelines();
+      debugDraw->destroyPipeline();
+      culler->destroyPipeline();
       LOG("    closing pools");
       for(int i = 0; i < pools->PoolCount(); i++)
 	  if(pools->get(i) != nullptr)
@@ -604,12 +819,34 @@ void RenderVk::_startDraw() {
     frameIndex = (frameIndex + 1) % frameCount;
     checkResultAndThrow(frames[frameIndex]->waitForPreviousFrame(),
 			"Render Error: failed to wait for previous frame fence");
+    _readTimings(frames[frameIndex]);
     VkResult result = swapchain->acquireNextImage(frames[frameIndex]->swapchainImageReady,
 						 &swapchainFrameIndex);
     if(result != VK_SUCCESS && !swapchainRecreationRequired(result))
 	    checkResultAndThrow(result, "Render Error: failed to begin offscreen render pass!");
     checkResultAndThrow(frames[frameIndex]->startFrame(&currentCommandBuffer),
 			"Render Error: Failed to start command buffer.");
+
+    // copy newly rasterised glyphs into font atlases
+    for(int i = 0; i < pools->PoolCount(); i++) {
+	ResourcePoolVk* p = pools->get(i);
+	if(p == nullptr || !p->usingGPUResources)
+	    continue;
+	p->fontLoader->newFrame();
+	p->texLoader->recordRegionUpdates(currentCommandBuffer, frameIndex, frameCount);
+	p->modelLoader->beginFrame(frameIndex, frameCount);
+    }
+    particles->recordSimulation(currentCommandBuffer);
+    culler->beginFrame(swapchainFrameIndex);
+    instanceBuffers->beginFrame();
+    _depthPrepassDraws.clear();
+
+    if(timestampPeriod > 0.0f) {
+	VkQueryPool queries = frames[frameIndex]->timestamps;
+	vkCmdResetQueryPool(currentCommandBuffer, queries, TIMESTAMP_COLOUR_START, 2);
+	vkCmdWriteTimestamp(currentCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			    queries, TIMESTAMP_COLOUR_START);
+    }
     offscreenRenderPass->beginRenderPass(currentCommandBuffer, swapchainFrameIndex);
     
     currentBonesDynamicOffset = 0;
@@ -618,13 +855,47 @@ void RenderVk::_startDraw() {
 }
 
 void RenderVk::_store3DsetData() {
+    VP3DData.interpolation = renderConf.interpolate_transforms ? _interpolation : 1.0f;
     VP3D->bindings[0].storeSetData(swapchainFrameIndex, &VP3DData);
     VP3D->bindings[1].storeSetData(swapchainFrameIndex, &timeData);
     lighting->bindings[0].storeSetData(swapchainFrameIndex, &lightingData);
+    cull::frustumPlanes(VP3DData.proj * VP3DData.view, _frustum3D);
+    _view3D = VP3DData.view;
+    _proj3D = VP3DData.proj;
+}
+
+bool RenderVk::_modelOffscreen(Resource::Model model, const glm::mat4 &modelMatrix) {
+    if(!renderConf.cull_3D)
+	return false;
+    Resource::Bounds bounds = pools->get(model.pool)->modelLoader->getBounds(model);
+    return cull::sphereOutsideFrustum(_frustum3D, modelMatrix, bounds.sphere);
+}
+
+uint32_t RenderVk::_selectLOD(Resource::Model model, const glm::mat4 &modelMatrix,
+			      const glm::vec4 *sphere) {
+    if(renderConf.lod_screen_size <= 0.0f)
+	return 0;
+    ModelLoaderVk* loader = pools->get(model.pool)->modelLoader;
+    uint32_t lodCount = loader->getLODCount(model);
+    if(lodCount <= 1)
+	return 0;
+    float size = cull::sphereScreenHeight(
+	    _view3D, _proj3D, modelMatrix,
+	    sphere != nullptr ? *sphere : loader->getBounds(model).sphere);
+    uint32_t lod = 0;
+    float threshold = renderConf.lod_screen_size;
+    while(lod + 1 < lodCount && size < threshold) {
+	lod++;
+	threshold *= 0.5f;
+    }
+    return lod;
 }
 
 void RenderVk::_store2DsetData() {
+    VP2DData.interpolation = renderConf.interpolate_transforms ? _interpolation : 1.0f;
     VP2D->bindings[0].storeSetData(swapchainFrameIndex, &VP2DData);
+    VP2D->bindings[1].storeSetData(swapchainFrameIndex, &timeData);
+    _viewProj2D = VP2DData.proj * VP2DData.view;
 }
 
 void RenderVk::_begin(RenderState state) {
@@ -656,8 +927,17 @@ void RenderVk::_begin(RenderState state) {
 }
   
 
-  void RenderVk::DrawModel(Resource::Model model, glm::mat4 modelMatrix, glm::mat4 normalMat) {
-    if (_current3DInstanceIndex >= Resource::MAX_3D_BATCH) {
+  void RenderVk::DrawModel(Resource::Model model, glm::mat4 modelMatrix) {
+      DrawModel(model, modelMatrix, modelMatrix, glm::mat4(1.0f));
+  }
+
+  void RenderVk::DrawModel(Resource::Model model, glm::mat4 prevModelMatrix,
+			   glm::mat4 modelMatrix, glm::mat4 normalMat) {
+    if(model.type == Resource::ModelType::m2D) {
+	_drawModel2D(model, prevModelMatrix, modelMatrix);
+	return;
+    }
+    if (_current3DInstanceIndex >= _max3DInstances) {
 	LOG("WARNING: ran out of 3D instances!");
 	return;
     }
@@ -667,23 +947,162 @@ void RenderVk::_begin(RenderState state) {
     }
     
     _begin(RenderState::Draw3D);
+    if(_modelOffscreen(model, modelMatrix))
+	return;
     
-    if (model != _currentModel)
+    uint32_t lod = _selectLOD(model, modelMatrix);
+    if (!_sameModelMeshes(model, _currentModel) || lod != _currentLOD)
 	_drawBatch();
     
     _bindModelPool(model);
     _currentModel = model;
-    perFrame3DData[_current3DInstanceIndex + _modelRuns].model = modelMatrix;
-    perFrame3DData[_current3DInstanceIndex + _modelRuns].normalMat = normalMat;
+    _currentLOD = lod;
+    perFrame3DData[_current3DInstanceIndex + _modelRuns].model =
+	shaderStructs::affineRows(modelMatrix);
+    _write3DOverrides(model, perFrame3DData[_current3DInstanceIndex + _modelRuns]);
+    perFrame3DPrevData[_current3DInstanceIndex + _modelRuns] =
+	shaderStructs::affineRows(prevModelMatrix);
     _modelRuns++;
     
-    if (_current3DInstanceIndex + _modelRuns == Resource::MAX_3D_BATCH)
+    if (_current3DInstanceIndex + _modelRuns == _max3DInstances)
+	_drawBatch();
+}
+
+/// a sphere around the model's bounding sphere placed by each of the instances
+glm::vec4 instancesBounds(const Resource::InstanceTransform* instances, size_t count,
+			  glm::vec4 modelSphere) {
+    glm::vec3 minPos = glm::vec3(instances[0].model[3]);
+    glm::vec3 maxPos = minPos;
+    float maxScale = 0.0f;
+    for(size_t i = 0; i < count; i++) {
+	const glm::mat4 &m = instances[i].model;
+	minPos = glm::min(minPos, glm::vec3(m[3]));
+	maxPos = glm::max(maxPos, glm::vec3(m[3]));
+	maxScale = glm::max(maxScale,
+			    glm::max(glm::length(glm::vec3(m[0])),
+				     glm::max(glm::length(glm::vec3(m[1])),
+					      glm::length(glm::vec3(m[2])))));
+    }
+    glm::vec3 centre = (minPos + maxPos) * 0.5f;
+    float originRadius = 0.0f;
+    for(size_t i = 0; i < count; i++)
+	originRadius = glm::max(originRadius,
+				glm::length(glm::vec3(instances[i].model[3]) - centre));
+    // each instance's sphere centre is within scale * |centre| of its origin
+    float radius = maxScale * (glm::length(glm::vec3(modelSphere)) + modelSphere.w);
+    return glm::vec4(centre, originRadius + radius);
+}
+
+void RenderVk::DrawModelInstanced(Resource::Model model,
+				  const Resource::InstanceTransform* instances, size_t count) {
+    if(count == 0)
+	return;
+    if(model.type == Resource::ModelType::m2D) {
+	for(size_t i = 0; i < count; i++)
+	    _drawModel2D(model, instances[i].previous, instances[i].model);
+	return;
+    }
+    if(model.type == Resource::ModelType::m3D_Anim) {
+	LOG_ERROR("Animated models can't be drawn instanced, use DrawAnimModel");
+	return;
+    }
+    if(!_poolInUse(model.pool)) {
+	LOG_ERROR("Tried Drawing with model in pool that is not in use");
+	return;
+    }
+
+    _begin(RenderState::Draw3D);
+    ModelLoaderVk* loader = pools->get(model.pool)->modelLoader;
+    glm::vec4 bounds = instancesBounds(instances, count, loader->getBounds(model).sphere);
+    if(renderConf.cull_3D &&
+       cull::sphereOutsideFrustum(_frustum3D, glm::mat4(1.0f), bounds))
+	return;
+    // the group is given one level of detail, by the size of a sphere around all of it
+    uint32_t lod = _selectLOD(model, glm::mat4(1.0f), &bounds);
+    if (!_sameModelMeshes(model, _currentModel) || lod != _currentLOD)
+	_drawBatch();
+    _bindModelPool(model);
+    _currentModel = model;
+    _currentLOD = lod;
+
+    size_t first = _current3DInstanceIndex + _modelRuns;
+    if(first + count > _max3DInstances) {
+	LOG("WARNING: ran out of 3D instances, raise RenderConfig::max_3D_instances!");
+	count = _max3DInstances - first;
+    }
+    shaderStructs::PerFrame3D instance;
+    _write3DOverrides(model, instance);
+    for(size_t i = 0; i < count; i++) {
+	instance.model = shaderStructs::affineRows(instances[i].model);
+	perFrame3DData[first + i] = instance;
+    }
+    // the shaders only read previous transforms when interpolating
+    if(renderConf.interpolate_transforms)
+	for(size_t i = 0; i < count; i++)
+	    perFrame3DPrevData[first + i] = shaderStructs::affineRows(instances[i].previous);
+    _modelRuns += count;
+    if (_current3DInstanceIndex + _modelRuns == _max3DInstances)
+	_drawBatch();
+}
+
+Resource::InstanceBuffer RenderVk::CreateInstanceBuffer(
+	const Resource::InstanceTransform* instances, size_t count) {
+    // drawing copies the instances into the frame's instances
+    if(count > renderConf.max_3D_instances) {
+	LOG_ERROR("instance buffers can have at most RenderConfig::max_3D_instances: "
+		  << renderConf.max_3D_instances << " instances, got: " << count);
+	return Resource::InstanceBuffer();
+    }
+    return instanceBuffers->create(instances, count);
+}
+
+void RenderVk::DestroyInstanceBuffer(Resource::InstanceBuffer buffer) {
+    instanceBuffers->destroy(buffer);
+}
+
+void RenderVk::DrawModelInstanced(Resource::Model model, Resource::InstanceBuffer instances) {
+    uint32_t count = instanceBuffers->getCount(instances);
+    if(count == 0) {
+	LOG_ERROR("Tried Drawing with instance buffer that does not exist");
+	return;
+    }
+    if(model.type != Resource::ModelType::m3D) {
+	LOG_ERROR("Instance buffers can only be drawn with non-animated 3D models");
+	return;
+    }
+    if(!_poolInUse(model.pool)) {
+	LOG_ERROR("Tried Drawing with model in pool that is not in use");
+	return;
+    }
+
+    _begin(RenderState::Draw3D);
+    ModelLoaderVk* loader = pools->get(model.pool)->modelLoader;
+    glm::vec4 bounds = instanceBuffers->getBounds(instances, loader->getBounds(model).sphere);
+    if(renderConf.cull_3D &&
+       cull::sphereOutsideFrustum(_frustum3D, glm::mat4(1.0f), bounds))
+	return;
+    // the group is given one level of detail, by the size of a sphere around all of it
+    uint32_t lod = _selectLOD(model, glm::mat4(1.0f), &bounds);
+    if (!_sameModelMeshes(model, _currentModel) || lod != _currentLOD)
+	_drawBatch();
+    _bindModelPool(model);
+    _currentModel = model;
+    _currentLOD = lod;
+
+    uint32_t first = (uint32_t)(_current3DInstanceIndex + _modelRuns);
+    if(first + count > _max3DInstances) {
+	LOG("WARNING: ran out of 3D instances, raise RenderConfig::max_3D_instances!");
+	count = _max3DInstances - first;
+    }
+    instanceBuffers->queueCopy(instances, first, count);
+    _modelRuns += count;
+    if (_current3DInstanceIndex + _modelRuns == _max3DInstances)
 	_drawBatch();
 }
 
 void RenderVk::DrawAnimModel(Resource::Model model, glm::mat4 modelMatrix,
-			   glm::mat4 normalMat, Resource::ModelAnimation *animation) {
-    if (_current3DInstanceIndex >= Resource::MAX_3D_BATCH) {
+			     Resource::ModelAnimation *animation) {
+    if (_current3DInstanceIndex >= _max3DInstances) {
 	LOG("WARNING: Ran out of 3D Anim Instance models!\n");
 	return;
     }
@@ -692,13 +1111,20 @@ void RenderVk::DrawAnimModel(Resource::Model model, glm::mat4 modelMatrix,
 	return;
     }
     _begin(RenderState::DrawAnim3D);
-    if (model != _currentModel)
+    if(_modelOffscreen(model, modelMatrix))
+	return;
+    uint32_t lod = _selectLOD(model, modelMatrix);
+    if (!_sameModelMeshes(model, _currentModel) || lod != _currentLOD)
 	_drawBatch();
     _bindModelPool(model);
     _currentModel = model;
+    _currentLOD = lod;
     _currentColour = glm::vec4(0.0f);
-    perFrame3DData[_current3DInstanceIndex + _modelRuns].model = modelMatrix;
-    perFrame3DData[_current3DInstanceIndex + _modelRuns].normalMat = normalMat;
+    perFrame3DData[_current3DInstanceIndex + _modelRuns].model =
+	shaderStructs::affineRows(modelMatrix);
+    _write3DOverrides(model, perFrame3DData[_current3DInstanceIndex + _modelRuns]);
+    perFrame3DPrevData[_current3DInstanceIndex + _modelRuns] =
+	perFrame3DData[_current3DInstanceIndex + _modelRuns].model;
     _modelRuns++;
 
     auto animBones = animation->getCurrentBones();
@@ -721,8 +1147,25 @@ void RenderVk::DrawAnimModel(Resource::Model model, glm::mat4 modelMatrix,
 }
 
 void RenderVk::DrawQuad(Resource::Texture texture, glm::mat4 modelMatrix, glm::vec4 colour, glm::vec4 texOffset) {
-  if (_current2DInstanceIndex >= Resource::MAX_2D_BATCH) {
-      LOG("WARNING: ran out of 2D instance models!\n");
+    _drawQuad(texture, modelMatrix, modelMatrix, colour, texOffset, Resource::SpriteAnimation());
+}
+
+void RenderVk::DrawQuad(Resource::Texture texture, glm::mat4 modelMatrix, glm::vec4 colour,
+			glm::vec4 texOffset, Resource::SpriteAnimation animation) {
+    _drawQuad(texture, modelMatrix, modelMatrix, colour, texOffset, animation);
+}
+
+void RenderVk::DrawQuad(Resource::Texture texture, glm::mat4 previousModelMatrix,
+			glm::mat4 modelMatrix, glm::vec4 colour, glm::vec4 texOffset) {
+    _drawQuad(texture, previousModelMatrix, modelMatrix, colour, texOffset,
+	      Resource::SpriteAnimation());
+}
+
+void RenderVk::_drawQuad(Resource::Texture texture, const glm::mat4 &prevModelMatrix,
+			 const glm::mat4 &modelMatrix, glm::vec4 colour, glm::vec4 texOffset,
+			 const Resource::SpriteAnimation &animation) {
+  if (_current2DInstanceIndex >= _max2DInstances) {
+      LOG("WARNING: ran out of 2D instances, raise RenderConfig::max_2D_instances!\n");
       return;
   }
   if(!_poolInUse(texture.pool)) {
@@ -730,23 +1173,296 @@ void RenderVk::DrawQuad(Resource::Texture texture, glm::mat4 modelMatrix, glm::v
       return;
   }
   _begin(RenderState::Draw2D);
-   perFrame2DVertData[_current2DInstanceIndex + _instance2Druns] = modelMatrix;
-   perFrame2DFragData[_current2DInstanceIndex + _instance2Druns].colour = colour;
-   perFrame2DFragData[_current2DInstanceIndex + _instance2Druns].texOffset = texOffset;
-   perFrame2DFragData[_current2DInstanceIndex + _instance2Druns].texID =
-       pools->get(texture.pool)->texLoader->getViewIndex(texture);
-   
-  _instance2Druns++;
-
-  if (_current2DInstanceIndex + _instance2Druns == Resource::MAX_2D_BATCH)
+  if(_2DModelRun) {
+      _drawBatch();
+      _2DModelRun = false;
+  }
+  if(renderConf.cull_2D && cull::quadOffscreen(_viewProj2D, modelMatrix))
+      return;
+  if(_current2DClipIndex != 0 &&
+     cull::quadOutsideRect(perFrame2DClipRects[_current2DClipIndex], modelMatrix))
+      return;
+  InternalTexLoader* texLoader = pools->get(texture.pool)->texLoader;
+  uint32_t flags = 0;
+  if(colour.a >= 1.0f && texLoader->isOpaque(texture))
+      flags |= shaderStructs::FRAG2D_OPAQUE_BIT;
+  shaderStructs::Anim2D anim;
+  anim.uvScroll = animation.uvScroll;
+  anim.grid = glm::max(animation.grid, glm::uvec2(1));
+  anim.frameCount = animation.frameCount;
+  anim.fps = animation.fps;
+  anim.startTime = animation.startTime;
+  anim.loop = animation.loop ? 1 : 0;
+  _write2DInstance(modelMatrix, prevModelMatrix, colour, texOffset,
+		   texLoader->getViewIndex(texture), flags, anim);
+}
+
+void RenderVk::DrawString(Resource::Font font, std::string_view text, glm::vec2 position, float size, float depth, glm::vec4 colour, float rotate) {
+    if(!_poolInUse(font.pool)) {
+	LOG_ERROR("Tried Drawing with font in pool that is not in use");
+	return;
+    }
+    ResourcePoolVk* pool = pools->get(font.pool);
+    const FontData* fontData = pool->fontLoader->get(font);
+    if(fontData == nullptr)
+	return;
+    _begin(RenderState::Draw2D);
+    if(_2DModelRun) {
+	_drawBatch();
+	_2DModelRun = false;
+    }
+    uint32_t texID = pool->texLoader->getViewIndex(fontData->tex);
+    uint32_t flags = fontData->sdf ? shaderStructs::FRAG2D_SDF_BIT : 0;
+    const std::vector<GlyphInstance> &glyphs = pool->fontLoader->layout(
+	    font, text, size, rotate);
+    glm::vec4 offset(position.x, position.y, depth, 0.0f);
+    for(const GlyphInstance &glyph: glyphs) {
+	if (_current2DInstanceIndex >= _max2DInstances) {
+	    LOG("WARNING: ran out of 2D instances, raise RenderConfig::max_2D_instances!\n");
+	    return;
+	}
+	glm::mat4 model = glyph.model;
+	model[3] += offset;
+	if(renderConf.cull_2D && cull::quadOffscreen(_viewProj2D, model))
+	    continue;
+	if(_current2DClipIndex != 0 &&
+	   cull::quadOutsideRect(perFrame2DClipRects[_current2DClipIndex], model))
+	    continue;
+	_write2DInstance(model, model, colour, glyph.texOffset, texID, flags);
+    }
+}
+
+Resource::ParticleEmitter RenderVk::CreateParticleEmitter(ParticleEmitterConfig config) {
+    return particles->create(config);
+}
+
+void RenderVk::setParticleEmitter(Resource::ParticleEmitter emitter,
+				  ParticleEmitterConfig config) {
+    particles->set(emitter, config);
+}
+
+void RenderVk::DestroyParticleEmitter(Resource::ParticleEmitter emitter) {
+    particles->destroy(emitter);
+}
+
+void RenderVk::UpdateParticles(Resource::ParticleEmitter emitter, float deltaTime) {
+    particles->update(emitter, deltaTime);
+}
+
+void RenderVk::DrawParticles(Resource::ParticleEmitter emitter) {
+    const ParticleEmitterConfig* config = particles->getConfig(emitter);
+    if(config == nullptr) {
+	LOG_ERROR("Tried Drawing particle emitter that does not exist");
+	return;
+    }
+    if(!_poolInUse(config->texture.pool)) {
+	LOG_ERROR("Tried Drawing particles with texture in pool that is not in use");
+	return;
+    }
+    _begin(RenderState::Draw2D);
+    // keep the particles in order with the quads drawn around them
     _drawBatch();
+    particles->recordDraw(
+	    currentCommandBuffer, swapchainFrameIndex, emitter,
+	    pools->get(config->texture.pool)->texLoader->getViewIndex(config->texture));
+    _pipeline2D.begin(currentCommandBuffer, swapchainFrameIndex);
+}
+
+/// 2D models are drawn with the quad pipeline, instances of the same model
+/// are batched into one draw per mesh, whatever their colour or override texture.
+void RenderVk::_drawModel2D(Resource::Model model, const glm::mat4 &prevModelMatrix,
+			    const glm::mat4 &modelMatrix) {
+    if(!_poolInUse(model.pool)) {
+	LOG_ERROR("Tried Drawing with model in pool that is not in use");
+	return;
+    }
+    _begin(RenderState::Draw2D);
+    if(!_2DModelRun || !_sameModelMeshes(model, _current2DModel))
+	_drawBatch();
+    _bindModelPool(model);
+    uint32_t meshCount = pools->get(model.pool)->modelLoader->getMeshCount(model);
+    if(meshCount == 0)
+	return;
+    // the run's instances are duplicated for each mesh when it is drawn
+    if(_current2DInstanceIndex + (_instance2Druns + 1) * meshCount > _max2DInstances) {
+	_drawBatch();
+	if(_current2DInstanceIndex + meshCount > _max2DInstances) {
+	    LOG("WARNING: ran out of 2D instances, raise RenderConfig::max_2D_instances!\n");
+	    return;
+	}
+    }
+    uint32_t texID = 0;
+    uint32_t flags = shaderStructs::FRAG2D_MESH_TEXTURE_BIT;
+    if(model.overrideTexture.ID != Resource::NULL_ID) {
+	if(_poolInUse(model.overrideTexture.pool)) {
+	    texID = pools->get(model.overrideTexture.pool)->texLoader->getViewIndex(
+		    model.overrideTexture);
+	    flags = 0;
+	} else
+	    LOG_ERROR("Tried Drawing with override texture in pool that is not in use");
+    }
+    _current2DModel = model;
+    _2DModelRun = true;
+    // the mesh's colour and texture are filled in by _draw2DModelRun
+    // where this instance doesn't override them
+    _write2DInstance(modelMatrix, prevModelMatrix, model.colour,
+		     glm::vec4(0, 0, 1, 1), texID, flags);
+}
+
+void RenderVk::_draw2DModelRun() {
+    ModelLoaderVk* loader = pools->get(currentModelPool)->modelLoader;
+    uint32_t meshCount = loader->getMeshCount(_current2DModel);
+    size_t start = _current2DInstanceIndex;
+    // the mesh's own material, without the run model's overrides
+    Resource::Model meshModel = _current2DModel;
+    meshModel.colour = glm::vec4(0.0f);
+    meshModel.overrideTexture = Resource::Texture(Resource::NULL_ID);
+    // fill mesh 0's instances last, as they are the source for the other meshes
+    for(uint32_t mesh = meshCount; mesh-- > 0;) {
+	glm::vec4 colour;
+	int texID;
+	loader->getMeshDrawData(meshModel, mesh, &colour, &texID);
+	size_t offset = start + mesh * _instance2Druns;
+	for(size_t i = 0; i < _instance2Druns; i++) {
+	    size_t src = start + i;
+	    size_t dst = offset + i;
+	    if(mesh != 0) {
+		perFrame2DVertData[dst] = perFrame2DVertData[src];
+		perFrame2DPrevData[dst] = perFrame2DPrevData[src];
+		perFrame2DAnimData[dst] = perFrame2DAnimData[src];
+		perFrame2DSortKey[dst] = perFrame2DSortKey[src];
+		perFrame2DFragData[dst] = perFrame2DFragData[src];
+	    }
+	    shaderStructs::Frag2DData &frag = perFrame2DFragData[dst];
+	    if(frag.colour.a == 0.0f)
+		frag.colour = colour;
+	    if((frag.flags & shaderStructs::FRAG2D_MESH_TEXTURE_BIT) == 0)
+		continue;
+	    frag.texID = texID < 0 ? 0 : (uint32_t)texID;
+	    if(texID < 0)
+		frag.flags |= shaderStructs::FRAG2D_UNTEXTURED_BIT;
+	    else
+		frag.flags &= ~shaderStructs::FRAG2D_UNTEXTURED_BIT;
+	}
+    }
+    loader->drawModel2D(currentCommandBuffer, _current2DModel, _instance2Druns,
+			_current2DInstanceIndex);
+    _current2DInstanceIndex += _instance2Druns * meshCount;
+    _instance2Druns = 0;
 }
 
-void RenderVk::DrawString(Resource::Font font, std::string text, glm::vec2 position, float size, float depth, glm::vec4 colour, float rotate) {
-    auto draws = pools->get(font.pool)->fontLoader->DrawString(
-	    font, text, position, size, depth, colour, rotate);
-    for (const auto &draw : draws) {
-	DrawQuad(draw.tex, draw.model, draw.colour, draw.texOffset);
+void RenderVk::set2DSortKey(uint32_t key) {
+    _current2DSortKey = key;
+}
+
+void RenderVk::set2DClipRect(glm::vec4 rect) {
+    if(_2DClipRectCount >= Resource::MAX_2D_CLIP_RECTS) {
+	LOG("WARNING: ran out of 2D clip rects, drawing unclipped!\n");
+	_current2DClipIndex = 0;
+	return;
+    }
+    _current2DClipIndex = _2DClipRectCount++;
+    perFrame2DClipRects[_current2DClipIndex] = rect;
+}
+
+void RenderVk::clear2DClipRect() {
+    _current2DClipIndex = 0;
+}
+
+void RenderVk::_write2DInstance(const glm::mat4 &modelMatrix,
+				const glm::mat4 &prevModelMatrix, glm::vec4 colour,
+				glm::vec4 texOffset, uint32_t texID, uint32_t flags,
+				const shaderStructs::Anim2D &anim) {
+    size_t i = _current2DInstanceIndex + _instance2Druns;
+    perFrame2DVertData[i] = modelMatrix;
+    perFrame2DPrevData[i] = prevModelMatrix;
+    perFrame2DAnimData[i] = anim;
+    perFrame2DSortKey[i] = _current2DSortKey;
+    perFrame2DFragData[i].colour = colour;
+    perFrame2DFragData[i].texOffset = texOffset;
+    perFrame2DFragData[i].texID = texID;
+    perFrame2DFragData[i].clipIndex = _current2DClipIndex;
+    // clipping discards fragments, so these can't use the opaque pipeline
+    if(_current2DClipIndex != 0)
+	flags &= ~shaderStructs::FRAG2D_OPAQUE_BIT;
+    perFrame2DFragData[i].flags = flags;
+    _instance2Druns++;
+
+    if (_current2DInstanceIndex + _instance2Druns == _max2DInstances)
+	_drawBatch();
+}
+
+/// Reorder the current 2D run before it is drawn.
+/// If sorting by opacity, opaque draws come first, front-to-back,
+/// followed by the transparent draws back-to-front.
+/// If sorting by key, the transparent draws are ordered by their sort keys instead.
+/// Returns the number of opaque draws.
+unsigned int RenderVk::_sort2DRun() {
+    size_t start = _current2DInstanceIndex;
+    size_t count = _instance2Druns;
+    _sort2DOrder.resize(count);
+    _sort2DKeys.resize(count);
+    auto opaque = [this, start](size_t i) {
+	return _pipeline2DOpaqueCreated &&
+	    (perFrame2DFragData[start + i].flags & shaderStructs::FRAG2D_OPAQUE_BIT) != 0; };
+    size_t opaqueCount = 0;
+    for(size_t i = 0; i < count; i++)
+	if(opaque(i))
+	    _sort2DOrder[opaqueCount++] = (uint32_t)i;
+    for(size_t i = 0, t = opaqueCount; i < count; i++)
+	if(!opaque(i))
+	    _sort2DOrder[t++] = (uint32_t)i;
+    for(size_t i = 0; i < count; i++) {
+	uint32_t index = _sort2DOrder[i];
+	if(i >= opaqueCount && renderConf.sort_2D_by_key) {
+	    _sort2DKeys[i] = perFrame2DSortKey[start + index];
+	    continue;
+	}
+	// quads are flat, so the translation's depth is the quad's depth
+	glm::vec4 p = _viewProj2D * perFrame2DVertData[start + index][3];
+	uint32_t depthKey = radix::floatKey(p.z / p.w);
+	_sort2DKeys[i] = i < opaqueCount ? depthKey : ~depthKey;
+    }
+    // the sort is stable, so draws with the same key keep their submission order
+    radix::sort(_sort2DKeys.data(), _sort2DOrder.data(), opaqueCount,
+		_sort2DTmpKeys, _sort2DTmpOrder);
+    radix::sort(_sort2DKeys.data() + opaqueCount, _sort2DOrder.data() + opaqueCount,
+		count - opaqueCount, _sort2DTmpKeys, _sort2DTmpOrder);
+
+    _sort2DVert.assign(perFrame2DVertData.begin() + start,
+	               perFrame2DVertData.begin() + start + count);
+    _sort2DPrev.assign(perFrame2DPrevData.begin() + start,
+	               perFrame2DPrevData.begin() + start + count);
+    _sort2DAnim.assign(perFrame2DAnimData.begin() + start,
+	               perFrame2DAnimData.begin() + start + count);
+    _sort2DFrag.assign(perFrame2DFragData.begin() + start,
+	               perFrame2DFragData.begin() + start + count);
+    for(size_t i = 0; i < count; i++) {
+	perFrame2DVertData[start + i] = _sort2DVert[_sort2DOrder[i]];
+	perFrame2DPrevData[start + i] = _sort2DPrev[_sort2DOrder[i]];
+	perFrame2DAnimData[start + i] = _sort2DAnim[_sort2DOrder[i]];
+	perFrame2DFragData[start + i] = _sort2DFrag[_sort2DOrder[i]];
+    }
+    return (unsigned int)opaqueCount;
+}
+
+/// colour and texture overrides are per instance, so they don't split batches
+bool RenderVk::_sameModelMeshes(Resource::Model a, Resource::Model b) {
+    return a.ID == b.ID && a.type == b.type && a.pool == b.pool;
+}
+
+void RenderVk::_write3DOverrides(const Resource::Model &model,
+				 shaderStructs::PerFrame3D &instance) {
+    instance.colour = model.colour;
+    instance.texID = -1;
+    if(model.overrideTexture.ID != Resource::NULL_ID) {
+	if(_poolInUse(model.overrideTexture.pool)) {
+	    TexLoaderVk* texLoader = pools->get(model.overrideTexture.pool)->texLoader;
+	    instance.texID = (int32_t)texLoader->getViewIndex(model.overrideTexture);
+	    if(!texLoader->isOpaque(model.overrideTexture))
+		_batchAlphaTest = true;
+	} else
+	    LOG_ERROR("Tried Drawing with override texture in pool that is not in use");
     }
 }
 
@@ -766,28 +1482,72 @@ void RenderVk::_drawBatch() {
     switch(_renderState) {
     case RenderState::DrawAnim3D:
     case RenderState::Draw3D:
-	if(_current3DInstanceIndex + _modelRuns > Resource::MAX_3D_BATCH) {
-	    if(_current3DInstanceIndex < Resource::MAX_3D_BATCH)
-		_modelRuns = (Resource::MAX_3D_BATCH - _current3DInstanceIndex);
+	if(_current3DInstanceIndex + _modelRuns > _max3DInstances) {
+	    if(_current3DInstanceIndex < _max3DInstances)
+		_modelRuns = (_max3DInstances - _current3DInstanceIndex);
 	    else
 		_modelRuns = 0;
 	    LOG("WARNING: Ran Out of 3D Instance Models");
 	}
 	if(_modelRuns == 0)
 	    return;
-	pools->get(currentModelPool)->modelLoader->drawModel(
-		currentCommandBuffer,
-		_pipeline3D.getLayout(),
-		_currentModel,
-		_modelRuns,
-		_current3DInstanceIndex);
+	if(_renderState == RenderState::Draw3D) {
+	    ModelLoaderVk* loader = pools->get(currentModelPool)->modelLoader;
+	    uint32_t meshCount = loader->getMeshCount(_currentModel);
+	    if(meshCount > 0 && culler->hasSpace(meshCount, _modelRuns)) {
+		// a model's jobs are consecutive, so its commands are drawn together
+		VkDeviceSize firstOffset = 0;
+		for(uint32_t i = 0; i < meshCount; i++) {
+		    shaderStructs::CullDrawCommand command;
+		    glm::vec4 bounds;
+		    loader->getMeshCullInfo(_currentModel, i, _currentLOD, &command, &bounds);
+		    VkDeviceSize offset = culler->addJob(
+			    _current3DInstanceIndex, _modelRuns, command, bounds);
+		    if(i == 0)
+			firstOffset = offset;
+		}
+		loader->drawModelIndirect(
+			currentCommandBuffer, _pipeline3D.getLayout(), _currentModel,
+			culler->getCommandBuffer(), firstOffset, culler->getCommandStride());
+		if(_pipeline3DDepthCreated)
+		    _depthPrepassDraws.push_back(
+			    {_currentModel, _modelRuns, _current3DInstanceIndex, _currentLOD,
+			     true, culler->getCommandBuffer(), firstOffset,
+			     culler->getCommandStride(),
+			     _batchAlphaTest || !loader->isOpaque(_currentModel)});
+		_current3DInstanceIndex += _modelRuns;
+		_modelRuns = 0;
+		_batchAlphaTest = false;
+		break;
+	    }
+	}
+	{
+	    ModelLoaderVk* loader = pools->get(currentModelPool)->modelLoader;
+	    VkDeviceSize commandOffset = 0;
+	    bool indirect = loader->drawModel(
+		    currentCommandBuffer,
+		    _renderState == RenderState::DrawAnim3D ?
+		    _pipelineAnim3D.getLayout() : _pipeline3D.getLayout(),
+		    _currentModel,
+		    _modelRuns,
+		    _current3DInstanceIndex,
+		    _currentLOD,
+		    &commandOffset);
+	    if(_renderState == RenderState::Draw3D && _pipeline3DDepthCreated)
+		_depthPrepassDraws.push_back(
+			{_currentModel, _modelRuns, _current3DInstanceIndex, _currentLOD,
+			 indirect, loader->getCommandBuffer(), commandOffset,
+			 (uint32_t)sizeof(VkDrawIndexedIndirectCommand),
+			 _batchAlphaTest || !loader->isOpaque(_currentModel)});
+	}
 	_current3DInstanceIndex += _modelRuns;
 	_modelRuns = 0;
+	_batchAlphaTest = false;
 	break;
     case RenderState::Draw2D:
-	if(_current2DInstanceIndex + _instance2Druns > Resource::MAX_2D_BATCH) {
-	    if(_current2DInstanceIndex < Resource::MAX_2D_BATCH)
-		_instance2Druns = Resource::MAX_2D_BATCH - _current2DInstanceIndex;
+	if(_current2DInstanceIndex + _instance2Druns > _max2DInstances) {
+	    if(_current2DInstanceIndex < _max2DInstances)
+		_instance2Druns = _max2DInstances - _current2DInstanceIndex;
 	    else
 		_instance2Druns = 0;
 	    LOG("WARNING: Ran Out of 2D Instance Models");
@@ -798,6 +1558,28 @@ void RenderVk::_drawBatch() {
 	    pools->get(0)->modelLoader->bindBuffers(currentCommandBuffer);
 	    currentModelPool = pools->get(0)->id();
 	}
+	if(_2DModelRun) {
+	    _draw2DModelRun();
+	    break;
+	}
+	if(_pipeline2DOpaqueCreated || renderConf.sort_2D_by_key) {
+	    unsigned int opaqueCount = _sort2DRun();
+	    if(opaqueCount > 0) {
+		_pipeline2DOpaque.begin(currentCommandBuffer, swapchainFrameIndex);
+		pools->get(currentModelPool)->modelLoader->drawQuad(
+			currentCommandBuffer,
+			_pipeline2DOpaque.getLayout(),
+			0, opaqueCount,
+			_current2DInstanceIndex,
+			_currentColour,
+			_currentTexOffset);
+		_pipeline2D.begin(currentCommandBuffer, swapchainFrameIndex);
+		_current2DInstanceIndex += opaqueCount;
+		_instance2Druns -= opaqueCount;
+		if(_instance2Druns == 0)
+		    return;
+	    }
+	}
 	pools->get(currentModelPool)->modelLoader->drawQuad(
 		currentCommandBuffer,
 		_pipeline2D.getLayout(),
@@ -811,14 +1593,76 @@ void RenderVk::_drawBatch() {
     }
 }
 
+void RenderVk::_recordDepthPrepass(VkCommandBuffer cmdBuff) {
+    VkQueryPool queries = frames[frameIndex]->timestamps;
+    if(timestampPeriod > 0.0f) {
+	vkCmdResetQueryPool(cmdBuff, queries, TIMESTAMP_PREPASS_START, 2);
+	vkCmdWriteTimestamp(cmdBuff, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			    queries, TIMESTAMP_PREPASS_START);
+    }
+    // the pass clears the depth even without draws, as the colour pass loads it
+    offscreenRenderPass->beginDepthPrepass(cmdBuff, swapchainFrameIndex);
+    ModelLoaderVk* loader = nullptr;
+    Pipeline* pipeline = nullptr;
+    for(const DepthPrepassDraw &draw: _depthPrepassDraws) {
+	Pipeline* drawPipeline = draw.alphaTest ? &_pipeline3DDepthAlpha : &_pipeline3DDepth;
+	if(drawPipeline != pipeline) {
+	    drawPipeline->begin(cmdBuff, swapchainFrameIndex);
+	    pipeline = drawPipeline;
+	}
+	ModelLoaderVk* drawLoader = pools->get(draw.model.pool)->modelLoader;
+	// the loaders track which buffers they bound, which was in another command buffer
+	if(drawLoader != loader) {
+	    drawLoader->bindBuffers(cmdBuff);
+	    loader = drawLoader;
+	}
+	if(draw.indirect)
+	    loader->drawModelIndirect(
+		    cmdBuff, pipeline->getLayout(), draw.model,
+		    draw.commandBuffer, draw.commandOffset, draw.commandStride);
+	else // the colour pass used direct draws, so this does too
+	    loader->drawModel(cmdBuff, pipeline->getLayout(), draw.model,
+			      draw.count, draw.instanceOffset, draw.lod);
+    }
+    vkCmdEndRenderPass(cmdBuff);
+    _depthPrepassDraws.clear();
+    if(timestampPeriod > 0.0f) {
+	vkCmdWriteTimestamp(cmdBuff, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			    queries, TIMESTAMP_PREPASS_END);
+	frames[frameIndex]->prepassTimed = true;
+    }
+}
+
+/// milliseconds between a pair of timestamps, ms is unchanged if they can't be read
+void readTimestampPair(VkDevice device, VkQueryPool queries, uint32_t first,
+		       float timestampPeriod, float *ms) {
+    uint64_t ticks[2];
+    if(vkGetQueryPoolResults(device, queries, first, 2, sizeof(ticks), ticks,
+			     sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+	*ms = (float)(ticks[1] - ticks[0]) * timestampPeriod / 1000000.0f;
+}
+
+void RenderVk::_readTimings(Frame* frame) {
+    // the frame's fence has been waited on, so its queries are available
+    gpuTimings.depthPrepass3D = 0.0f;
+    if(frame->prepassTimed)
+	readTimestampPair(manager->deviceState.device, frame->timestamps,
+			  TIMESTAMP_PREPASS_START, timestampPeriod, &gpuTimings.depthPrepass3D);
+    if(frame->colourPassTimed)
+	readTimestampPair(manager->deviceState.device, frame->timestamps,
+			  TIMESTAMP_COLOUR_START, timestampPeriod, &gpuTimings.colourPass);
+}
 
   VkSubmitInfo submitDrawInfo(Frame *frame, VkPipelineStageFlags *stageFlags) {
       VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
       submitInfo.waitSemaphoreCount = 1;
       submitInfo.pWaitSemaphores = &frame->swapchainImageReady;
       submitInfo.pWaitDstStageMask = stageFlags;
-      submitInfo.commandBufferCount = 1;
-      submitInfo.pCommandBuffers = &frame->commandBuffer;
+      submitInfo.commandBufferCount = 0;
+      if(frame->usePreCommands)
+	  frame->submitBuffers[submitInfo.commandBufferCount++] = frame->preCommandBuffer;
+      frame->submitBuffers[submitInfo.commandBufferCount++] = frame->commandBuffer;
+      submitInfo.pCommandBuffers = frame->submitBuffers;
       submitInfo.signalSemaphoreCount = 1;
       submitInfo.pSignalSemaphores = &frame->drawFinished;
       return submitInfo;
@@ -841,23 +1685,68 @@ void RenderVk::EndDraw(std::atomic<bool> &submit) {
 
   _begunDraw = false;
   _drawBatch();
+  _2DModelRun = false;
 
-  for (size_t i = 0; i < _current3DInstanceIndex; i++)
+  // instances from instance buffers are copied on the gpu
+  for (uint32_t i = instanceBuffers->skipCopied(0); i < _current3DInstanceIndex;
+       i = instanceBuffers->skipCopied(i + 1)) {
       perFrame3D->bindings[0].storeSetData(
 	      swapchainFrameIndex, &perFrame3DData[i], 0, i, 0);
+      // the shaders only read previous transforms when interpolating
+      if(renderConf.interpolate_transforms)
+	  perFrame3D->bindings[1].storeSetData(
+		  swapchainFrameIndex, &perFrame3DPrevData[i], 0, i, 0);
+  }
   
   _current3DInstanceIndex = 0;
 
+  if(culler->hasJobs() || instanceBuffers->hasCopies() || _pipeline3DDepthCreated) {
+      VkCommandBuffer preCmdBuff;
+      checkResultAndThrow(frames[frameIndex]->startPreCommands(&preCmdBuff),
+			  "Render Error: Failed to start pre command buffer.");
+      instanceBuffers->recordCopies(
+	      preCmdBuff, _shaderBuffer, swapchainFrameIndex, &perFrame3D->bindings[0],
+	      renderConf.interpolate_transforms ? &perFrame3D->bindings[1] : nullptr);
+      culler->recordCulling(preCmdBuff, VP3DData.proj * VP3DData.view);
+      if(_pipeline3DDepthCreated)
+	  _recordDepthPrepass(preCmdBuff);
+      // tested against by the next frame's culling
+      culler->recordDepthPyramid(preCmdBuff, swapchainFrameIndex,
+				 VP3DData.proj * VP3DData.view);
+      checkResultAndThrow(vkEndCommandBuffer(preCmdBuff),
+			  "Render Error: Failed to end pre command buffer.");
+  }
+
   for (size_t i = 0; i < _current2DInstanceIndex; i++) {
       perFrame2DVert->bindings[0].storeSetData(
 	      swapchainFrameIndex, &perFrame2DVertData[i], 0, i, 0);
+      perFrame2DVert->bindings[1].storeSetData(
+	      swapchainFrameIndex, &perFrame2DAnimData[i], 0, i, 0);
+      if(renderConf.interpolate_transforms)
+	  perFrame2DVert->bindings[2].storeSetData(
+		  swapchainFrameIndex, &perFrame2DPrevData[i], 0, i, 0);
       perFrame2DFrag->bindings[0].storeSetData(
 	      swapchainFrameIndex, &perFrame2DFragData[i], 0, i, 0);	  
   }
+  for (size_t i = 1; i < _2DClipRectCount; i++)
+      perFrame2DFrag->bindings[1].storeSetData(
+	      swapchainFrameIndex, &perFrame2DClipRects[i], 0, i, 0);
   
   _current2DInstanceIndex = 0;
+  _current2DSortKey = 0;
+
+  // drawn last so the lines are on top of the scene
+  debugDraw->recordDraw(currentCommandBuffer, swapchainFrameIndex,
+			VP2DData.proj * VP2DData.view, VP3DData.proj * VP3DData.view);
+  _current2DClipIndex = 0;
+  _2DClipRectCount = 1;
 
   vkCmdEndRenderPass(currentCommandBuffer);
+  if(timestampPeriod > 0.0f) {
+      vkCmdWriteTimestamp(currentCommandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			  frames[frameIndex]->timestamps, TIMESTAMP_COLOUR_END);
+      frames[frameIndex]->colourPassTimed = true;
+  }
 
   // DO FINAL RENDER PASS
 
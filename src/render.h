@@ -20,6 +20,10 @@
 #include "shader.h"
 #include "shader_internal.h"
 #include "shader_structs.h"
+#include "particles.h"
+#include "debug_draw.h"
+#include "instance_culler.h"
+#include "instance_buffers.h"
 #include <atomic>
 #include <vector>
 
@@ -49,13 +53,37 @@ const size_t MAX_ANIMATIONS_PER_FRAME = 10;
       void UseLoadedResources() override;
 
       // warning: switching between models that are in different pools often is slow
-      void DrawModel(Resource::Model model, glm::mat4 modelMatrix, glm::mat4 normalMatrix) override;
-      void DrawAnimModel(Resource::Model model, glm::mat4 modelMatrix, glm::mat4 normalMatrix,
+      void DrawModel(Resource::Model model, glm::mat4 modelMatrix) override;
+      void DrawModel(Resource::Model model, glm::mat4 previousModelMatrix,
+		     glm::mat4 modelMatrix, glm::mat4 normalMatrix) override;
+      void DrawAnimModel(Resource::Model model, glm::mat4 modelMatrix,
 			 Resource::ModelAnimation *animation) override;
+      void DrawModelInstanced(Resource::Model model,
+			      const Resource::InstanceTransform* instances,
+			      size_t count) override;
+      Resource::InstanceBuffer CreateInstanceBuffer(
+	      const Resource::InstanceTransform* instances, size_t count) override;
+      void DestroyInstanceBuffer(Resource::InstanceBuffer buffer) override;
+      void DrawModelInstanced(Resource::Model model,
+			      Resource::InstanceBuffer instances) override;
       void DrawQuad(Resource::Texture texture, glm::mat4 modelMatrix, glm::vec4 colour,
 		    glm::vec4 texOffset) override;
-      void DrawString(Resource::Font font, std::string text, glm::vec2 position, float size,
+      void DrawQuad(Resource::Texture texture, glm::mat4 modelMatrix, glm::vec4 colour,
+		    glm::vec4 texOffset, Resource::SpriteAnimation animation) override;
+      void DrawQuad(Resource::Texture texture, glm::mat4 previousModelMatrix,
+		    glm::mat4 modelMatrix, glm::vec4 colour, glm::vec4 texOffset) override;
+      void DrawString(Resource::Font font, std::string_view text, glm::vec2 position, float size,
 		      float depth, glm::vec4 colour, float rotate) override;
+      Resource::ParticleEmitter CreateParticleEmitter(ParticleEmitterConfig config) override;
+      void setParticleEmitter(Resource::ParticleEmitter emitter,
+			      ParticleEmitterConfig config) override;
+      void DestroyParticleEmitter(Resource::ParticleEmitter emitter) override;
+      void UpdateParticles(Resource::ParticleEmitter emitter, float deltaTime) override;
+      void DrawParticles(Resource::ParticleEmitter emitter) override;
+      DebugDraw* debug() override { return debugDraw; }
+      void set2DSortKey(uint32_t key) override;
+      void set2DClipRect(glm::vec4 rect) override;
+      void clear2DClipRect() override;
       void EndDraw(std::atomic<bool> &submit) override;
 
       void FramebufferResize() override;
@@ -68,8 +96,12 @@ const size_t MAX_ANIMATIONS_PER_FRAME = 10;
       void setRenderConf(RenderConfig renderConf) override;
       RenderConfig getRenderConf() override;
       glm::vec2 offscreenSize() override;
+      GPUTimings getGPUTimings() override { return gpuTimings; }
 
-      void setTime(float time) {
+      void setInterpolation(float alpha) override {
+	  _interpolation = alpha;
+      }
+      void setTime(float time) override {
 	  timeData.time = time;
       }
     
@@ -85,10 +117,34 @@ const size_t MAX_ANIMATIONS_PER_FRAME = 10;
       void _startDraw();
       void _begin(RenderState state);
       void _store3DsetData();
+      /// true if cull_3D is on and the model's bounds are outside the 3D frustum
+      bool _modelOffscreen(Resource::Model model, const glm::mat4 &modelMatrix);
+      /// the level of detail to draw the model with, from its size on screen,
+      /// sphere replaces the model's bounding sphere if given
+      uint32_t _selectLOD(Resource::Model model, const glm::mat4 &modelMatrix,
+			  const glm::vec4 *sphere = nullptr);
       void _store2DsetData();
       void _resize();
       void _drawBatch();
+      /// replays the frame's 3D batches into the offscreen depth
+      void _recordDepthPrepass(VkCommandBuffer cmdBuff);
+      /// from the frame's timestamps, if the gpu has finished it
+      void _readTimings(Frame* frame);
+      void _drawQuad(Resource::Texture texture, const glm::mat4 &prevModelMatrix,
+		     const glm::mat4 &modelMatrix, glm::vec4 colour, glm::vec4 texOffset,
+		     const Resource::SpriteAnimation &animation);
+      void _write2DInstance(const glm::mat4 &modelMatrix,
+			    const glm::mat4 &prevModelMatrix, glm::vec4 colour,
+			    glm::vec4 texOffset, uint32_t texID, uint32_t flags,
+			    const shaderStructs::Anim2D &anim = shaderStructs::Anim2D());
+      unsigned int _sort2DRun();
+      void _drawModel2D(Resource::Model model, const glm::mat4 &prevModelMatrix,
+			const glm::mat4 &modelMatrix);
+      void _draw2DModelRun();
       void _bindModelPool(Resource::Model model);
+      bool _sameModelMeshes(Resource::Model a, Resource::Model b);
+      void _write3DOverrides(const Resource::Model &model,
+			     shaderStructs::PerFrame3D &instance);
       bool _validPool(Resource::Pool pool);
       bool _poolInUse(Resource::Pool pool);
       void _throwIfPoolInvaid(Resource::Pool pool);
@@ -107,8 +163,12 @@ const size_t MAX_ANIMATIONS_PER_FRAME = 10;
       Frame** frames;
 
       VkFormat offscreenDepthFormat;
+      bool offscreenDepthSampled = false;
       VkFormat prevSwapchainFormat = VK_FORMAT_UNDEFINED;
       VkSampleCountFlagBits prevSampleCount = VK_SAMPLE_COUNT_1_BIT;
+      // the offscreen depth is kept for the depth pyramid
+      bool prevOcclusionCull = false;
+      bool prevDepthPrepass = false;
       Swapchain *swapchain = nullptr;
       uint32_t swapchainFrameIndex = 0;
       uint32_t swapchainFrameCount = 0;
@@ -121,8 +181,25 @@ const size_t MAX_ANIMATIONS_PER_FRAME = 10;
       Pipeline _pipeline3D;
       Pipeline _pipelineAnim3D;
       Pipeline _pipeline2D;
+      // blending off, only created if sort_2D_by_opacity is set
+      Pipeline _pipeline2DOpaque;
+      bool _pipeline2DOpaqueCreated = false;
+      // position only, only created if the offscreen pass has a depth pre-pass
+      Pipeline _pipeline3DDepth;
+      // discards the same transparent texels as the colour pass, for non opaque models
+      Pipeline _pipeline3DDepthAlpha;
+      bool _pipeline3DDepthCreated = false;
       Pipeline _pipelineFinal;
 
+      ParticleSystem* particles = nullptr;
+      DebugDrawVk* debugDraw = nullptr;
+      InstanceCuller* culler = nullptr;
+      InstanceBuffers* instanceBuffers = nullptr;
+
+      // nanoseconds per timestamp tick, 0 if timestamps aren't supported
+      float timestampPeriod = 0.0f;
+      GPUTimings gpuTimings;
+
       // descriptor set members
       VkDeviceMemory _shaderMemory;
       VkBuffer _shaderBuffer;
@@ -130,24 +207,44 @@ const size_t MAX_ANIMATIONS_PER_FRAME = 10;
       VkDescriptorPool _descPool;
 
       shaderStructs::timeUbo timeData;
+      float _interpolation = 1.0f;
       DescSet *VP3D;
       shaderStructs::viewProjection VP3DData;
       DescSet *VP2D;
       shaderStructs::viewProjection VP2DData;
+      glm::mat4 _viewProj2D;
+      glm::vec4 _frustum3D[6];
+      // the view and projection the frame's 3D draws were stored with
+      glm::mat4 _view3D;
+      glm::mat4 _proj3D;
       DescSet *perFrame3D;
-      shaderStructs::PerFrame3D perFrame3DData[Resource::MAX_3D_BATCH];
+      // sized by RenderConfig::max_3D_instances
+      uint32_t _max3DInstances = 0;
+      std::vector<shaderStructs::PerFrame3D> perFrame3DData;
+      std::vector<glm::mat3x4> perFrame3DPrevData;
       DescSet *bones;
       size_t currentBonesDynamicOffset;
+      // only created when gpu culling 3D instances
+      DescSet *cull3D = nullptr;
       DescSet *perFrame2DVert;
-      glm::mat4 perFrame2DVertData[Resource::MAX_2D_BATCH];
+      // sized by RenderConfig::max_2D_instances
+      uint32_t _max2DInstances = 0;
+      std::vector<glm::mat4> perFrame2DVertData;
+      std::vector<shaderStructs::Anim2D> perFrame2DAnimData;
+      std::vector<glm::mat4> perFrame2DPrevData;
+      std::vector<uint32_t> perFrame2DSortKey;
       DescSet *perFrame2DFrag;
-      shaderStructs::Frag2DData perFrame2DFragData[Resource::MAX_2D_BATCH];
+      std::vector<shaderStructs::Frag2DData> perFrame2DFragData;
+      // index 0 is unused, it means no clipping
+      glm::vec4 perFrame2DClipRects[Resource::MAX_2D_CLIP_RECTS];
       DescSet *lighting;
       BPLighting lightingData;
       DescSet *offscreenTransform;
       glm::mat4 offscreenTransformData;
       DescSet *textures;
       DescSet *emptyDS;
+      // layout only, each pool binds its own material table
+      DS::DescriptorSet materialSet;
       DescSet *offscreenTex;
       bool offscreenSamplerCreated = false;
       VkSampler _offscreenTextureSampler;
@@ -168,12 +265,44 @@ const size_t MAX_ANIMATIONS_PER_FRAME = 10;
       unsigned int _modelRuns = 0;
       unsigned int _current3DInstanceIndex = 0;
       Resource::Model _currentModel;
+      uint32_t _currentLOD = 0;
+      // the frame's 3D batches, drawn again by the depth pre-pass
+      struct DepthPrepassDraw {
+	  Resource::Model model;
+	  uint32_t count;
+	  uint32_t instanceOffset;
+	  uint32_t lod;
+	  // the colour pass' indirect commands are drawn again, from the culler or the loader
+	  bool indirect;
+	  VkBuffer commandBuffer;
+	  VkDeviceSize commandOffset;
+	  uint32_t commandStride;
+	  bool alphaTest;
+      };
+      // an instance of the current batch has a non opaque override texture
+      bool _batchAlphaTest = false;
+      std::vector<DepthPrepassDraw> _depthPrepassDraws;
       Resource::Texture _currentTexture;
       glm::vec4 _currentTexOffset = glm::vec4(0, 0, 1, 1);
       glm::vec4 _currentColour = glm::vec4(1, 1, 1, 1);
 
       unsigned int _instance2Druns = 0;
+      // the current 2D run is instances of _current2DModel rather than quads
+      bool _2DModelRun = false;
+      Resource::Model _current2DModel;
       unsigned int _current2DInstanceIndex = 0;
+      uint32_t _current2DSortKey = 0;
+      uint32_t _current2DClipIndex = 0;
+      uint32_t _2DClipRectCount = 1;
+      // scratch space for sorting 2D batches
+      std::vector<uint32_t> _sort2DOrder;
+      std::vector<uint32_t> _sort2DKeys;
+      std::vector<uint32_t> _sort2DTmpKeys;
+      std::vector<uint32_t> _sort2DTmpOrder;
+      std::vector<glm::mat4> _sort2DVert;
+      std::vector<glm::mat4> _sort2DPrev;
+      std::vector<shaderStructs::Anim2D> _sort2DAnim;
+      std::vector<shaderStructs::Frag2DData> _sort2DFrag;
 
       Resource::Pool currentModelPool;
   };
@@ -64,7 +64,7 @@ VkAttachmentDescription AttachmentDesc::getAttachmentDescription() {
     desc.storeOp = storeOp;
     desc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     desc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    desc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    desc.initialLayout = initialImageLayout;
     desc.finalLayout = finalImageLayout;
     return desc;
 }
@@ -73,6 +73,11 @@ AttachmentType AttachmentDesc::getType() { return this->type; }
 
 AttachmentUse AttachmentDesc::getUse() { return this->use; }
 
+void AttachmentDesc::loadPrevious(VkImageLayout previousLayout) {
+    loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+    initialImageLayout = previousLayout;
+}
+
 void AttachmentDesc::getImageProps(VkFormat *imageFormat,
 				   VkImageUsageFlags *imageUsage,
 				   VkImageAspectFlags *imageAspect,
@@ -207,6 +212,8 @@ bool AttachmentImage::isUsingExternalImage() { return this->usingExternalImage;
 Framebuffer::~Framebuffer() {
     if(framebufferCreated)
 	vkDestroyFramebuffer(device, framebuffer, VK_NULL_HANDLE);
+    if(depthPrepassCreated)
+	vkDestroyFramebuffer(device, depthPrepass, VK_NULL_HANDLE);
     for(auto &a: attachments)
 	a.Destroy(device);
 }
@@ -215,13 +222,17 @@ Framebuffer::~Framebuffer() {
 enum class SubpassDependancyType {
   PreviousImageOps,
   FutureShaderRead,
+  FutureDepthLoad,
 };
 
 VkSubpassDependency genSubpassDependancy(bool colour, bool depth,
                                          SubpassDependancyType depType);
 
+VkRenderPass createDepthPrepass(VkDevice device, VkAttachmentDescription depth,
+			       bool shaderRead);
+
 RenderPass::RenderPass(VkDevice device, std::vector<AttachmentDesc> attachments,
-	       float clearColour[3]) {
+		       float clearColour[3], bool depthPrepass) {
     this->attachmentDescription.resize(attachments.size());
     this->device = device;
 
@@ -267,6 +278,20 @@ RenderPass::RenderPass(VkDevice device, std::vector<AttachmentDesc> attachments,
 	}
     }
 
+    if(depthPrepass) {
+	if(!hasDepth)
+	    throw std::runtime_error("Render Pass Creation Error: a depth pre-pass needs "
+				     "a depth attachment");
+	depthIndex = depthRef.attachment;
+	// a sampled depth attachment is read between the passes
+	bool shaderRead = attachmentDescription[depthIndex].getUse() == AttachmentUse::ShaderRead;
+	this->depthPrepass = createDepthPrepass(device, attachDescVK[depthIndex], shaderRead);
+	attachmentDescription[depthIndex].loadPrevious(
+		shaderRead ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL :
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+	attachDescVK[depthIndex] = attachmentDescription[depthIndex].getAttachmentDescription();
+    }
+
     VkSubpassDescription subpass{};
     subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
     subpass.colorAttachmentCount = (uint32_t)colourRefs.size();
@@ -296,9 +321,53 @@ RenderPass::RenderPass(VkDevice device, std::vector<AttachmentDesc> attachments,
     checkResultAndThrow(res, "Failed to created render pass!");
 }
 
+/// clears and stores only the depth attachment, leaving it to be loaded by the main pass.
+/// If shaderRead, it is left to be sampled before the main pass.
+VkRenderPass createDepthPrepass(VkDevice device, VkAttachmentDescription depth,
+			       bool shaderRead) {
+    depth.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depth.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    depth.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depth.finalLayout = shaderRead ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL :
+	VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    VkAttachmentReference depthRef;
+    depthRef.attachment = 0;
+    depthRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    VkSubpassDescription subpass{};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.pDepthStencilAttachment = &depthRef;
+
+    std::vector<VkSubpassDependency> dependancies = {
+	genSubpassDependancy(false, true, SubpassDependancyType::PreviousImageOps),
+	genSubpassDependancy(false, true, SubpassDependancyType::FutureDepthLoad),
+    };
+    if(shaderRead) {
+	VkSubpassDependency read = genSubpassDependancy(
+		false, true, SubpassDependancyType::FutureShaderRead);
+	// the depth is stored at the late tests
+	read.srcStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependancies.push_back(read);
+    }
+
+    VkRenderPassCreateInfo createInfo{VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
+    createInfo.attachmentCount = 1;
+    createInfo.pAttachments = &depth;
+    createInfo.subpassCount = 1;
+    createInfo.pSubpasses = &subpass;
+    createInfo.dependencyCount = (uint32_t)dependancies.size();
+    createInfo.pDependencies = dependancies.data();
+    VkRenderPass renderpass;
+    checkResultAndThrow(vkCreateRenderPass(device, &createInfo, VK_NULL_HANDLE, &renderpass),
+			"Failed to create depth pre-pass!");
+    return renderpass;
+}
+
 RenderPass::~RenderPass() {
     framebuffers.clear();
     vkDestroyRenderPass(device, this->renderpass, VK_NULL_HANDLE);
+    if(depthPrepass != VK_NULL_HANDLE)
+	vkDestroyRenderPass(device, depthPrepass, VK_NULL_HANDLE);
 }
 
 VkResult RenderPass::createFramebufferImages(std::vector<VkImage> *swapchainImages,
@@ -351,6 +420,16 @@ VkResult RenderPass::createFramebuffers(VkDeviceMemory framebufferImageMemory) {
 					      VK_NULL_HANDLE, &fb.framebuffer),
 			  "RenderPass Error: Failed to create Framebuffer");
 	fb.framebufferCreated = true;
+	if(depthPrepass == VK_NULL_HANDLE)
+	    continue;
+	VkFramebufferCreateInfo prepassInfo = fbCreateInfo;
+	prepassInfo.renderPass = depthPrepass;
+	prepassInfo.attachmentCount = 1;
+	prepassInfo.pAttachments = &attachViews[depthIndex];
+	msgAndReturnOnErr(vkCreateFramebuffer(device, &prepassInfo,
+					      VK_NULL_HANDLE, &fb.depthPrepass),
+			  "RenderPass Error: Failed to create depth pre-pass Framebuffer");
+	fb.depthPrepassCreated = true;
     }
 
     return result;
@@ -398,8 +477,33 @@ std::vector<VkImageView> RenderPass::getAttachmentViews(uint32_t attachmentIndex
 
 VkExtent2D RenderPass::getExtent() { return this->framebufferExtent; }
 
+void RenderPass::beginDepthPrepass(VkCommandBuffer cmdBuff, uint32_t frameIndex) {
+    if(depthPrepass == VK_NULL_HANDLE)
+	throw std::runtime_error("RenderPass Error: Tried to start depth pre-pass, "
+				 "but the render pass was made without one.");
+    if(frameIndex > framebuffers.size())
+	throw std::runtime_error("RenderPass Error: Tried to start depth pre-pass, "
+				 "but the frame index was out of range.");
+    VkClearValue clear;
+    clear.depthStencil = {1.0f, 0};
+    VkRenderPassBeginInfo beginInfo{VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+    beginInfo.renderPass = depthPrepass;
+    beginInfo.framebuffer = framebuffers[frameIndex].depthPrepass;
+    beginInfo.renderArea.offset = offset;
+    beginInfo.renderArea.extent = framebufferExtent;
+    beginInfo.clearValueCount = 1;
+    beginInfo.pClearValues = &clear;
+    vkCmdBeginRenderPass(cmdBuff, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    VkViewport viewport = fbViewport(framebufferExtent);
+    vkCmdSetViewport(cmdBuff, 0, 1, &viewport);
+    VkRect2D scissor = fbScissor(framebufferExtent);
+    vkCmdSetScissor(cmdBuff, 0, 1, &scissor);
+}
+
 VkRenderPass RenderPass::getRenderPass() { return this->renderpass; }
 
+VkRenderPass RenderPass::getDepthPrepass() { return this->depthPrepass; }
+
 
 
 VkViewport fbViewport(VkExtent2D extent) {
@@ -457,9 +561,21 @@ VkSubpassDependency genSubpassDependancy(bool colour, bool depth, SubpassDependa
 	dep.dstSubpass = VK_SUBPASS_EXTERNAL;
 	setStageMask(&dep.srcStageMask, colour, depth);
 	setAccessMask(&dep.srcAccessMask, colour, depth);
-	dep.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	dep.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+	    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 	dep.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 	break;
+    case SubpassDependancyType::FutureDepthLoad:
+	// the depth is stored at the late tests, and loaded by the next pass' early tests
+	dep.srcSubpass = 0;
+	dep.dstSubpass = VK_SUBPASS_EXTERNAL;
+	dep.srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dep.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dep.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+	    VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dep.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+	    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	break;
     }
     return dep;
 }
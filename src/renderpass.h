@@ -28,6 +28,9 @@ class AttachmentDesc {
     AttachmentType getType();
     AttachmentUse getUse();
     uint32_t getIndex() { return index; }
+    /// keep the attachment's contents from an earlier pass, instead of clearing them,
+    /// previousLayout is the layout the earlier pass left it in
+    void loadPrevious(VkImageLayout previousLayout);
     bool wasCreated() { return created; }
     void getImageProps(VkFormat *imageFormat,
 		       VkImageUsageFlags *imageUsage,
@@ -43,6 +46,7 @@ private:
     VkFormat format;
     VkSampleCountFlagBits samples;
     VkImageLayout imageLayout;
+    VkImageLayout initialImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     VkImageLayout finalImageLayout;
     VkAttachmentLoadOp loadOp;
     VkAttachmentStoreOp storeOp;
@@ -57,13 +61,18 @@ struct Framebuffer {
     VkDevice device;
     bool framebufferCreated = false;
     VkFramebuffer framebuffer;
+    bool depthPrepassCreated = false;
+    VkFramebuffer depthPrepass;
     std::vector<AttachmentImage> attachments;
 };
 
 class RenderPass {
  public:
+    /// depthPrepass also makes a pass that only clears and writes the depth attachment,
+    /// to be recorded before this one, which then loads the depth instead of clearing it.
+    /// A ShaderRead depth attachment can be sampled between the two passes.
     RenderPass(VkDevice device, std::vector<AttachmentDesc> attachments,
-	       float clearColour[3]);
+	       float clearColour[3], bool depthPrepass = false);
     ~RenderPass();
 
     /// pMemReq will be added to by the amount of memory required to
@@ -88,7 +97,11 @@ class RenderPass {
     /// This also sets the viewport and scissor to
     /// offsets of 0, 0 and extent equal to the framebuffer extent.
     void beginRenderPass(VkCommandBuffer cmdBuff, uint32_t frameIndex);
-    
+    /// Same as beginRenderPass, for the depth pre-pass.
+    void beginDepthPrepass(VkCommandBuffer cmdBuff, uint32_t frameIndex);
+    bool hasDepthPrepass() { return depthPrepass != VK_NULL_HANDLE; }
+    VkRenderPass getDepthPrepass();
+
     std::vector<VkImageView> getAttachmentViews(uint32_t attachmentIndex);
     VkExtent2D getExtent();
     VkRenderPass getRenderPass();
@@ -96,6 +109,8 @@ class RenderPass {
  private:
     VkDevice device;
     VkRenderPass renderpass;
+    VkRenderPass depthPrepass = VK_NULL_HANDLE;
+    uint32_t depthIndex;
     std::vector<AttachmentDesc> attachmentDescription;
     std::vector<VkClearValue> attachmentClears;
 
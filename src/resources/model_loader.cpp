@@ -6,21 +6,35 @@
 
 #include "../vkhelper.h"
 #include "../logger.h"
-#include "../pipeline_data.h"
 #include "../parts/threading.h"
 
 struct MeshInfo : public GPUMesh {
-    MeshInfo() { indexCount = 0; indexOffset = 0; vertexOffset = 0; }
+    MeshInfo() { indexCount[0] = 0; indexOffset[0] = 0; vertexOffset = 0; }
+    /// the simplified levels of detail follow the full mesh's indices
     template <typename T_Vert>
-    MeshInfo(uint32_t indexCount, uint32_t indexOffset, uint32_t vertexOffset,
-	     Mesh<T_Vert> *mesh) {
-	this->indexCount = indexCount;
-	this->indexOffset = indexOffset;
+    MeshInfo(uint32_t indexOffset, uint32_t vertexOffset, Mesh<T_Vert> *mesh) {
+	lodCount = 1 + (uint32_t)mesh->lods.size();
+	this->indexCount[0] = (uint32_t)mesh->indices.size();
+	this->indexOffset[0] = indexOffset;
+	for(uint32_t i = 1; i < lodCount; i++) {
+	    this->indexCount[i] = (uint32_t)mesh->lods[i - 1].size();
+	    this->indexOffset[i] = this->indexOffset[i - 1] + this->indexCount[i - 1];
+	}
 	this->vertexOffset = vertexOffset;
 	this->load(mesh);
     }
-    uint32_t indexCount;
-    uint32_t indexOffset;
+    /// meshes with fewer levels use their lowest detail level
+    uint32_t level(uint32_t lod) { return lod < lodCount ? lod : lodCount - 1; }
+    uint32_t totalIndexCount() {
+	return indexOffset[lodCount - 1] + indexCount[lodCount - 1] - indexOffset[0];
+    }
+    // range the packed vertex positions are within
+    glm::vec3 posOffset = glm::vec3(0.0f);
+    glm::vec3 posScale = glm::vec3(1.0f);
+    // level 0 is the full detail mesh
+    uint32_t lodCount = 1;
+    uint32_t indexCount[Resource::MAX_MODEL_LODS + 1];
+    uint32_t indexOffset[Resource::MAX_MODEL_LODS + 1];
     uint32_t vertexOffset;
 };
 
@@ -30,25 +44,49 @@ struct ModelInGPU : public GPUModel {
     uint32_t indexCount  = 0;
     uint32_t vertexOffset = 0;
     uint32_t indexOffset = 0;
+    // mesh i uses material materialOffset + i in the pool's material table
+    uint32_t materialOffset = 0;
+    // the most levels of detail any of the meshes have
+    uint32_t lodCount = 1;
+    // 16 bit if every mesh has few enough vertices
+    VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+    // no mesh discards fragments, set by updateMaterials
+    bool opaque = false;
 
     template <typename T_Vert>
     ModelInGPU(LoadedModel<T_Vert> &model) : GPUModel(model){}
+
+    VkDrawIndexedIndirectCommand command(uint32_t meshIndex,
+					 uint32_t instanceCount,
+					 uint32_t instanceOffset,
+					 uint32_t lod) {
+	uint32_t level = meshes[meshIndex].level(lod);
+	VkDrawIndexedIndirectCommand cmd;
+	cmd.indexCount = meshes[meshIndex].indexCount[level];
+	cmd.instanceCount = instanceCount;
+	cmd.firstIndex = meshes[meshIndex].indexOffset[level] + indexOffset;
+	cmd.vertexOffset = (int32_t)(meshes[meshIndex].vertexOffset + vertexOffset);
+	cmd.firstInstance = instanceOffset;
+	return cmd;
+    }
     
     void draw(VkCommandBuffer cmdBuff,
 	      uint32_t meshIndex,
 	      uint32_t instanceCount,
-	      uint32_t instanceOffset) {
+	      uint32_t instanceOffset,
+	      uint32_t lod) {
 	if(meshIndex >= meshes.size()) {
 	    LOG_ERROR("Mesh Index out of range. "
 		      " - index: " << meshIndex <<
 		      " - mesh count: " << meshes.size());
 	    return;
 	}
+	uint32_t level = meshes[meshIndex].level(lod);
 	vkCmdDrawIndexed(
 		cmdBuff,
-		meshes[meshIndex].indexCount,
+		meshes[meshIndex].indexCount[level],
 		instanceCount,
-		meshes[meshIndex].indexOffset
+		meshes[meshIndex].indexOffset[level]
 		+ indexOffset,
 		meshes[meshIndex].vertexOffset
 		+ vertexOffset,
@@ -65,11 +103,32 @@ ModelLoaderVk::ModelLoaderVk(DeviceState base, VkCommandPool cmdpool,
       this->cmdbuff = generalCmdBuff;
       checkResultAndThrow(part::create::Fence(base.device, &loadedFence, false),
 			  "failed to create finish load semaphore in model loader");
+      createMaterialSetLayout(base.device, &materialLayout);
 }
 
 ModelLoaderVk::~ModelLoaderVk() {
     vkDestroyFence(base.device, loadedFence, nullptr);
     clearGPU();
+    if(commandsCreated) {
+	vkUnmapMemory(base.device, commandMemory);
+	vkDestroyBuffer(base.device, commandBuffer, nullptr);
+	vkFreeMemory(base.device, commandMemory, nullptr);
+    }
+    vkDestroyDescriptorSetLayout(base.device, materialLayout, nullptr);
+}
+
+void ModelLoaderVk::createMaterialSetLayout(VkDevice device, VkDescriptorSetLayout *layout) {
+    VkDescriptorSetLayoutBinding binding{};
+    binding.binding = 0;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    binding.descriptorCount = 1;
+    binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+    VkDescriptorSetLayoutCreateInfo layoutInfo{
+	VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &binding;
+    checkResultAndThrow(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, layout),
+			"failed to create model material descriptor set layout");
 }
 
 void ModelLoaderVk::clearGPU() {
@@ -78,18 +137,30 @@ void ModelLoaderVk::clearGPU() {
     for(ModelInGPU* model: models)
 	delete model;
     models.clear();
+    destroyMaterials();
       
     vertexDataSize = 0;
+    index16DataSize = 0;
     indexDataSize = 0;
+    materialCount = 0;
       
     vkDestroyBuffer(base.device, buffer, nullptr);
     vkFreeMemory(base.device, memory, nullptr);
 }
 
 void ModelLoaderVk::bindBuffers(VkCommandBuffer cmdBuff) {
+    // the vertex and index buffers are bound by the draws that need them
     boundThisFrame = false;
-    //bind index buffer - can only have one index buffer
-    vkCmdBindIndexBuffer(cmdBuff, buffer, vertexDataSize, VK_INDEX_TYPE_UINT32);
+    indexBoundThisFrame = false;
+}
+
+void ModelLoaderVk::bindModelBuffers(VkCommandBuffer cmdBuff, ModelInGPU *model) {
+    bindGroupVertexBuffer(cmdBuff, model->type);
+    if(indexBoundThisFrame && model->indexType == prevIndexType)
+	return;
+    indexBoundThisFrame = true;
+    prevIndexType = model->indexType;
+    vkCmdBindIndexBuffer(cmdBuff, buffer, indexDataOffset(model->indexType), model->indexType);
 }
 
 void ModelLoaderVk::bindGroupVertexBuffer(VkCommandBuffer cmdBuff, Resource::ModelType type) {
@@ -103,38 +174,246 @@ void ModelLoaderVk::bindGroupVertexBuffer(VkCommandBuffer cmdBuff, Resource::Mod
     vkCmdBindVertexBuffers(cmdBuff, 0, 1, vertexBuffers, offsets);
 }
 
-void ModelLoaderVk::drawModel(VkCommandBuffer cmdBuff, VkPipelineLayout layout,
+VkDeviceSize ModelLoaderVk::indexDataOffset(VkIndexType type) {
+    // 16 bit indices come first, padded so the 32 bit ones stay aligned
+    if(type == VK_INDEX_TYPE_UINT16)
+	return vertexDataSize;
+    return vertexDataSize + ((index16DataSize + 3) & ~3u);
+}
+
+bool ModelLoaderVk::drawModel(VkCommandBuffer cmdBuff, VkPipelineLayout layout,
 			      Resource::Model model,
-			      uint32_t count, uint32_t instanceOffset) {
+			      uint32_t count, uint32_t instanceOffset, uint32_t lod,
+			      VkDeviceSize *pCommandOffset) {
     if(model.ID >= models.size()) {
 	LOG_ERROR("in draw with out of range model. id: "
                   << model.ID << " -  model count: " << models.size());
-	return;
+	return false;
     }
     if(count == 0)
-	return;
+	return false;
 
     ModelInGPU *modelInfo = models[model.ID];
+    uint32_t meshCount = (uint32_t)modelInfo->meshes.size();
+
+    // indirect commands can only start past the first instance with drawIndirectFirstInstance
+    if(!commandsCreated || !base.features.drawIndirectFirstInstance ||
+       commandCount + meshCount > MAX_MODEL_DRAW_COMMANDS) {
+	// out of indirect commands this frame
+	bindModelBuffers(cmdBuff, modelInfo);
+	bindMaterials(cmdBuff, layout, modelInfo->materialOffset);
+	for(uint32_t i = 0; i < meshCount; i++) {
+	    if(i > 0)
+		pushMaterialIndex(cmdBuff, layout, modelInfo->materialOffset + i);
+	    modelInfo->draw(cmdBuff, i, count, instanceOffset, lod);
+	}
+	return false;
+    }
 
-    bindGroupVertexBuffer(cmdBuff, modelInfo->type);
-    
-    for(size_t i = 0; i < modelInfo->meshes.size(); i++) {	
-	fragPushConstants fps {
-	    model.colour.a == 0.0f ? modelInfo->meshes[i].diffuseColour : model.colour,
-	    glm::vec4(0, 0, 1, 1),
-	    modelGetTexID(model, modelInfo->meshes[i].texture, pools),
-	};
-	vkCmdPushConstants(cmdBuff, layout, VK_SHADER_STAGE_FRAGMENT_BIT,
-			   0, sizeof(fragPushConstants), &fps);
-	modelInfo->draw(cmdBuff, (uint32_t)i, count, instanceOffset);
+    VkDeviceSize offset = commandFrameOffset +
+	commandCount * sizeof(VkDrawIndexedIndirectCommand);
+    VkDrawIndexedIndirectCommand* commands = (VkDrawIndexedIndirectCommand*)
+	(static_cast<char*>(pCommands) + offset);
+    for(uint32_t i = 0; i < meshCount; i++)
+	commands[i] = modelInfo->command(i, count, instanceOffset, lod);
+    commandCount += meshCount;
+    drawIndirect(cmdBuff, layout, modelInfo, commandBuffer, offset,
+		 sizeof(VkDrawIndexedIndirectCommand));
+    if(pCommandOffset != nullptr)
+	*pCommandOffset = offset;
+    return true;
+}
+
+void ModelLoaderVk::drawIndirect(VkCommandBuffer cmdBuff, VkPipelineLayout layout,
+				 ModelInGPU *modelInfo, VkBuffer buffer,
+				 VkDeviceSize offset, uint32_t stride) {
+    uint32_t meshCount = (uint32_t)modelInfo->meshes.size();
+    bindModelBuffers(cmdBuff, modelInfo);
+    bindMaterials(cmdBuff, layout, modelInfo->materialOffset);
+    if(base.features.multiDrawIndirect && base.features.shaderDrawParameters) {
+	// each mesh offsets the material index by its gl_DrawID
+	vkCmdDrawIndexedIndirect(cmdBuff, buffer, offset, meshCount, stride);
+	return;
+    }
+    for(uint32_t i = 0; i < meshCount; i++) {
+	if(i > 0)
+	    pushMaterialIndex(cmdBuff, layout, modelInfo->materialOffset + i);
+	vkCmdDrawIndexedIndirect(cmdBuff, buffer, offset + i * stride, 1, stride);
+    }
+}
+
+void ModelLoaderVk::bindMaterials(VkCommandBuffer cmdBuff, VkPipelineLayout layout,
+				  uint32_t materialIndex) {
+    vkCmdBindDescriptorSets(cmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, layout,
+			    MATERIAL_SET_INDEX, 1, &materialSet, 0, nullptr);
+    pushMaterialIndex(cmdBuff, layout, materialIndex);
+}
+
+void ModelLoaderVk::pushMaterialIndex(VkCommandBuffer cmdBuff, VkPipelineLayout layout,
+				      uint32_t materialIndex) {
+    shaderStructs::Draw3DParams params;
+    params.materialIndex = materialIndex;
+    vkCmdPushConstants(cmdBuff, layout, VK_SHADER_STAGE_VERTEX_BIT,
+		       0, sizeof(params), &params);
+}
+
+void ModelLoaderVk::beginFrame(uint32_t frameIndex, uint32_t frameCount) {
+    VkDeviceSize frameSize = sizeof(VkDrawIndexedIndirectCommand) * MAX_MODEL_DRAW_COMMANDS;
+    if(!commandsCreated || commandFrameCount != frameCount) {
+	if(commandsCreated) {
+	    vkUnmapMemory(base.device, commandMemory);
+	    vkDestroyBuffer(base.device, commandBuffer, nullptr);
+	    vkFreeMemory(base.device, commandMemory, nullptr);
+	}
+	checkResultAndThrow(vkhelper::createBufferAndMemory(
+				    base, frameSize * frameCount,
+				    &commandBuffer, &commandMemory,
+				    VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+				    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+				    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT),
+			    "Failed to create model draw command buffer");
+	vkBindBufferMemory(base.device, commandBuffer, commandMemory, 0);
+	vkMapMemory(base.device, commandMemory, 0, frameSize * frameCount, 0, &pCommands);
+	commandsCreated = true;
+	commandFrameCount = frameCount;
+    }
+    commandFrameOffset = frameSize * frameIndex;
+    commandCount = 0;
+}
+
+void ModelLoaderVk::createMaterials() {
+    VkDeviceSize size = sizeof(shaderStructs::Material) * (materialCount > 0 ? materialCount : 1);
+    checkResultAndThrow(vkhelper::createBufferAndMemory(
+				base, size, &materialBuffer, &materialMemory,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+				VK_MEMORY_PROPERTY_HOST_COHERENT_BIT),
+			"Failed to create model material buffer");
+    vkBindBufferMemory(base.device, materialBuffer, materialMemory, 0);
+    vkMapMemory(base.device, materialMemory, 0, size, 0, &pMaterials);
+    // texture view indices are set when the pool's textures are used
+    std::memset(pMaterials, 0, size);
+
+    VkDescriptorPoolSize poolSize;
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = 1;
+    VkDescriptorPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    poolInfo.maxSets = 1;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    checkResultAndThrow(
+	    vkCreateDescriptorPool(base.device, &poolInfo, nullptr, &materialPool),
+	    "failed to create model material descriptor pool");
+    VkDescriptorSetAllocateInfo allocInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    allocInfo.descriptorPool = materialPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &materialLayout;
+    checkResultAndThrow(vkAllocateDescriptorSets(base.device, &allocInfo, &materialSet),
+			"failed to allocate model material descriptor set");
+
+    VkDescriptorBufferInfo buffInfo = {materialBuffer, 0, size};
+    VkWriteDescriptorSet write{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+    write.dstSet = materialSet;
+    write.dstBinding = 0;
+    write.descriptorCount = 1;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.pBufferInfo = &buffInfo;
+    vkUpdateDescriptorSets(base.device, 1, &write, 0, nullptr);
+    materialsCreated = true;
+}
+
+void ModelLoaderVk::destroyMaterials() {
+    if(!materialsCreated)
+	return;
+    vkDestroyDescriptorPool(base.device, materialPool, nullptr);
+    vkUnmapMemory(base.device, materialMemory);
+    vkDestroyBuffer(base.device, materialBuffer, nullptr);
+    vkFreeMemory(base.device, materialMemory, nullptr);
+    materialsCreated = false;
+}
+
+void ModelLoaderVk::updateMaterials() {
+    if(!materialsCreated)
+	return;
+    shaderStructs::Material* materials = static_cast<shaderStructs::Material*>(pMaterials);
+    for(ModelInGPU* model: models) {
+	model->opaque = true;
+	for(size_t i = 0; i < model->meshes.size(); i++) {
+	    shaderStructs::Material &material = materials[model->materialOffset + i];
+	    material.colour = model->meshes[i].diffuseColour;
+	    material.posOffset = glm::vec4(model->meshes[i].posOffset, 0.0f);
+	    material.posScale = glm::vec4(model->meshes[i].posScale, 0.0f);
+	    material.texID = modelGetTexID(Resource::Model(), model->meshes[i].texture, pools);
+	    Resource::Texture tex = model->meshes[i].texture;
+	    if(material.colour.a == 0.0f ||
+	       (tex.ID != Resource::NULL_ID && !pools->tex(tex)->isOpaque(tex)))
+		model->opaque = false;
+	}
     }
 }
 
+void ModelLoaderVk::getMeshCullInfo(Resource::Model model, uint32_t meshIndex, uint32_t lod,
+				    shaderStructs::CullDrawCommand *command,
+				    glm::vec4 *bounds) {
+    ModelInGPU *modelInfo = models[model.ID];
+    MeshInfo &mesh = modelInfo->meshes[meshIndex];
+    uint32_t level = mesh.level(lod);
+    command->indexCount = mesh.indexCount[level];
+    command->instanceCount = 0;
+    command->firstIndex = mesh.indexOffset[level] + modelInfo->indexOffset;
+    command->vertexOffset = (int32_t)(mesh.vertexOffset + modelInfo->vertexOffset);
+    command->firstInstance = 0;
+    *bounds = mesh.bounds.sphere;
+}
+
+void ModelLoaderVk::drawModelIndirect(VkCommandBuffer cmdBuff, VkPipelineLayout layout,
+				      Resource::Model model, VkBuffer buffer,
+				      VkDeviceSize offset, uint32_t stride) {
+    if(getMeshCount(model) == 0)
+	return;
+    drawIndirect(cmdBuff, layout, models[model.ID], buffer, offset, stride);
+}
+
 void ModelLoaderVk::drawQuad(VkCommandBuffer cmdBuff, VkPipelineLayout layout, unsigned int texID,
 			     uint32_t count, uint32_t instanceOffset, glm::vec4 colour,
 			     glm::vec4 texOffset) {
-    bindGroupVertexBuffer(cmdBuff, Resource::ModelType::m2D);
-    models[quad.ID]->draw(cmdBuff, 0, count, instanceOffset);
+    bindModelBuffers(cmdBuff, models[quad.ID]);
+    models[quad.ID]->draw(cmdBuff, 0, count, instanceOffset, 0);
+}
+
+void ModelLoaderVk::drawModel2D(VkCommandBuffer cmdBuff, Resource::Model model,
+				uint32_t count, uint32_t instanceOffset) {
+    if(count == 0 || getMeshCount(model) == 0)
+	return;
+    ModelInGPU *modelInfo = models[model.ID];
+    bindModelBuffers(cmdBuff, modelInfo);
+    for(size_t i = 0; i < modelInfo->meshes.size(); i++)
+	modelInfo->draw(cmdBuff, (uint32_t)i, count,
+			instanceOffset + (uint32_t)i * count, 0);
+}
+
+uint32_t ModelLoaderVk::getMeshCount(Resource::Model model) {
+    if(model.ID >= models.size()) {
+	LOG_ERROR("out of range model. id: "
+                  << model.ID << " -  model count: " << models.size());
+	return 0;
+    }
+    return (uint32_t)models[model.ID]->meshes.size();
+}
+
+uint32_t ModelLoaderVk::getMaxMeshCount(Resource::ModelType type) {
+    uint32_t count = 0;
+    for(ModelInGPU* model: models)
+	if(model != nullptr && model->type == type && model->meshes.size() > count)
+	    count = (uint32_t)model->meshes.size();
+    return count;
+}
+
+void ModelLoaderVk::getMeshDrawData(Resource::Model model, uint32_t meshIndex,
+				    glm::vec4 *colour, int *texID) {
+    MeshInfo &mesh = models[model.ID]->meshes[meshIndex];
+    *colour = model.colour.a == 0.0f ? mesh.diffuseColour : model.colour;
+    *texID = modelGetTexID(model, mesh.texture, pools);
 }
 
 void ModelLoaderVk::loadGPU() {
@@ -145,6 +424,8 @@ void ModelLoaderVk::loadGPU() {
     processLoadGroup(&stage2D);
     processLoadGroup(&stage3D);
     processLoadGroup(&stageAnim3D);
+    createMaterials();
+    VkDeviceSize bufferSize = indexDataOffset(VK_INDEX_TYPE_UINT32) + indexDataSize;
 
     LOG("finished processing model groups");
 
@@ -153,7 +434,7 @@ void ModelLoaderVk::loadGPU() {
     VkDeviceMemory stagingMemory;
 
     if(vkhelper::createBufferAndMemory(
-	       base, vertexDataSize + indexDataSize, &stagingBuffer, &stagingMemory,
+	       base, bufferSize, &stagingBuffer, &stagingMemory,
 	       VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
 	       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
        != VK_SUCCESS) {
@@ -162,11 +443,12 @@ void ModelLoaderVk::loadGPU() {
 
     vkBindBufferMemory(base.device, stagingBuffer, stagingMemory, 0);
     void* pMem;
-    vkMapMemory(base.device, stagingMemory, 0, vertexDataSize + indexDataSize, 0, &pMem);
+    vkMapMemory(base.device, stagingMemory, 0, bufferSize, 0, &pMem);
 
     //copy each model's data to staging memory
     size_t currentVertexOffset = 0;
-    size_t currentIndexOffset = vertexDataSize;
+    size_t currentIndexOffset[2] = { indexDataOffset(VK_INDEX_TYPE_UINT16),
+				     indexDataOffset(VK_INDEX_TYPE_UINT32) };
 
     stageLoadGroup(pMem, &stage2D, currentVertexOffset, currentIndexOffset);
     stageLoadGroup(pMem, &stage3D, currentVertexOffset, currentIndexOffset);
@@ -176,7 +458,7 @@ void ModelLoaderVk::loadGPU() {
     LOG("finished staging model groups");
 
     //create final dest memory
-    vkhelper::createBufferAndMemory(base, vertexDataSize + indexDataSize, &buffer, &memory,
+    vkhelper::createBufferAndMemory(base, bufferSize, &buffer, &memory,
 				    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
 				    VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
 				    VK_BUFFER_USAGE_TRANSFER_DST_BIT,
@@ -193,7 +475,7 @@ void ModelLoaderVk::loadGPU() {
     VkBufferCopy copyRegion{};
     copyRegion.srcOffset = 0;
     copyRegion.dstOffset = 0;
-    copyRegion.size = vertexDataSize + indexDataSize;
+    copyRegion.size = bufferSize;
     vkCmdCopyBuffer(cmdbuff, stagingBuffer, buffer, 1, &copyRegion);
     vkEndCommandBuffer(cmdbuff);
 
@@ -224,46 +506,77 @@ void ModelLoaderVk::processLoadGroup(ModelGroup<T_Vert>* pGroup) {
 
 	model->type = type;
 	model->vertexOffset = modelVertexOffset;
-	model->indexOffset = indexDataSize / sizeof(pGroup->models[i].meshes[0]->indices[0]);
+	// indices are relative to the mesh's vertex offset,
+	// so only the size of each mesh matters
+	model->indexType = VK_INDEX_TYPE_UINT16;
+	for(Mesh<T_Vert>* mesh: pGroup->models[i].meshes)
+	    if(mesh->verticies.size() > MAX_16BIT_INDEX_VERTICES)
+		model->indexType = VK_INDEX_TYPE_UINT32;
+	uint32_t &groupIndexSize = model->indexType == VK_INDEX_TYPE_UINT16 ?
+	    index16DataSize : indexDataSize;
+	uint32_t indexSize = model->indexType == VK_INDEX_TYPE_UINT16 ?
+	    sizeof(uint16_t) : sizeof(uint32_t);
+	model->indexOffset = groupIndexSize / indexSize;
 	model->meshes.resize(pGroup->models[i].meshes.size());
+	model->materialOffset = materialCount;
+	materialCount += (uint32_t)model->meshes.size();
+	std::vector<Resource::Bounds> meshBounds;
 	for(int j = 0 ; j <  pGroup->models[i].meshes.size(); j++) {
 	    Mesh<T_Vert>* mesh = pGroup->models[i].meshes[j];
 	    model->meshes[j] = MeshInfo(
-		    (uint32_t)mesh->indices.size(),
 		    model->indexCount,  //as offset
 		    model->vertexCount, //as offset
 		    mesh);
+	    packedPositionRange(mesh, &model->meshes[j].posOffset, &model->meshes[j].posScale);
+	    model->meshes[j].bounds = calcMeshBounds(mesh, pGroup->models[i].animations);
+	    meshBounds.push_back(model->meshes[j].bounds);
+	    if(model->meshes[j].lodCount > model->lodCount)
+		model->lodCount = model->meshes[j].lodCount;
+	    uint32_t meshIndexCount = model->meshes[j].totalIndexCount();
 	    model->vertexCount += (uint32_t)mesh->verticies.size();
-	    model->indexCount  += (uint32_t)mesh->indices.size();
-	    vertexDataSize += sizeof(T_Vert)
+	    model->indexCount  += meshIndexCount;
+	    vertexDataSize += (uint32_t)packedVertexSize(vert)
 		* (uint32_t)mesh->verticies.size();
-	    indexDataSize +=  sizeof(mesh->indices[0])
-		* (uint32_t)mesh->indices.size();
+	    groupIndexSize += indexSize * meshIndexCount;
 	}
+	model->bounds = combineBounds(meshBounds);
 	modelVertexOffset += model->vertexCount;
     }
     pGroup->vertexDataSize = vertexDataSize - pGroup->vertexDataOffset;
 }
 
+void stageIndices(void* pMem, size_t &offset, const std::vector<unsigned int> &indices,
+		  VkIndexType type) {
+    if(type == VK_INDEX_TYPE_UINT32) {
+	std::memcpy(static_cast<char*>(pMem) + offset, indices.data(),
+		    sizeof(uint32_t) * indices.size());
+	offset += sizeof(uint32_t) * indices.size();
+	return;
+    }
+    uint16_t* dst = reinterpret_cast<uint16_t*>(static_cast<char*>(pMem) + offset);
+    for(size_t i = 0; i < indices.size(); i++)
+	dst[i] = (uint16_t)indices[i];
+    offset += sizeof(uint16_t) * indices.size();
+}
+
 template <class T_Vert >
 void ModelLoaderVk::stageLoadGroup(void* pMem, ModelGroup<T_Vert >* pGroup,
-				   size_t &pVertexDataOffset, size_t &pIndexDataOffset) {
+				   size_t &pVertexDataOffset, size_t pIndexDataOffset[2]) {
     for(auto& model: pGroup->models) {
+	ModelInGPU* modelInfo = models[model.ID];
+	size_t &indexOffset =
+	    pIndexDataOffset[modelInfo->indexType == VK_INDEX_TYPE_UINT16 ? 0 : 1];
 	for(size_t i = 0; i < model.meshes.size(); i++) {
+	    MeshInfo &mesh = modelInfo->meshes[i];
+	    packVertices(model.meshes[i], mesh.posOffset, mesh.posScale,
+			 static_cast<char*>(pMem) + pVertexDataOffset);
 	      
-	    std::memcpy(static_cast<char*>(pMem) + pVertexDataOffset,
-			model.meshes[i]->verticies.data(),
-			sizeof(T_Vert ) * model.meshes[i]->verticies.size());
-	      
-	    pVertexDataOffset += sizeof(T_Vert ) * model.meshes[i]->verticies.size();
-	      
-	    std::memcpy(static_cast<char*>(pMem) + pIndexDataOffset,
-			model.meshes[i]->indices.data(),
-			sizeof(model.meshes[i]->indices[0])
-			* model.meshes[i]->indices.size());
-	      
-	    pIndexDataOffset += sizeof(model.meshes[i]->indices[0])
-		* model.meshes[i]->indices.size();
+	    pVertexDataOffset += packedVertexSize(T_Vert())
+		* model.meshes[i]->verticies.size();
+
+	    stageIndices(pMem, indexOffset, model.meshes[i]->indices, modelInfo->indexType);
+	    for(auto &lod: model.meshes[i]->lods)
+		stageIndices(pMem, indexOffset, lod, modelInfo->indexType);
 	      
 	    delete model.meshes[i];
 	}
@@ -288,3 +601,33 @@ Resource::ModelAnimation ModelLoaderVk::getAnimation(Resource::Model model, int
     }
     return models[model.ID]->getAnimation(index);
 }
+
+Resource::Bounds ModelLoaderVk::getBounds(Resource::Model model) {
+    if(model.ID >= models.size()) {
+	LOG_ERROR("in getBounds with out of range model. id: "
+                  << model.ID << " -  model count: " << models.size());
+	return Resource::Bounds();
+    }
+    return models[model.ID]->bounds;
+}
+
+uint32_t ModelLoaderVk::getLODCount(Resource::Model model) {
+    if(model.ID >= models.size())
+	return 1;
+    return models[model.ID]->lodCount;
+}
+
+bool ModelLoaderVk::isOpaque(Resource::Model model) {
+    if(model.ID >= models.size())
+	return false;
+    return models[model.ID]->opaque;
+}
+
+Resource::Bounds ModelLoaderVk::getMeshBounds(Resource::Model model, uint32_t meshIndex) {
+    if(getMeshCount(model) <= meshIndex) {
+	LOG_ERROR("in getMeshBounds with out of range mesh. model id: " << model.ID
+		  << " - mesh index: " << meshIndex);
+	return Resource::Bounds();
+    }
+    return models[model.ID]->meshes[meshIndex].bounds;
+}
@@ -6,9 +6,17 @@
 #include <resource_loader/model_loader.h>
 
 #include "../device_state.h"
+#include "../shader_structs.h"
 
 struct ModelInGPU;
 
+// the 3D pipelines' set index for a pool's material table, match in 3D shaders
+const uint32_t MATERIAL_SET_INDEX = 5;
+// indirect draw commands per pool per frame, draws past this use direct draws
+const uint32_t MAX_MODEL_DRAW_COMMANDS = 4096;
+// models whose meshes have at most this many vertices use 16 bit indices
+const size_t MAX_16BIT_INDEX_VERTICES = 65536;
+
 class ModelLoaderVk : public InternalModelLoader {
 public:
     ModelLoaderVk(DeviceState base, VkCommandPool cmdpool, VkCommandBuffer generalCmdBuff,
@@ -17,28 +25,78 @@ public:
     void loadGPU() override;
     void clearGPU() override;
 
+    /// layout of the per pool material table, a storage buffer of shaderStructs::Material
+    static void createMaterialSetLayout(VkDevice device, VkDescriptorSetLayout *layout);
+    /// rewrite the material table, call after the texture view indices change
+    void updateMaterials();
+    /// resets the draw commands, called before any draws in a frame
+    void beginFrame(uint32_t frameIndex, uint32_t frameCount);
+
     void bindBuffers(VkCommandBuffer cmdBuff);
-    void drawModel(VkCommandBuffer cmdBuff, VkPipelineLayout layout, Resource::Model model,
-		   uint32_t count, uint32_t instanceOffset);
+    /// draws all of the model's meshes with one multi draw indirect call,
+    /// meshes without the level of detail lod use their lowest detail.
+    /// Returns false if it used direct draws, otherwise pCommandOffset is set to where
+    /// the draw's commands are in getCommandBuffer(), so they can be drawn again.
+    bool drawModel(VkCommandBuffer cmdBuff, VkPipelineLayout layout, Resource::Model model,
+		   uint32_t count, uint32_t instanceOffset, uint32_t lod,
+		   VkDeviceSize *pCommandOffset = nullptr);
+    /// holds the indirect commands written by drawModel this frame
+    VkBuffer getCommandBuffer() { return commandBuffer; }
     void drawQuad(VkCommandBuffer cmdBuff, VkPipelineLayout layout, unsigned int texID,
 		  uint32_t count, uint32_t instanceOffset, glm::vec4 colour, glm::vec4 texOffset);
+    /// draw each mesh of a 2D model, mesh i uses the count instances
+    /// starting at instanceOffset + i * count
+    void drawModel2D(VkCommandBuffer cmdBuff, Resource::Model model,
+		     uint32_t count, uint32_t instanceOffset);
+    /// returns 0 if the model doesn't exist
+    uint32_t getMeshCount(Resource::Model model);
+    /// the most meshes any loaded model of the type has
+    uint32_t getMaxMeshCount(Resource::ModelType type);
+    /// the colour and texture view index a mesh is drawn with, texID is -1 if untextured
+    void getMeshDrawData(Resource::Model model, uint32_t meshIndex,
+			 glm::vec4 *colour, int *texID);
+    /// the indexed draw of a mesh's level of detail, with no instances, and its bounding sphere
+    void getMeshCullInfo(Resource::Model model, uint32_t meshIndex, uint32_t lod,
+			 shaderStructs::CullDrawCommand *command, glm::vec4 *bounds);
+    /// draw every mesh of the model with the indexed indirect commands
+    /// starting at offset in buffer, one per mesh
+    void drawModelIndirect(VkCommandBuffer cmdBuff, VkPipelineLayout layout,
+			   Resource::Model model, VkBuffer buffer,
+			   VkDeviceSize offset, uint32_t stride);
     Resource::ModelAnimation getAnimation(Resource::Model model,
 					  std::string animationName) override;
     Resource::ModelAnimation getAnimation(Resource::Model model,
 					  int index) override;
+    Resource::Bounds getBounds(Resource::Model model) override;
+    Resource::Bounds getMeshBounds(Resource::Model model, uint32_t meshIndex) override;
+    /// levels of detail including the full mesh, 1 if none were generated
+    uint32_t getLODCount(Resource::Model model);
+    /// false if any mesh's texture or colour may have fully transparent texels,
+    /// known once the materials are updated
+    bool isOpaque(Resource::Model model);
 
 private:
     template <class T_Vert>
     void processLoadGroup(ModelGroup<T_Vert>* pGroup);
     template <class T_Vert>
+    /// indexDataOffset is the next 16 bit then 32 bit index offset
     void stageLoadGroup(void* pMem, ModelGroup<T_Vert>* pGroup,
-			size_t &vertexDataOffset, size_t &indexDataOffset);
+			size_t &vertexDataOffset, size_t indexDataOffset[2]);
+    /// binds the model's vertex group and index type if they aren't already bound
+    void bindModelBuffers(VkCommandBuffer cmdBuff, ModelInGPU *model);
     void bindGroupVertexBuffer(VkCommandBuffer cmdBuff, Resource::ModelType type);
-    void drawMesh(VkCommandBuffer cmdBuff,
-		  ModelInGPU *modelInfo,
-		  uint32_t meshIndex,
-		  uint32_t instanceCount,
-		  uint32_t instanceOffset);
+    /// where indices of the given type start in the buffer
+    VkDeviceSize indexDataOffset(VkIndexType type);
+    void drawIndirect(VkCommandBuffer cmdBuff, VkPipelineLayout layout,
+		      ModelInGPU *modelInfo, VkBuffer buffer,
+		      VkDeviceSize offset, uint32_t stride);
+    /// binds the material table and pushes the index of the first mesh's material
+    void bindMaterials(VkCommandBuffer cmdBuff, VkPipelineLayout layout,
+		       uint32_t materialIndex);
+    void pushMaterialIndex(VkCommandBuffer cmdBuff, VkPipelineLayout layout,
+			   uint32_t materialIndex);
+    void createMaterials();
+    void destroyMaterials();
 
     DeviceState base;
     VkCommandPool cmdpool;
@@ -50,10 +108,32 @@ private:
     VkDeviceMemory memory;
 
     uint32_t vertexDataSize = 0;
+    // models are drawn with 16 bit indices if none of their meshes have too many vertices
+    uint32_t index16DataSize = 0;
     uint32_t indexDataSize = 0;
 
+    // one material per mesh, in model load order
+    uint32_t materialCount = 0;
+    bool materialsCreated = false;
+    VkDescriptorSetLayout materialLayout;
+    VkDescriptorPool materialPool;
+    VkDescriptorSet materialSet;
+    VkBuffer materialBuffer;
+    VkDeviceMemory materialMemory;
+    void* pMaterials;
+
+    bool commandsCreated = false;
+    uint32_t commandFrameCount = 0;
+    VkBuffer commandBuffer;
+    VkDeviceMemory commandMemory;
+    void* pCommands;
+    VkDeviceSize commandFrameOffset = 0;
+    uint32_t commandCount = 0;
+
     bool boundThisFrame = false;
     Resource::ModelType prevBoundType;
+    bool indexBoundThisFrame = false;
+    VkIndexType prevIndexType;
 };
 
 
@@ -4,7 +4,7 @@ ResourcePoolVk::ResourcePoolVk(uint32_t poolID, BasePoolManager* pools, DeviceSt
     this->pool = Resource::Pool(poolID);
     texLoader = new TexLoaderVk(base, cmdpool, pool, config);
     modelLoader = new ModelLoaderVk(base, cmdpool, cmdbuff, pool, pools);
-    fontLoader = new InternalFontLoader(pool, texLoader);
+    fontLoader = new InternalFontLoader(pool, texLoader, config);
 }
 
 ResourcePoolVk::~ResourcePoolVk() {
@@ -18,8 +18,9 @@ void ResourcePoolVk::setUseGPUResources(bool value) {
 }
 
 void ResourcePoolVk::loadGpu() {
-    texLoader->loadGPU();
+    // fonts may stage a shared atlas texture, so load them first
     fontLoader->loadGPU();
+    texLoader->loadGPU();
     modelLoader->loadGPU();
     UseGPUResources = true;
     usingGPUResources = false;
@@ -1,6 +1,7 @@
 #include "texture_loader.h"
 
 #include <cstring>
+#include <algorithm>
 #include "../logger.h"
 #include "../vkhelper.h"
 #include "../parts/images.h"
@@ -8,6 +9,8 @@
 #include "../parts/threading.h"
 
 const VkFilter MIPMAP_FILTER = VK_FILTER_LINEAR;
+// per frame staging size for updating texture regions
+const VkDeviceSize REGION_STAGING_SIZE = 1024 * 1024;
 
 struct TextureInGPU {
     TextureInGPU(VkDevice device, StagedTex tex, bool srgb) {
@@ -17,6 +20,8 @@ struct TextureInGPU {
 	mipLevels = (int)std::floor(std::log2(width > height ? width : height)) + 1;
 	if(tex.nrChannels != 4)
 	    throw std::runtime_error("GPU Tex has unsupport no. of channels!");
+	updatable = tex.updatable;
+	opaque = tex.opaque;
 	if(srgb)
 	    format = VK_FORMAT_R8G8B8A8_SRGB;
 	else
@@ -27,6 +32,8 @@ struct TextureInGPU {
 	vkDestroyImage(device, image, nullptr);	  
     }
     VkDevice device;
+    bool updatable;
+    bool opaque;
     uint32_t imageViewIndex = 0;
     uint32_t width;
     uint32_t height;
@@ -48,14 +55,23 @@ TexLoaderVk::TexLoaderVk(DeviceState base, VkCommandPool cmdpool,
     this->cmdpool = cmdpool;
     checkResultAndThrow(part::create::Fence(base.device, &loadedFence, false),
 			"failed to create finish load semaphore in texLoader");
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(base.physicalDevice, &props);
+    maxSize = props.limits.maxImageDimension2D;
 }
 
 TexLoaderVk::~TexLoaderVk() {
     vkDestroyFence(base.device, loadedFence, nullptr);
     clearGPU();
+    if(regionStagingCreated) {
+	vkUnmapMemory(base.device, regionStagingMemory);
+	vkDestroyBuffer(base.device, regionStagingBuffer, nullptr);
+	vkFreeMemory(base.device, regionStagingMemory, nullptr);
+    }
 }
 
 void TexLoaderVk::clearGPU() {
+    regionUpdates.clear();
     if (textures.size() <= 0)
 	return;
     for (auto& tex : textures)
@@ -184,6 +200,130 @@ unsigned int TexLoaderVk::getViewIndex(Resource::Texture tex) {
     return 0;
 }
 
+bool TexLoaderVk::isOpaque(Resource::Texture tex) {
+    if(tex.pool != this->pool || tex.ID >= textures.size())
+	return false;
+    return textures[tex.ID]->opaque;
+}
+
+void TexLoaderVk::updateRegion(Resource::Texture tex, uint32_t x, uint32_t y,
+			       uint32_t width, uint32_t height,
+			       const unsigned char* data) {
+    if(tex.pool != this->pool || tex.ID >= textures.size()) {
+	LOG_ERROR("tex loader - updateRegion: texture is not loaded in this pool");
+	return;
+    }
+    if(!textures[tex.ID]->updatable) {
+	LOG_ERROR("tex loader - updateRegion: texture was not loaded as updatable");
+	return;
+    }
+    if(x + width > textures[tex.ID]->width || y + height > textures[tex.ID]->height) {
+	LOG_ERROR("tex loader - updateRegion: region was out of the texture's bounds");
+	return;
+    }
+    if(width * height * desiredChannels > REGION_STAGING_SIZE) {
+	LOG_ERROR("tex loader - updateRegion: region was larger than the staging size");
+	return;
+    }
+    RegionUpdate update;
+    update.texID = tex.ID;
+    update.offset = { (int32_t)x, (int32_t)y, 0 };
+    update.extent = { width, height, 1 };
+    update.data.assign(data, data + width * height * desiredChannels);
+    regionUpdates.push_back(std::move(update));
+}
+
+VkImageMemoryBarrier initialBarrierSettings();
+
+void TexLoaderVk::recordRegionUpdates(VkCommandBuffer cmdBuff, uint32_t frameIndex,
+				      uint32_t frameCount) {
+    if(regionUpdates.size() == 0)
+	return;
+    if(!regionStagingCreated || regionStagingFrameCount != frameCount) {
+	if(regionStagingCreated) {
+	    vkUnmapMemory(base.device, regionStagingMemory);
+	    vkDestroyBuffer(base.device, regionStagingBuffer, nullptr);
+	    vkFreeMemory(base.device, regionStagingMemory, nullptr);
+	}
+	checkResultAndThrow(vkhelper::createBufferAndMemory(
+				    base, REGION_STAGING_SIZE * frameCount,
+				    &regionStagingBuffer, &regionStagingMemory,
+				    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+				    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT),
+			    "Failed to create staging memory for texture region updates");
+	vkBindBufferMemory(base.device, regionStagingBuffer, regionStagingMemory, 0);
+	vkMapMemory(base.device, regionStagingMemory, 0,
+		    REGION_STAGING_SIZE * frameCount, 0, &pRegionStaging);
+	regionStagingCreated = true;
+	regionStagingFrameCount = frameCount;
+    }
+
+    VkImageMemoryBarrier barrier = initialBarrierSettings();
+    VkBufferImageCopy region{};
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+
+    VkDeviceSize frameOffset = REGION_STAGING_SIZE * frameIndex;
+    VkDeviceSize offset = 0;
+    size_t updateIndex = 0;
+    // textures with mipmaps stay as transfer dst until their mips are rebuilt
+    std::vector<uint32_t> mipmappedUpdates;
+    for(; updateIndex < regionUpdates.size(); updateIndex++) {
+	RegionUpdate &update = regionUpdates[updateIndex];
+	if(offset + update.data.size() > REGION_STAGING_SIZE)
+	    break; // finish the rest next frame
+	std::memcpy(static_cast<char*>(pRegionStaging) + frameOffset + offset,
+		    update.data.data(), update.data.size());
+	region.bufferOffset = frameOffset + offset;
+	region.imageOffset = update.offset;
+	region.imageExtent = update.extent;
+	offset += update.data.size();
+
+	TextureInGPU *tex = textures[update.texID];
+	bool mipmapped = tex->mipLevels > 1;
+	bool transitioned = mipmapped &&
+	    std::find(mipmappedUpdates.begin(), mipmappedUpdates.end(), update.texID)
+	    != mipmappedUpdates.end();
+
+	barrier.image = tex->image;
+	barrier.subresourceRange.levelCount = tex->mipLevels;
+	if(!transitioned) {
+	    barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	    barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	    vkCmdPipelineBarrier(cmdBuff,
+				 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				 VK_PIPELINE_STAGE_TRANSFER_BIT,
+				 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	    if(mipmapped)
+		mipmappedUpdates.push_back(update.texID);
+	}
+
+	vkCmdCopyBufferToImage(cmdBuff, regionStagingBuffer, barrier.image,
+			       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	if(!mipmapped) {
+	    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	    vkCmdPipelineBarrier(cmdBuff,
+				 VK_PIPELINE_STAGE_TRANSFER_BIT,
+				 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+    }
+    // rebuild the mip chain once per texture, after all of its regions are copied,
+    // this leaves every level as shader read only like at load time
+    for(uint32_t texID: mipmappedUpdates)
+	textures[texID]->createMipMaps(cmdBuff);
+    regionUpdates.erase(regionUpdates.begin(), regionUpdates.begin() + updateIndex);
+}
+
 /// ---- GPU loading helpers ---
 
 void addImagePipelineBarrier(VkCommandBuffer &cmdBuff,
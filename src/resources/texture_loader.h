@@ -3,6 +3,7 @@
 
 #include <resource_loader/texture_loader.h>
 #include "../device_state.h"
+#include <vector>
 
 struct TextureInGPU;
 
@@ -17,8 +18,23 @@ public:
     uint32_t getImageCount();
     VkImageView getImageViewSetIndex(uint32_t texID, uint32_t imageViewIndex);
     unsigned int getViewIndex(Resource::Texture tex) override;
+    bool isOpaque(Resource::Texture tex) override;
+    unsigned int getMaxSize() override { return maxSize; }
+    void updateRegion(Resource::Texture tex, uint32_t x, uint32_t y,
+		      uint32_t width, uint32_t height,
+		      const unsigned char* data) override;
+    /// record copies for any region updates since the last call,
+    /// must be called outside of a render pass.
+    void recordRegionUpdates(VkCommandBuffer cmdBuff, uint32_t frameIndex, uint32_t frameCount);
       
 private:
+    struct RegionUpdate {
+	uint32_t texID;
+	VkOffset3D offset;
+	VkExtent3D extent;
+	std::vector<unsigned char> data;
+    };
+
     VkDeviceSize stageTexDataCreateImages(VkBuffer &stagingBuffer,
 					  VkDeviceMemory &stagingMemory,
 					  uint32_t *pFinalMemType);
@@ -31,6 +47,16 @@ private:
     VkDeviceMemory memory;
     uint32_t minimumMipmapLevel;
     VkFence loadedFence;
+    // the device's maxImageDimension2D
+    unsigned int maxSize;
+
+    std::vector<RegionUpdate> regionUpdates;
+    // host visible, split into a section per frame
+    bool regionStagingCreated = false;
+    VkBuffer regionStagingBuffer;
+    VkDeviceMemory regionStagingMemory;
+    void* pRegionStaging;
+    uint32_t regionStagingFrameCount = 0;
 };
 
 #endif
@@ -14,6 +14,9 @@ namespace descriptor {
   enum class ShaderStage {
       Vertex,
       Fragment,
+      Compute,
+      // for per frame data that is also read or written by compute passes
+      VertexCompute,
   };
 
   enum class Type {
@@ -60,6 +60,12 @@ DescSet::DescSet(descriptor::Set set, size_t frameCount, VkDevice device) {
   case descriptor::ShaderStage::Fragment:
       stage = VK_SHADER_STAGE_FRAGMENT_BIT;
       break;
+  case descriptor::ShaderStage::Compute:
+      stage = VK_SHADER_STAGE_COMPUTE_BIT;
+      break;
+  case descriptor::ShaderStage::VertexCompute:
+      stage = (VkShaderStageFlagBits)(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT);
+      break;
   default:
       throw std::runtime_error("Unrecognised shader stage in DescSet constructor");
   }
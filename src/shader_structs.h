@@ -9,17 +9,93 @@ namespace shaderStructs {
   struct viewProjection {
       alignas(16) glm::mat4 view = glm::mat4(1.0f);
       alignas(16) glm::mat4 proj = glm::mat4(1.0f);;
+      // between previous and current instance transforms
+      alignas(4) float interpolation = 1.0f;
   };
 
+  /// the first three rows of an affine transform, the last row is always 0, 0, 0, 1
+  inline glm::mat3x4 affineRows(const glm::mat4 &m) {
+      return glm::mat3x4(glm::transpose(m));
+  }
+
   struct PerFrame3D {
-      alignas(16) glm::mat4 model;
-      alignas(16) glm::mat4 normalMat;
+      // from affineRows, normals use the cofactor matrix derived in the shader
+      alignas(16) glm::mat3x4 model;
+      // use the mesh's diffuse colour if alpha == 0
+      alignas(16) glm::vec4 colour = glm::vec4(0.0f);
+      // texture view index, or -1 to use the mesh's texture
+      alignas(4) int32_t texID = -1;
+  };
+
+  /// a mesh's colour and texture, in its pool's material table
+  struct Material {
+      alignas(16) glm::vec4 colour;
+      // the mesh's packed positions are posOffset + unorm * posScale
+      alignas(16) glm::vec4 posOffset;
+      alignas(16) glm::vec4 posScale;
+      // texture view index, or -1 if untextured
+      alignas(4) int32_t texID;
+  };
+
+  /// push constants for the 3D vertex shaders
+  struct Draw3DParams {
+      // material of the draw's first mesh, later meshes add their gl_DrawID
+      alignas(4) uint32_t materialIndex;
+  };
+
+  /// a mesh's instances to frustum cull, match in cull.comp
+  struct CullJob {
+      // first instance, instance count, visible list offset, draw command index
+      alignas(16) glm::uvec4 range;
+      // bounding sphere in model space, xyz centre, w radius
+      alignas(16) glm::vec4 bounds;
+  };
+
+  /// laid out like VkDrawIndexedIndirectCommand
+  struct alignas(16) CullDrawCommand {
+      uint32_t indexCount;
+      uint32_t instanceCount;
+      uint32_t firstIndex;
+      int32_t vertexOffset;
+      uint32_t firstInstance;
   };
 
+  struct CullParams {
+      glm::vec4 planes[6];
+      // the view projection of the frame the depth pyramid was built from
+      glm::mat4 occlusionViewProj;
+      // depth width and height, pyramid level count, 0 if occlusion culling is off
+      glm::uvec4 occlusion;
+      uint32_t jobCount;
+  };
+
+  /// bits for Frag2DData::flags, match in flat.frag
+  const uint32_t FRAG2D_SDF_BIT = 1;
+  // only read on the cpu, when sorting 2D draws by opacity
+  const uint32_t FRAG2D_OPAQUE_BIT = 2;
+  // for 2D model meshes without a texture, only the colour is used
+  const uint32_t FRAG2D_UNTEXTURED_BIT = 4;
+  // only read on the cpu, a 2D model instance without an override texture
+  // is drawn with each mesh's own texture
+  const uint32_t FRAG2D_MESH_TEXTURE_BIT = 8;
+
   struct Frag2DData {
       alignas(16) glm::vec4 colour;
       alignas(16) glm::vec4 texOffset;
       alignas(4) uint32_t texID;
+      alignas(4) uint32_t flags = 0;
+      // 0 for no clipping, otherwise an index into the clip rects
+      alignas(4) uint32_t clipIndex = 0;
+  };
+
+  /// per instance texture animation for flat.vert
+  struct Anim2D {
+      alignas(8) glm::vec2 uvScroll = glm::vec2(0.0f);
+      alignas(8) glm::uvec2 grid = glm::uvec2(1, 1);
+      alignas(4) uint32_t frameCount = 0;
+      alignas(4) float fps = 0.0f;
+      alignas(4) float startTime = 0.0f;
+      alignas(4) uint32_t loop = 1;
   };
 
   struct timeUbo {
@@ -29,5 +105,30 @@ namespace shaderStructs {
   struct Bones {
       alignas(16) glm::mat4 mat[Resource::MAX_BONES];
   };
+
+  /// push constants for particles.comp
+  struct ParticleSimParams {
+      alignas(16) glm::vec4 startColour;
+      alignas(16) glm::vec4 endColour;
+      alignas(8) glm::vec2 position;
+      alignas(8) glm::vec2 spawnArea;
+      alignas(8) glm::vec2 velocity;
+      alignas(8) glm::vec2 velocityVariance;
+      alignas(8) glm::vec2 acceleration;
+      alignas(4) float lifetime;
+      alignas(4) float lifetimeVariance;
+      alignas(4) float startSize;
+      alignas(4) float endSize;
+      alignas(4) float deltaTime;
+      alignas(4) uint32_t emitCount;
+      alignas(4) uint32_t maxParticles;
+      alignas(4) uint32_t seed;
+  };
+
+  /// push constants for particle.vert and particle.frag
+  struct ParticleDrawParams {
+      alignas(4) float depth;
+      alignas(4) uint32_t texID;
+  };
 }
 #endif